@@ -46,6 +46,7 @@
 /******************************************* changed *******************************************/
 #include <vector>
 #include <random>
+#include <memory>
 class _sols_for_skiplist_curve ;
 class _skiplist_curve ;
 /*******************************************   end   *******************************************/
@@ -56,6 +57,39 @@ class _theta;
 class complex;
 struct annulus;
 //class _augmented_priority_queue;
+/******************************************* changed *******************************************/
+struct _solver_workspace;
+
+// Owner of the workspace of an instance. A copy of an instance (copy constructor or assignment) gets a new workspace,
+// in the state of a fresh instance: the solver state (root seeds, caches, frozen sampling, point tolerances, helper
+// threads) is never shared nor copied, so that each workspace is deleted once.
+class _workspace_ptr{
+public:
+	_workspace_ptr(void);
+	_workspace_ptr(const _workspace_ptr &);
+	_workspace_ptr &operator=(const _workspace_ptr &);
+	~_workspace_ptr(void);
+	_solver_workspace *operator->(void) const { return p.get(); }
+	operator _solver_workspace *(void) const { return p.get(); }
+private:
+	std::unique_ptr<_solver_workspace> p;
+};
+
+// Hot path statistics of the last magnification call made from outside the library (BinaryMag2, BinaryMagDark,
+// BinaryMag or BinaryMag0; what they call internally is accumulated in the same record).
+// Only collected if the library is compiled with -D_HOTPATH_STATS, otherwise every field stays 0 and costs nothing.
+struct _call_stats{
+	int NPS;						// contour points sampled, all annuli and BinaryMagSafe retries included
+	int NewImages_calls;			// lens equation solutions on the source contours
+	long long laguerre_iterations;	// root finding iterations in cmplx_laguerre2newton / cmplx_laguerre
+	long long polish_iterations;	// Newton iterations polishing the roots with the full polynomial
+	double OrderImages_seconds;		// time spent linking the new images to the image tracks
+	int BinaryMagSafe_retries;		// contours recomputed with a slightly shifted radius by BinaryMagSafe
+	int annuli;						// annuli computed by BinaryMagDark
+	int BinaryMag2_branch;			// 0: BinaryMag2 not called, 1: point source (BinaryMag0), 2: finite source (BinaryMagDark),
+									// 3: hexadecapole approximation (MultipoleMag)
+};
+/*******************************************   end   *******************************************/
 
 #ifndef __unmanaged
 namespace VBBinaryLensingLibrary {
@@ -72,8 +106,17 @@ namespace VBBinaryLensingLibrary {
 		int nim0;
 		double e,phi,phip,phi0,Om,inc,t0,d3,v3,GM,flagits;
 		double Obj[3],rad[3],tang[3],t0old;
+		/******************************************* changed *******************************************/
+		double Et0[2], vt0[2];			// Earth position and velocity at t0_par, cached on t0old (formerly statics in ComputeParallax)
+		_workspace_ptr ws;				// per-instance solver state (formerly function-level statics), so that
+										// different instances can be used concurrently from different threads
+		/*******************************************   end   *******************************************/
 		double Eq2000[3],Quad2000[3],North2000[3];
-		double ESPLout[__rsize_ESPL][__zsize_ESPL], ESPLin[__rsize_ESPL][__zsize_ESPL],ESPLoutastro[__rsize_ESPL][__zsize_ESPL], ESPLinastro[__rsize_ESPL][__zsize_ESPL];
+		/******************************************* changed *******************************************/
+		//double ESPLout[__rsize_ESPL][__zsize_ESPL], ESPLin[__rsize_ESPL][__zsize_ESPL],ESPLoutastro[__rsize_ESPL][__zsize_ESPL], ESPLinastro[__rsize_ESPL][__zsize_ESPL];
+		// point into the read-only ESPL tables shared by all instances that loaded the same file (see LoadESPLTable)
+		const double (*ESPLout)[__zsize_ESPL], (*ESPLin)[__zsize_ESPL], (*ESPLoutastro)[__zsize_ESPL], (*ESPLinastro)[__zsize_ESPL];
+		/*******************************************   end   *******************************************/
 		double *LDtab,*rCLDtab,*CLDtab;
 		double scr2, sscr2;
 		int npLD;
@@ -85,7 +128,7 @@ namespace VBBinaryLensingLibrary {
 		double rCLDprofile(double tc,annulus *,annulus *);
 		/******************************************* changed *******************************************/
 		//double BinaryMagSafe(double s, double q, double y1, double y2, double rho, _sols **images);
-		double BinaryMagSafe(double s, double q, double y1, double y2, double rho, _sols_for_skiplist_curve **images);
+		double BinaryMagSafe(double s, double q, double y1, double y2, double rho, _sols_for_skiplist_curve **images, bool reuse_images = false);
 		/*******************************************   end   *******************************************/
 
 		_curve *NewImages(complex,complex  *,_theta *);//, float &);
@@ -100,6 +143,9 @@ namespace VBBinaryLensingLibrary {
 		void cmplx_laguerre2newton(complex *, int, complex *, int &, bool &, int);
 		void solve_quadratic_eq(complex &, complex &, complex *);
 		void solve_cubic_eq(complex &, complex &, complex &, complex *);
+		/******************************************* changed *******************************************/
+		void CopySettingsTo(VBBinaryLensing *worker);	// accuracy and limb darkening settings for a worker instance
+		/*******************************************   end   *******************************************/
 
 	public: 
 
@@ -107,11 +153,37 @@ namespace VBBinaryLensingLibrary {
 		bool astrometry;
 		int satellite,parallaxsystem,t0_par_fixed,nsat;
 		int minannuli,nannuli,NPS,NPcrit;
+		/******************************************* changed *******************************************/
+		// threads solving the lens equation on the contour of the expensive BinaryMag calls (default 1: serial).
+		// With contourthreads > 1, a call that reaches _Contour_parallel_NPS points goes on in batches: the _Contour_batch
+		// intervals with the largest errors are split at once, the new points are solved concurrently in angular sectors
+		// and merged in order of angle. The batches come from a scan of the intervals, not from the heap of the serial loop,
+		// so results do not depend on contourthreads (as long as > 1) but differ from the serial ones within the accuracy.
+		// The helper threads and their worker instances are kept from one call to the next. Not copied to the workers
+		// of the parallel functions, which already use all threads.
+		int contourthreads;
+		// light curves on sorted times (default false): in the binary lens array versions of the light curve functions,
+		// the point-source solve of BinaryMag2 at each source center starts the roots from those of the previous centers, extrapolated
+		// along the trajectory, instead of the last point of the previous contour, with a cold restart when that solve fails
+		// (fewer Laguerre iterations per point on densely sampled curves). Results differ from the default
+		// ones only by rounding, or within the accuracy where it changes the sampling of a contour.
+		bool warmstart;
+		/*******************************************   end   *******************************************/
 		double y_1,y_2,av, therr,astrox1,astrox2;
+		/******************************************* changed *******************************************/
+		_call_stats stats;				// see _call_stats (compile with -D_HOTPATH_STATS to fill it)
+		/*******************************************   end   *******************************************/
 
 
 	// Critical curves and caustic calculation
 		_sols *PlotCrit(double a,double q);
+		/******************************************* changed *******************************************/
+		// caustic proximity index for fits that evaluate many points at fixed (s, q): with the index of the same (s, q),
+		// BinaryMag2_Npoint sends the points whose distance from the caustics makes the finite source negligible
+		// straight to the batched point-source solver (BinaryMag0_Npoint), without the tests of BinaryMag2
+		void SetCausticIndex(double s, double q);
+		void RemoveCausticIndex(void);
+		/*******************************************   end   *******************************************/
 		void PrintCau(double a,double q,double y1, double y2, double rho);
 
 	// Initialization for calculations including parallax
@@ -120,16 +192,45 @@ namespace VBBinaryLensingLibrary {
 	// Magnification calculation functions.
 
 		/******************************************* changed *******************************************/
-		double BinaryMag0(double s,double q,double y1,double y2, _sols_for_skiplist_curve **Images);
+		// with reuse_images (used inside the library), the images go to a buffer of the instance, valid until the next call,
+		// which the caller empties with clear() instead of delete
+		double BinaryMag0(double s,double q,double y1,double y2, _sols_for_skiplist_curve **Images, bool reuse_images = false);
 		//double BinaryMag0(double s,double q,double y1,double y2, _sols **Images);
 		double BinaryMag0(double s, double q, double y1, double y2);
 
-		double BinaryMag(double s,double q,double y1,double y2,double rho,double accuracy, _sols_for_skiplist_curve **Images);
+		double BinaryMag(double s,double q,double y1,double y2,double rho,double accuracy, _sols_for_skiplist_curve **Images, bool reuse_images = false);
 		//double BinaryMag(double s,double q,double y1,double y2,double rho,double accuracy, _sols **Images);
 		double BinaryMag(double s,double q ,double y1,double y2,double rho,double accuracy);
 		/*******************************************   end   *******************************************/
+		/******************************************* changed *******************************************/
+		// BinaryMag returning the image contours as flat arrays instead of a _sols_for_skiplist_curve: the points of track t
+		// are (x1[k], x2[k]) for start[t] <= k < start[t+1]. npoints and ntracks are always set; the arrays (start with
+		// maxtracks + 1 elements) are written only if the contours fit, otherwise the call can be repeated with larger ones.
+		double BinaryMagContours(double s, double q, double y1, double y2, double rho, double accuracy, 
+								 double *x1, double *x2, int *start, int maxpoints, int maxtracks, int *npoints, int *ntracks);
+		/*******************************************   end   *******************************************/
 		double BinaryMag2(double s, double q, double y1, double y2, double rho);
 		double BinaryMagDark(double s, double q, double y1, double y2, double rho,double accuracy);
+		/******************************************* changed *******************************************/
+		// hexadecapole approximation of the finite-source magnification with linear limb darkening a1 (Gould 2008),
+		// from BinaryMag0 at the center and at 12 points at distance rho/2 and rho. The rho^4 term is the error estimate:
+		// returns -1 if 4 times it exceeds accuracy + RelTol * A, if a point-source calculation fails, if the quadrupole
+		// estimate of BinaryMag0 at one of the points exceeds a tenth of its magnification (the expansion does not converge),
+		// or if the number of images is not the same at all points (the source crosses a caustic). Used by BinaryMag2
+		// between BinaryMag0 and BinaryMagDark.
+		double MultipoleMag(double s, double q, double y1, double y2, double rho, double accuracy);
+		/*******************************************   end   *******************************************/
+		/******************************************* changed *******************************************/
+		// magnification and its derivatives grad[5] with respect to (s, q, y1, y2, rho), in one call: the images found by the usual
+		// calculation are differentiated through the lens equation (forward mode, see _lens_tangents), and their derivatives
+		// carried through the sum of 1/|J| of the point source, the trapezium sum of the contour areas and its parabolic corrections,
+		// the hexadecapole formula and the limb darkening annuli, as BinaryMag2 chooses them. The sampling is not differentiated:
+		// the derivatives are exact for the magnification on the sampling of the call, and on caustic crossings they differ from
+		// the finite differences of BinaryMag2 by about 1e-3 relative at Tol = 1e-4, 1e-5 at Tol = 1e-6, the one in rho included.
+		double BinaryMag2Gradient(double s, double q, double y1, double y2, double rho, double *grad);
+		// point-source magnification and its derivatives grad[4] with respect to (s, q, y1, y2)
+		double BinaryMag0Gradient(double s, double q, double y1, double y2, double *grad);
+		/*******************************************   end   *******************************************/
 		void BinaryMagMultiDark(double s, double q, double y1, double y2, double rho, double *a1_list, int n_filters, double *mag_list, double accuracy);
 
 	// Limb Darkening control
@@ -138,7 +239,11 @@ namespace VBBinaryLensingLibrary {
 		void SetLDprofile(LDprofiles);
 
 	// ESPL functions
+		/******************************************* changed *******************************************/
+		// the table file is loaded once per process (memory-mapped where available) and shared read-only
+		// by all the instances loading the same file name, so that loading it is cheap for every further instance
 		void LoadESPLTable(char *tablefilename);
+		/*******************************************   end   *******************************************/
 		double ESPLMag(double u, double rho);
 		double ESPLMag2(double u, double rho);
 		double ESPLMagDark(double u, double rho);
@@ -153,21 +258,90 @@ namespace VBBinaryLensingLibrary {
 		void ESPLLightCurveParallax(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
 
 		void BinaryLightCurve(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
+		/******************************************* changed *******************************************/
+		// BinaryLightCurve with the derivatives of each magnification with respect to the 7 parameters (log_s, log_q, u0, alpha,
+		// log_rho, log_tE, t0) in grad_array[7 * i] to grad_array[7 * i + 6], see BinaryMag2Gradient
+		void BinaryLightCurveGradient(double *parameters, double *t_array, double *mag_array, double *grad_array, double *y1_array, double *y2_array, int np);
+		/*******************************************   end   *******************************************/
 		void BinaryLightCurveW(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
 		void BinaryLightCurveParallax(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
 		void BinaryLightCurveOrbital(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, double *sep_array, int np);
 		void BinaryLightCurveKepler(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, double *sep_array, int np);
+		/******************************************* changed *******************************************/
+		// frozen sampling, for the derivatives of fits by finite differences: after RecordSampling, the binary lens light curve
+		// functions above record the sampling of each point (the radii of the annuli of BinaryMagDark and the angles of each
+		// contour, in their order of insertion); after FreezeSampling, they evaluate each recorded point on the same sampling,
+		// refined only where its error estimate grows beyond twice the recorded one. The magnification is then a smooth
+		// function of the parameters near the recorded model, as long as no caustic crosses a sampled point of a contour.
+		// Contours and annuli are computed serially in both modes. The records are those of the last curve computed after
+		// RecordSampling, other points are sampled as usual; RemoveFrozenSampling drops them and goes back to adaptive sampling.
+		void RecordSampling(void);
+		void FreezeSampling(void);
+		void RemoveFrozenSampling(void);
+		/*******************************************   end   *******************************************/
+		/******************************************* changed *******************************************/
+		// per-point tolerance of the next light curve function: its point i is computed with Tol = tol_array[i]
+		// (given to BinaryMag2 and the ESPL magnifications, and down to BinaryMagDark, BinaryMag and MultipoleMag), the instance
+		// Tol for i >= np or tol_array[i] <= 0; RelTol applies as usual. The second form derives them from the flux errors
+		// err_array of the points and the source fluxes of their datasets in FsFb, as returned by LightCurveChi2: a magnification
+		// error of safety * err / Fs is a flux error of safety * err. The tolerances serve one curve only (LightCurveChi2 included),
+		// which takes them out of the instance: set them again before each curve. RemovePointTolerances drops them unused.
+		void SetPointTolerances(double *tol_array, int np);
+		void SetPointTolerances(double *err_array, int *dataset_array, int ndatasets, double *FsFb, int np, double safety);
+		void RemovePointTolerances(void);
+		/*******************************************   end   *******************************************/
 
 		void BinSourceLightCurve(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
 		void BinSourceLightCurveParallax(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
 		void BinSourceLightCurveXallarap(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, double *sep_array, int np);
 		void BinSourceSingleLensXallarap(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, double *y1_array2, double *y2_array2, int np);
 		void BinSourceBinLensXallarap(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
+		/******************************************* changed *******************************************/
+		// chi square of a model against the observed fluxes flux_array, with errors err_array, of np points from ndatasets
+		// telescopes, point i taken by dataset_array[i] (0 to ndatasets - 1; points with other indices or err_array[i] <= 0 are left out). The
+		// magnifications are those of curve (one of the light curve functions above, e.g. &VBBinaryLensing::BinaryLightCurve)
+		// with parameters at t_array, kept in the instance. The source and blend fluxes of each
+		// dataset are the weighted least squares solution of flux = Fs * mag + Fb, returned in FsFb[2 * k] and FsFb[2 * k + 1]
+		// if FsFb is not NULL (Fb = 0 if the magnification of the dataset is constant, both 0 for a dataset without points);
+		// residual_array, if not NULL, receives the normalized residuals (flux - Fs * mag - Fb) / err of the points.
+		typedef void (VBBinaryLensing::*LightCurveFunction)(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, int np);
+		typedef void (VBBinaryLensing::*SepLightCurveFunction)(double *parameters, double *t_array, double *mag_array, double *y1_array, double *y2_array, double *sep_array, int np);
+		double LightCurveChi2(LightCurveFunction curve, double *parameters, double *t_array, double *flux_array, double *err_array, int *dataset_array, int ndatasets, int np, double *FsFb = 0, double *residual_array = 0);
+		double LightCurveChi2(SepLightCurveFunction curve, double *parameters, double *t_array, double *flux_array, double *err_array, int *dataset_array, int ndatasets, int np, double *FsFb = 0, double *residual_array = 0);
+		// the light curve functions of LightCurveChi2 for the C interface, by their number curve_id (see wrapVBBL_LightCurveChi2)
+		enum LightCurves { LCPSPL, LCPSPLParallax, LCESPL, LCESPLParallax, LCBinary, LCBinaryW, LCBinaryParallax, LCBinaryOrbital, LCBinaryKepler, LCBinSource, LCBinSourceParallax, LCBinSourceXallarap };
+		/*******************************************   end   *******************************************/
         
         void BinaryMag2_Npoint(double *s, double q,  double rho, \
 										double *y1s, double *y2s, \
 										int np, \
 										double *mags);
+		/******************************************* changed *******************************************/
+		// parallel version: points are split in chunks of _Npoint_chunk, scheduled on nthreads threads with work stealing
+		// (nthreads<=0 uses all hardware threads). Results do not depend on nthreads or on the scheduling.
+        void BinaryMag2_Npoint(double *s, double q,  double rho, \
+										double *y1s, double *y2s, \
+										int np, \
+										double *mags, int nthreads);
+
+		// magnification map of BinaryMag2 on the nx*ny grid x = x_min + ix*(x_max-x_min)/nx, y = y_min + iy*(y_max-y_min)/ny.
+		// The grid is cut in square tiles of _Map_tile pixels, scheduled on nthreads threads with work stealing
+		// (nthreads<=0 uses all hardware threads). mags[iy*nx+ix] receives the magnification and, if costs is not NULL,
+		// costs[iy*nx+ix] the computing time of that pixel in seconds.
+		void BinaryMagMap(double s, double q, double rho, \
+										double x_min, double x_max, double y_min, double y_max, \
+										int nx, int ny, \
+										double *mags, double *costs, int nthreads);
+
+		// point-source magnifications BinaryMag0(s[i], q, y1s[i], y2s[i]) of np points, solved _quintic_lanes at a time
+		// with the SIMD batched root finder; points whose roots do not converge go through the scalar BinaryMag0.
+		// Only the magnification is computed (no astrometry, no quadrupole and ghost image tests).
+		void BinaryMag0_Npoint(double *s, double q, double *y1s, double *y2s, int np, double *mags);
+
+		// number of _point, _theta, _curve and _skiplist_curve objects created by the calling thread so far,
+		// and number of slabs the object pools of the thread had to request from the system to hold them
+		static void ObjectPoolStatistics(long long *objects, long long *slabs);
+		/*******************************************   end   *******************************************/
 
 	// Old (v1) light curve functions, for a single calculation
 		double PSPLLightCurve(double *parameters, double t);
@@ -208,6 +382,9 @@ namespace VBBinaryLensingLibrary {
 		double f;
 		int nim;
         double LDastrox1,LDastrox2;
+		/******************************************* changed *******************************************/
+		double grad[5];			// BinaryMag2Gradient: derivatives of Mag
+		/*******************************************   end   *******************************************/
 		annulus *prev,*next;
 	};
 
@@ -221,9 +398,16 @@ class _theta{
 public: 
 	double th,maxerr,Mag,errworst,astrox1,astrox2;
 	_theta *prev,*next; // prev and next are pointers that point to _theta variable
+	/******************************************* changed *******************************************/
+	int index;			// position in the storage of the _thetas that created it (-1 if not created by a _thetas)
+	/*******************************************   end   *******************************************/
 
 	_theta(double);     // constructor: assign value to th
 
+	/******************************************* changed *******************************************/
+	static void * operator new(size_t);		// taken from / given back to the thread's object pool (see _object_pool)
+	static void operator delete(void *);
+	/*******************************************   end   *******************************************/
 };
 
 class _thetas{           /* only used in BinaryMag, not used in NewImages and OrderImages */
@@ -251,8 +435,36 @@ public:
 	                        //         and update that element's prev/next element(if they exist)'s 'next'/'prev'
 							//         (loop over the linked list, thus O(N) complexity)
 							//         (why not just delete 'stheta' as you already have the pointer? why border to use while loop?)
-
-
+	/******************************************* changed *******************************************/
+							//         now O(1): the element is unlinked and its slot is left unused until clear()
+
+	// The elements live in blocks of _thetas_block owned by the list, in order of creation, so that the index of an
+	// element never changes and no element is allocated on its own; clear() keeps the blocks for the next contour.
+	// The intervals [theta, theta->next] of the adaptive sampling are kept in a max-heap on their error, and their
+	// errors in a sum tree on the indices of the elements (this replaces _augmented_priority_queue).
+	void clear(void);						// empty list, the storage is kept
+	void push_error(double, _theta *);				// the interval starting at theta enters the heap with the given error
+	void pop_then_push_error(double, _theta *);		// the interval with the largest error leaves the heap, then theta's enters it
+	void rebuild_errors(void);						// heap of all the intervals, after insertions that did not go through it
+	_theta *worst(void) { return node(heap[0].index); }		// interval with the largest error
+	double total_error(void) { return sumerr[0]; }			// sum of the errors of the intervals in the heap
+	int created(void) { return nnodes; }					// elements created since clear(), removed ones included
+	_theta *node(int index) { return blocks[index / _thetas_block] + index % _thetas_block; }
+
+private:
+	static const int _thetas_block = 256;
+	struct heap_node{
+		double maxerr;
+		int index;
+	};
+	std::vector<_theta *> blocks;
+	int nnodes;								// elements created since the last clear(), i.e. index of the next one
+	std::vector<heap_node> heap;
+	std::vector<double> err, sumerr;		// error in the heap of each interval (0 if not in it), and sum over the
+											// subtree of each index in the implicit binary tree 0 -> 1, 2 -> 3, 4, 5, 6 ...
+	_theta *new_theta(double);
+	void update_sums(int);
+	/*******************************************   end   *******************************************/
 };
 
 /*
@@ -278,22 +490,37 @@ public:
 #define max_skiplist_level 2
 /*******************************************   end   *******************************************/
 
-class _point{									  // a total of 128 bytes per object, 2 cache lines
+/******************************************* changed *******************************************/
+// The fields are split in two cache lines, and the objects are aligned on them (see _object_pool):
+// the first line holds what the skip list walk and the ordering of the images read (links, theta, coordinates),
+// the second one the data of the contour integral, with the astrometric parabolas that only astrometry touches.
+class alignas(64) _point{						  // a total of 128 bytes per object, exactly 2 cache lines
 public:
 	double x1;                                    // this point's coordinate
 	double x2;
-	double parab,ds,dJ, parabastrox1 ; 			  // ds is x'^x" at this point
-												  // dJ is Jacobian determinant at this point
-	/******************************************* changed *******************************************/
-	//complex d,J2;
-	complex d ;								  	  // d is z'(theta) at this point
-												  // J2 is Partial^2(zs_c)/Partial(z)^2 at this point
 	_theta * theta ;							  // pointer
 	_point * next, * prev ;                       // pointers that point to _point variable
 	_point * next_array[max_skiplist_level+1] ;
 
-	double parabastrox2 ;
-	/*******************************************   end   *******************************************/
+	double parab,ds,dJ ;			 			  // ds is x'^x" at this point
+												  // dJ is Jacobian determinant at this point
+	complex d ;								  	  // d is z'(theta) at this point
+	double parabastrox1, parabastrox2 ;
+//class _point{									  // a total of 128 bytes per object, 2 cache lines
+//public:
+//	double x1;                                    // this point's coordinate
+//	double x2;
+//	double parab,ds,dJ, parabastrox1 ; 			  // ds is x'^x" at this point
+//												  // dJ is Jacobian determinant at this point
+//	//complex d,J2;
+//	complex d ;								  	  // d is z'(theta) at this point
+//												  // J2 is Partial^2(zs_c)/Partial(z)^2 at this point
+//	_theta * theta ;							  // pointer
+//	_point * next, * prev ;                       // pointers that point to _point variable
+//	_point * next_array[max_skiplist_level+1] ;
+//
+//	double parabastrox2 ;
+/*******************************************   end   *******************************************/
 
 	_point(double ,double,_theta *);              // constructor: assign value to x1, x2, and theta(pointer)
 												  //              each _point variable corresponds to a _theta variable
@@ -302,6 +529,11 @@ public:
 
 	double operator-(_point);                     // method: input a _point class variable, 
 												  //         return distance^2 between 'current _point' and 'input _point'
+
+	/******************************************* changed *******************************************/
+	static void * operator new(size_t);			  // taken from / given back to the thread's object pool (see _object_pool)
+	static void operator delete(void *);
+	/*******************************************   end   *******************************************/
 };
 
 
@@ -381,6 +613,11 @@ public:
 	double closest(_point *,_point **); 		  // method: not used (actually used one time in PlotCrit)
 	double closest2(_point *,_point **); 		  // method: not used
 	void complement(_point **,int,_point **,int); // method: not used
+
+	/******************************************* changed *******************************************/
+	static void * operator new(size_t);			  // taken from / given back to the thread's object pool (see _object_pool)
+	static void operator delete(void *);
+	/*******************************************   end   *******************************************/
 };
 
 class _sols{                                      //       a  _sols class variable is       a linked list of _curve variables, 
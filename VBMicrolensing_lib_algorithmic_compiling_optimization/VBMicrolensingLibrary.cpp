@@ -24,12 +24,33 @@ char systemslash = '/';
 #endif
 
 
+/******************************************* changed *******************************************/
+// standard headers first: VBMicrolensingLibrary.h defines macros (_L1, _L2) that clash with libstdc++ internals
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <cmath>
+/*******************************************   end   *******************************************/
 #include "VBMicrolensingLibrary.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+/******************************************* changed *******************************************/
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+/*******************************************   end   *******************************************/
 
 //#define _PRINT_ERRORS2
 //#define _PRINT_ERRORS
@@ -247,6 +268,96 @@ public:
 /*******************************************   end   *******************************************/
 
 
+/******************************************* changed *******************************************/
+// Free-list pool for the small objects created and destroyed by the thousands while sampling the contours
+// (_point, _theta, _curve, _skiplist_curve). Memory is requested from the system in slabs of _pool_slab_objects
+// objects, and deleted objects are put on a free list and handed out again by the next new, 
+// so that in steady state these classes never reach malloc/free. 
+// There is one pool per class and per thread (thread_local), hence no locking on new and delete. An object deleted 
+// by another thread than the one that created it goes to the free list of the deleting thread: the slot may then
+// belong to a slab of any thread, so the slabs are never given back to the system. At thread exit the free slots of
+// the thread are handed to a list shared by the pools of the class (under a mutex), where the threads started later
+// take them before requesting new slabs.
+#define _pool_slab_objects 256
+
+struct _object_pool_counters{
+	long long objects ;			// objects handed out by the pools of this thread
+	long long slabs ;			// slabs requested from the system by the pools of this thread
+};
+static thread_local _object_pool_counters pool_counters = {0, 0} ;
+
+template <class T> class _object_pool{
+	union slot{
+		slot * next ;
+		alignas(T) unsigned char storage[sizeof(T)] ;
+	};
+
+	struct orphans{				// free slots left by the threads that have exited
+		std::mutex mutex ;
+		slot * free_list = 0 ;
+	};
+
+	static orphans & shared(void)
+	{
+		static orphans * o = new orphans ;		// never destroyed, like the slabs
+		return *o ;
+	}
+
+	slot * free_list ;
+
+public:
+	_object_pool(void) : free_list(0) {}
+
+	~_object_pool(void)			// at thread exit: the free slots go to the shared list
+	{
+		if (!free_list) return ;
+		slot * tail = free_list ;
+		while (tail->next) tail = tail->next ;
+		orphans & o = shared() ;
+		std::lock_guard<std::mutex> lock(o.mutex) ;
+		tail->next = o.free_list ;
+		o.free_list = free_list ;
+	}
+
+	void * allocate(void)
+	{
+		if (!free_list) {
+			orphans & o = shared() ;
+			{
+				std::lock_guard<std::mutex> lock(o.mutex) ;
+				free_list = o.free_list ;
+				o.free_list = 0 ;
+			}
+		}
+		if (!free_list) {
+			slot * slab = (slot *)::operator new(sizeof(slot) * _pool_slab_objects) ;
+			for (int i = 0; i < _pool_slab_objects - 1; i++) slab[i].next = &slab[i + 1] ;
+			slab[_pool_slab_objects - 1].next = 0 ;
+			free_list = slab ;
+			pool_counters.slabs++ ;
+		}
+		slot * s = free_list ;
+		free_list = s->next ;
+		pool_counters.objects++ ;
+		return s ;
+	}
+
+	void deallocate(void * p)
+	{
+		slot * s = (slot *)p ;
+		s->next = free_list ;
+		free_list = s ;
+	}
+
+	static _object_pool & local(void)
+	{
+		static thread_local _object_pool pool ;
+		return pool ;
+	}
+};
+/*******************************************   end   *******************************************/
+
+
 
 
 
@@ -265,6 +376,9 @@ public:
 	_skiplist_curve * partneratstart, * partneratend ;
 	double parabstart,Magstart,errstart,  parabastrox1, parabastrox2 ;
 
+	static void * operator new(size_t) { return _object_pool<_skiplist_curve>::local().allocate() ; }
+	static void operator delete(void * p) { _object_pool<_skiplist_curve>::local().deallocate(p) ; }
+
 	
 	_skiplist_curve(_point * p1, int new_Level)				
 	{											// constructor: used one time in BinaryMag() (and) two times in OrderImages(): if (nprec<npres)
@@ -561,6 +675,18 @@ public:
 	}			  
 
 
+	void clear(void)							// method: deletes the curves as the destructor, and leaves the object empty and reusable
+	{											//		   (the images of the workspace, see _workspace_images)
+		_skiplist_curve * scan1, * scan2 ;
+		for (scan1 = first; scan1; scan1 = scan2) {
+			scan2 = scan1->next;
+			delete scan1;
+		}
+		length = 0 ;
+		first = last = 0 ;
+	}
+
+
 	void drop(_skiplist_curve * ref) 
 	{ 											// method: used only one time in OrderImages(): if-if, which near the while loop and divide
 												//
@@ -623,6 +749,552 @@ public:
 /*******************************************   end   *******************************************/
 
 
+/******************************************* changed *******************************************/
+// Flat copy of the image tracks of a _sols_for_skiplist_curve, for BinaryMagContours and the derivatives of the contour
+// integral (see _contour_gradient). The points of all the tracks are stored one after the other, track t in
+// [start[t], start[t+1]); w[k] is the sign of the contribution of the segment from point k to point k+1, that is
+// sign[k] = (dJ>0) ? -1 : 1 as in OrderImages, or 0 at the last point of a track.
+class _image_tracks{
+public:
+	std::vector<double> x1, x2, th, sign, w ;				// per point
+	std::vector<int> start ;								// per track, plus the end of the last track
+	std::vector<int> partneratstart, partneratend ;			// per track: index of the partner track, -1 if none
+	std::vector<_skiplist_curve *> curves ;
+	int npoints ;
+
+	_image_tracks(void) : npoints(0) {}
+
+	void load(_sols_for_skiplist_curve *) ;		// copies the tracks, keeping the capacity of the arrays
+	std::vector<complex> dz ;					// derivatives of the points, 5 per point (see _contour_gradient)
+	std::vector<complex> d, dd ;				// tangent dz/dtheta of each point, and its derivatives, 5 per point
+	std::vector<double> ds, dds ;				// ds of each point (see _Jacobians2), and its derivatives, 5 per point
+	void area_gradient(double *dArea) ;			// derivatives of the area, from dz, d, dd, ds and dds (see _contour_gradient)
+};
+/*******************************************   end   *******************************************/
+
+/******************************************* changed *******************************************/
+// Sampling of one point of a light curve with frozen sampling (see RecordSampling): the branch of BinaryMag2, the radii
+// of the annuli of BinaryMagDark, as fractions of the limb darkened flux in their order of insertion, and the angles
+// of the BinaryMag contours in the order of the calls, each in its order of insertion with the index of the element it
+// went after (see _theta::index). The error estimates of the converged annuli and contours bound those of the replayed ones.
+struct _frozen_point{
+	int branch;						// 1 point source, 2 BinaryMagDark, 3 MultipoleMag; 0 not recorded
+	std::vector<double> annuli;
+	double annuli_error;
+	std::vector<size_t> contours;	// contour k: thetas[contours[k]] to thetas[contours[k + 1] - 1], error estimate errors[k]
+	std::vector<double> thetas, errors;
+	std::vector<int> parents;
+	complex seeds[5];				// branch 2: roots BinaryMagDark started from, set by BinaryMag2 and kept by clear
+
+	_frozen_point(void) {
+		for (int i = 0; i < 5; i++) seeds[i] = 0.;
+		clear();
+	}
+	void clear(void) {
+		branch = 0;
+		annuli.clear();
+		annuli_error = 0.;
+		contours.assign(1, 0);
+		thetas.clear();
+		errors.clear();
+		parents.clear();
+	}
+};
+
+// LightCurveChi2: arrays of the light curve and flux fit of each dataset, kept to avoid reallocations
+struct _chi2_arrays{
+	std::vector<double> mags, y1s, y2s, seps;
+	std::vector<double> sums;		// 5 per dataset: sums of w, w mag, w mag^2, w flux, w mag flux, with w = 1 / err^2
+	std::vector<double> fluxes;		// 2 per dataset: Fs, Fb
+
+	void resize(int np, int ndatasets) {
+		if ((int)mags.size() < np) {
+			mags.resize(np);
+			y1s.resize(np);
+			y2s.resize(np);
+			seps.resize(np);
+		}
+		sums.assign(5 * ndatasets, 0.);
+		fluxes.assign(2 * ndatasets, 0.);
+	}
+};
+
+class _contour_helpers;
+
+// State that used to live in function-level static variables and is carried from one call to the next.
+// Each VBMicrolensing instance owns one, so that independent instances never share solver state.
+struct _solver_workspace{
+	complex coefs0[24], a0, q0;		// BinaryMag0: equation coefficients, cached on (av0,qv0)
+	double av0, qv0;
+	complex coefs[24];				// BinaryMag: equation coefficients, cached on (av,qv)
+	double av, qv;
+	complex zr_binary[5];			// binary NewImages: roots of the previous call, used as starting guesses
+	const complex *zr_given;		// binary NewImages: roots already solved by the parallel contour of BinaryMag, if not NULL
+	std::minstd_rand engine;		// levels of new skiplist nodes in BinaryMag, MultiMag and the Order*Images, from the default
+									// seed: the levels shape the skiplists, not the results, and the worker instances are built at every call
+	_thetas thetas;					// BinaryMag and MultiMag: sampled contour and heap of its intervals, reused to avoid reallocations
+	_image_tracks tracks;			// BinaryMagContours and _contour_gradient: flat copy of the image tracks of BinaryMag
+	_sols_for_skiplist_curve images;	// image contours of the calls whose caller does not keep them (see _workspace_images)
+	bool warm_start;				// BinaryMag2 at the source centers of a light curve: seeded by warm_seeds (see _warm_start_scope)
+	int warm_count;					// source centers of the curve so far in zr_warm and y_warm (at most 2: the last and the one before)
+	complex zr_warm[2][5], y_warm[2];
+	std::vector<double> theta_seeds;	// BinaryMag with frozen sampling, replay: angles of the recorded contour (see _frozen_contour_begin)
+	int frozen_mode;				// frozen sampling: 0 off, 1 record, 2 replay (see RecordSampling and FreezeSampling)
+	bool frozen_curve;				// in a light curve function (see _frozen_sampling_scope), whose next point is frozen_next
+	size_t frozen_next;
+	std::vector<_frozen_point> frozen;
+	_frozen_point *frozen_point;	// record of the BinaryMag2 call under way, NULL outside them or without frozen sampling
+	size_t frozen_contour;			// replay: next contour of frozen_point
+	double *grad;					// BinaryMag2Gradient: derivatives of the magnification under way, NULL otherwise
+	double grad0[5];				// BinaryMag2Gradient: derivatives of the point-source magnification at the source center
+	_chi2_arrays chi2;				// LightCurveChi2: light curve and flux fit
+	std::vector<double> point_tols;	// SetPointTolerances: Tol of each point of the next light curve, none if empty
+	//_augmented_priority_queue APQ;	// BinaryMag and MultiMag: heap of sampled intervals, reused to avoid reallocations
+	double tlc_q[3], tlc_prold[5];	// single-point TripleLightCurve: lens geometry cached on the parameters
+	complex tlc_s[3];
+	VBMicrolensing::Method tlc_oldmethod;
+	std::vector<double> geom_q;		// last lens configuration passed to SetLensGeometry, to set up worker instances
+	std::vector<complex> geom_s;
+	std::vector<complex> caustic_centers;	// planetary caustics of the lenses below 0.01 times the heaviest one, and their squared
+	std::vector<double> caustic_sizes2;		// sizes 36 q / d^2, as in BinaryMag0: the safedist of MultiMag0 (see SetLensGeometry)
+	int stats_depth;				// nesting of the magnification calls, to reset stats only on the outermost one
+	std::vector<std::unique_ptr<VBMicrolensing>> contour_workers;	// BinaryMag with contourthreads > 1: worker instance of each thread
+	std::unique_ptr<_contour_helpers> contour_helpers;	// and the helper threads, both kept from one call to the next
+
+	_solver_workspace(void) : av0(-1.0), qv0(-1.0), av(-1.0), qv(-1.0), zr_given(0), warm_start(false), warm_count(0), frozen_mode(0), frozen_curve(false), frozen_next(0), frozen_point(0), frozen_contour(0), grad(0), tlc_oldmethod(VBMicrolensing::Method::Nopoly), stats_depth(0) {
+		reset_seeds();
+		for (int i = 0; i < 5; i++) tlc_prold[i] = 0;
+	}
+
+	void reset_seeds(void) {		// back to the starting guesses of a fresh instance
+		for (int i = 0; i < 5; i++) zr_binary[i] = 0.;
+	}
+
+	void warm_seeds(complex y) {	// roots of the last source center, moved by the step along the trajectory since the one before
+		double r = 0., step2;
+		if (warm_count > 1) {
+			step2 = real((y_warm[0] - y_warm[1]) * conj(y_warm[0] - y_warm[1]));
+			if (step2 > 0) r = real((y - y_warm[0]) * conj(y_warm[0] - y_warm[1])) / step2;
+			if (r < 0. || r > 2.) r = 0.;	// not further along the trajectory (unsorted times)
+		}
+		for (int i = 0; i < 5; i++) zr_binary[i] = zr_warm[0][i] + r * (zr_warm[0][i] - zr_warm[1][i]);
+	}
+
+	void keep_warm(complex y, bool good) {	// roots just solved at the source center y, if good
+		if (!good) {
+			warm_count = 0;
+			return;
+		}
+		for (int i = 0; i < 5; i++) {
+			zr_warm[1][i] = zr_warm[0][i];
+			zr_warm[0][i] = zr_binary[i];
+		}
+		y_warm[1] = y_warm[0];
+		y_warm[0] = y;
+		if (warm_count < 2) warm_count++;
+	}
+};
+
+_workspace_ptr::_workspace_ptr(void) : p(new _solver_workspace) {}
+
+_workspace_ptr::_workspace_ptr(const _workspace_ptr &) : p(new _solver_workspace) {}
+
+_workspace_ptr &_workspace_ptr::operator=(const _workspace_ptr &other) {
+	if (this != &other) p.reset(new _solver_workspace);
+	return *this;
+}
+
+_workspace_ptr::~_workspace_ptr(void) {}
+
+// Images for a call of BinaryMag0, BinaryMag, BinaryMagSafe or MultiMag whose caller only needs them until the next
+// call: called with reuse_images = true, it fills the images of the workspace instead of a new _sols_for_skiplist_curve,
+// and the caller empties them with clear() instead of delete.
+static inline _sols_for_skiplist_curve *_workspace_images(_solver_workspace *ws)
+{
+	return &ws->images;
+}
+
+// Declared at the top of the light curve functions with the warmstart setting: for the duration of the curve, the BinaryMag0
+// of BinaryMag2 at each source center starts the roots from those of the previous centers, extrapolated along the trajectory
+// (see warm_seeds), and falls back to the cold seeds when that solve fails. Only these solves seed and keep the warm roots:
+// the other point-source and contour solves of the point (MultipoleMag, BinaryMagDark, BinaryMagSafe) leave them alone.
+class _warm_start_scope{
+	_solver_workspace *ws;
+public:
+	_warm_start_scope(_solver_workspace *ws, bool warmstart) : ws(ws)
+	{
+		ws->warm_start = warmstart;
+		ws->warm_count = 0;
+	}
+	~_warm_start_scope(void) { ws->warm_start = false; }
+};
+
+// guard of the warm start: the polished roots are five distinct ones, none of them taken twice
+static inline bool _distinct_roots(const complex *z)
+{
+	for (int i = 0; i < 4; i++) {
+		for (int j = i + 1; j < 5; j++) {
+			if (abs(z[i] - z[j]) < 1.e-10) return false;
+		}
+	}
+	return true;
+}
+
+// Declared at the top of the light curve functions: takes the tolerances of SetPointTolerances out of the workspace, so that
+// they serve this curve only. point(i) sets Tol to that of the point i, given to BinaryMag2, ESPLMag2 and what they call;
+// the instance Tol is back at the end of the curve
+class _point_tolerance_scope{
+	double &Tol;
+	double Tol0;
+	std::vector<double> tols;
+public:
+	_point_tolerance_scope(double &Tol, std::vector<double> &point_tols) : Tol(Tol), Tol0(Tol)
+	{
+		tols.swap(point_tols);
+	}
+	void point(int i) { Tol = (i < (int)tols.size() && tols[i] > 0) ? tols[i] : Tol0; }
+	~_point_tolerance_scope(void) { Tol = Tol0; }
+};
+
+// Declared at the top of the binary lens light curve functions: with frozen sampling, each BinaryMag2 call of the curve
+// takes the record of the next point (see _frozen_sampling_point). In record mode, the records of the previous curve are dropped.
+// Both modes start the roots from the seeds of a fresh instance, so that the replay at the recorded parameters solves
+// the same equations from the same starting points as the record, and both give the curve of a fresh instance bit for bit.
+class _frozen_sampling_scope{
+	_solver_workspace *ws;
+public:
+	_frozen_sampling_scope(_solver_workspace *ws) : ws(ws)
+	{
+		ws->frozen_curve = ws->frozen_mode != 0;
+		ws->frozen_next = 0;
+		if (ws->frozen_mode == 1) ws->frozen.clear();
+		if (ws->frozen_mode != 0) ws->reset_seeds();
+	}
+	~_frozen_sampling_scope(void)
+	{
+		ws->frozen_curve = false;
+		ws->frozen_point = 0;
+	}
+};
+
+// BinaryMag2 with frozen sampling: the record of the current point of the light curve, emptied in record mode;
+// NULL outside the light curve functions, and in replay mode for points beyond the recorded ones
+static _frozen_point *_frozen_sampling_point(_solver_workspace *ws)
+{
+	ws->frozen_point = 0;
+	ws->frozen_contour = 0;
+	if (!ws->frozen_curve) return 0;
+	if (ws->frozen_mode == 1) {
+		ws->frozen.emplace_back();
+		ws->frozen_point = &ws->frozen.back();
+	}
+	else if (ws->frozen_next < ws->frozen.size()) {
+		ws->frozen_point = &ws->frozen[ws->frozen_next];
+	}
+	ws->frozen_next++;
+	return ws->frozen_point;
+}
+
+// BinaryMag with frozen sampling, before the loop of the contour: in record mode, drops what a failed contour left in the
+// record and returns 0; in replay mode, copies the angles of the next recorded contour of the point to the seeds, its error
+// estimate to *err, and returns their number (0 if the contours of the point are used up: the contour is sampled as usual)
+static int _frozen_contour_begin(_solver_workspace *ws, double *err)
+{
+	_frozen_point *frozen = ws->frozen_point;
+	if (ws->frozen_mode == 1) {
+		frozen->thetas.resize(frozen->contours.back());
+		frozen->parents.resize(frozen->contours.back());
+		return 0;
+	}
+	if (ws->frozen_contour + 1 >= frozen->contours.size()) return 0;
+	size_t begin = frozen->contours[ws->frozen_contour], end = frozen->contours[ws->frozen_contour + 1];
+	ws->theta_seeds.assign(frozen->thetas.begin() + begin, frozen->thetas.begin() + end);
+	*err = frozen->errors[ws->frozen_contour];
+	return (int)(end - begin);
+}
+
+// BinaryMag in replay mode: *itheta is the element that the recorded point iseed of the contour goes after, if it is still
+// the same interval as in the record. Not so after a point that fails in NewImages here and not in the record (or vice
+// versa), since the following elements are created in another order: the rest of the contour is then sampled as usual.
+static bool _frozen_parent(_solver_workspace *ws, _thetas *Thetas, int iseed, _theta **itheta)
+{
+	_frozen_point *frozen = ws->frozen_point;
+	int index = frozen->parents[frozen->contours[ws->frozen_contour] + iseed];
+	double th = ws->theta_seeds[iseed];
+	if (index >= Thetas->created()) return false;
+	_theta *prev = Thetas->node(index);
+	if (!prev->next || prev->next->prev != prev || !(prev->th < th && th < prev->next->th)) return false;	// removed, or elsewhere
+	*itheta = prev;
+	return true;
+}
+
+// BinaryMag in record mode: a point has just been inserted in the contour
+static inline void _frozen_insertion(_solver_workspace *ws, _theta *stheta)
+{
+	ws->frozen_point->thetas.push_back(stheta->th);
+	ws->frozen_point->parents.push_back(stheta->prev->index);
+}
+
+// BinaryMag with frozen sampling, when the contour has converged with error estimate err: the contour is closed in the
+// record of the point (record mode), or the next recorded contour goes to the next call (replay mode)
+static void _frozen_contour_end(_solver_workspace *ws, double err)
+{
+	_frozen_point *frozen = ws->frozen_point;
+	if (ws->frozen_mode == 1) {
+		frozen->contours.push_back(frozen->thetas.size());
+		frozen->errors.push_back(err);
+	}
+	else {
+		ws->frozen_contour++;
+	}
+}
+
+// Forward-mode derivatives of the images with respect to (s, q, y1, y2, rho), in the frame of BinaryMag0 and BinaryMag:
+// the less massive lens m2 in the origin, the other one, m1, in a on the real axis, and the source center in y + a m1.
+// Differentiating the lens equation zeta = z - m1 / (conj(z) - a) - m2 / conj(z) at an image z gives dz + g1 conj(dz) = w,
+// with g1 = m1 / (conj(z) - a)^2 + m2 / conj(z)^2 and w the change of zeta plus that of the lens terms at fixed z,
+// whence dz = (w - g1 conj(w)) / J, J = 1 - |g1|^2. No root finding is involved: the images are those already found.
+struct _lens_tangents{
+	double a, m1, m2, da, dm1;		// da/ds, and dm1/dq = -dm2/dq
+
+	_lens_tangents(double s, double q) {
+		double qs = (q < 1) ? q : 1 / q;
+		a = (q < 1) ? -s : s;
+		da = (q < 1) ? -1. : 1.;
+		m1 = 1 / (1 + qs);
+		m2 = qs * m1;
+		dm1 = da / ((1 + q) * (1 + q));
+	}
+
+	// derivatives dz[5] of the image z of the source point at rho * e from the center (e = 0 for the center itself),
+	// and, if dmag is not NULL, those of the point-source magnification 1/|J| of the image
+	void image(complex z, complex e, complex *dz, double *dmag) const {
+		complex u = 1. / (conj(z) - a), v = 1. / conj(z);
+		complex g1 = m1 * u * u + m2 * v * v;
+		complex w[5] = { da * m1 * (1. + u * u), dm1 * (a + u - v), complex(1., 0.), complex(0., 1.), e };
+		double J = 1. - real(g1 * conj(g1));
+		for (int j = 0; j < 5; j++) dz[j] = (w[j] - g1 * conj(w[j])) / J;
+		if (dmag) {
+			complex g2 = -2. * (m1 * u * u * u + m2 * v * v * v);	// dg1/dconj(z)
+			complex dg1[5] = { 2. * da * m1 * u * u * u, dm1 * (u * u - v * v), complex(0., 0.), complex(0., 0.), complex(0., 0.) };
+			for (int j = 0; j < 5; j++) {
+				complex dg = dg1[j] + g2 * conj(dz[j]);
+				dmag[j] = 2. * real(conj(g1) * dg) / (J * fabs(J));	// d(1/|J|) = -dJ / (J |J|), dJ = -2 Re(conj(g1) dg1)
+			}
+		}
+	}
+
+	// the image z of the contour point at r * e from the source center, as image above, with the terms of the parabolic
+	// correction of OrderImages: the tangent d = dz/dtheta and ds (as computed by _Jacobians2), and their derivatives dd[5]
+	// and dds[5] at fixed theta, through those of g1 and of g2 = dg1/dconj(z) (J2 = conj(g2) in _Jacobians1)
+	void contour_point(complex z, complex e, double r, complex *dz, complex *d, complex *dd, double *ds, double *dds) const {
+		complex u = 1. / (conj(z) - a), v = 1. / conj(z);
+		complex g1 = m1 * u * u + m2 * v * v;
+		complex g2 = -2. * (m1 * u * u * u + m2 * v * v * v);
+		complex g3 = 6. * (m1 * u * u * u * u + m2 * v * v * v * v);	// dg2/dconj(z)
+		complex dy = complex(0., r) * e;								// dzeta/dtheta
+		double J = 1. - real(g1 * conj(g1));
+		*d = (dy - g1 * conj(dy)) / J;
+		*ds = (imag(dy * (*d) * (*d) * conj(g2)) + r * r) / J;
+		image(z, e, dz, 0);
+		complex dg1e[5] = { 2. * da * m1 * u * u * u, dm1 * (u * u - v * v), complex(0., 0.), complex(0., 0.), complex(0., 0.) };
+		complex dg2e[5] = { -6. * da * m1 * u * u * u * u, -2. * dm1 * (u * u * u - v * v * v), complex(0., 0.), complex(0., 0.), complex(0., 0.) };
+		for (int j = 0; j < 5; j++) {
+			complex ddy = (j == 4) ? complex(0., 1.) * e : complex(0., 0.);	// d(dzeta/dtheta), only along rho
+			complex dg1 = dg1e[j] + g2 * conj(dz[j]), dg2 = dg2e[j] + g3 * conj(dz[j]);
+			double dJ = -2. * real(conj(g1) * dg1);
+			dd[j] = (ddy - dg1 * conj(dy) - g1 * conj(ddy) - (*d) * dJ) / J;
+			dds[j] = (imag((ddy * (*d) + 2. * dy * dd[j]) * (*d) * conj(g2) + dy * (*d) * (*d) * conj(dg2)) + ((j == 4) ? 2. * r : 0.) - (*ds) * dJ) / J;
+		}
+	}
+};
+
+// BinaryMag0 with BinaryMag2Gradient: derivatives grad[5] of the point-source magnification, the sum of 1/|J| on the images
+// left by BinaryMag0 (one point per track); grad[4] (rho) is 0
+static void _point_gradient(_sols_for_skiplist_curve *Images, const _lens_tangents &lens, double *grad)
+{
+	complex dz[5];
+	double dmag[5];
+
+	for (int j = 0; j < 5; j++) grad[j] = 0.;
+	for (_skiplist_curve *scurve = Images->first; scurve; scurve = scurve->next) {
+		lens.image(complex(scurve->first->x1, scurve->first->x2), complex(0., 0.), dz, dmag);
+		for (int j = 0; j < 5; j++) grad[j] += dmag[j];
+	}
+}
+
+// BinaryMag with BinaryMag2Gradient: derivatives grad[5] of the magnification Mag of the image contours Images of the source
+// circle of radius r = dr * rho. Each point of the contours moves by its tangents at fixed angle on the source circle, and the
+// trapezium sum of the area and its parabolic corrections are differentiated accordingly (see _image_tracks::area_gradient)
+static void _contour_gradient(_solver_workspace *ws, _sols_for_skiplist_curve *Images, double s, double q, double r, double dr, double Mag, double *grad)
+{
+	_image_tracks &tracks = ws->tracks;
+	_lens_tangents lens(s, q);
+
+	tracks.load(Images);
+	tracks.dz.resize(5 * tracks.npoints);
+	tracks.d.resize(tracks.npoints);
+	tracks.dd.resize(5 * tracks.npoints);
+	tracks.ds.resize(tracks.npoints);
+	tracks.dds.resize(5 * tracks.npoints);
+	for (int k = 0; k < tracks.npoints; k++) {		// the contour points are centered on the mass center (see _Jacobians2)
+		lens.contour_point(complex(tracks.x1[k] + lens.a * lens.m1, tracks.x2[k]), complex(cos(tracks.th[k]), sin(tracks.th[k])), r,
+			&tracks.dz[5 * k], &tracks.d[k], &tracks.dd[5 * k], &tracks.ds[k], &tracks.dds[5 * k]);
+	}
+	tracks.area_gradient(grad);
+	for (int j = 0; j < 5; j++) grad[j] /= M_PI * r * r;
+	grad[4] = dr * (grad[4] - 2 * Mag / r);
+}
+
+// BinaryMagDark with BinaryMag2Gradient: the magnification is a linear combination of those of the annuli, with coefficients
+// fixed by the limb darkening profile, so its derivatives are the same combination of theirs
+static void _annuli_gradient(annulus *first, double *grad)
+{
+	for (int j = 0; j < 5; j++) grad[j] = 0.;
+	for (annulus *scan = first->next; scan; scan = scan->next) {
+		double w = (scan->cum - scan->prev->cum) / (scan->bin * scan->bin - scan->prev->bin * scan->prev->bin);
+		for (int j = 0; j < 5; j++) grad[j] += (scan->grad[j] * scan->bin * scan->bin - scan->prev->grad[j] * scan->prev->bin * scan->prev->bin) * w;
+	}
+}
+
+#ifdef _HOTPATH_STATS
+// declared at the top of each magnification function: the outermost one clears the statistics of the previous call
+class _stats_scope{
+	int &depth;
+public:
+	_stats_scope(_call_stats &stats, int &stats_depth) : depth(stats_depth)
+	{
+		if (depth++ == 0) stats = _call_stats();
+	}
+	~_stats_scope(void) { depth--; }
+};
+
+// counters of a worker instance added to those of the call that used it (BinaryMag2_branch is not a counter)
+static void _add_worker_stats(_call_stats &stats, const _call_stats &worker)
+{
+	stats.NPS += worker.NPS;
+	stats.NewImages_calls += worker.NewImages_calls;
+	stats.laguerre_iterations += worker.laguerre_iterations;
+	stats.polish_iterations += worker.polish_iterations;
+	stats.OrderImages_seconds += worker.OrderImages_seconds;
+	stats.BinaryMagSafe_retries += worker.BinaryMagSafe_retries;
+	stats.annuli += worker.annuli;
+}
+#endif
+
+
+// Tile scheduler for the parallel MultiMagMap. Each thread owns a contiguous range of tiles and takes them
+// from the front; a thread with an empty range steals single tiles from the back of the other ranges,
+// so that a few expensive tiles along the caustics do not leave the other threads idle.
+class _work_stealing_chunks{
+public:
+	struct chunk_range{
+		std::mutex lock ;
+		int front ;				// chunks [front, back) are still to be processed
+		int back ;
+	};
+
+	int nranges ;
+	std::unique_ptr<chunk_range[]> ranges ;
+
+	_work_stealing_chunks(int nthreads, int nchunks) : nranges(nthreads), ranges(new chunk_range[nthreads]) {
+		for (int i = 0; i < nranges; i++) {
+			ranges[i].front = (int)(((long long)nchunks * i) / nranges) ;
+			ranges[i].back  = (int)(((long long)nchunks * (i + 1)) / nranges) ;
+		}
+	}
+
+	int next(int id)			// index of the next chunk for thread 'id', -1 when all chunks are taken
+	{
+		{
+			std::lock_guard<std::mutex> guard(ranges[id].lock) ;
+			if (ranges[id].front < ranges[id].back) return ranges[id].front++ ;
+		}
+		for (int k = 1; k < nranges; k++) {
+			chunk_range &victim = ranges[(id + k) % nranges] ;
+			std::lock_guard<std::mutex> guard(victim.lock) ;
+			if (victim.front < victim.back) return --victim.back ;
+		}
+		return -1 ;
+	}
+};
+
+#define _Map_tile 16			// side of the square tiles of MultiMagMap, in pixels
+
+// Helper threads of the parallel contour of BinaryMag and MultiMag (contourthreads > 1), kept in the workspace from one
+// call to the next and joined by its destructor. For each batch, run(njobs, job)
+// wakes the helpers, every thread (the calling one included) takes jobs from a shared counter, and run returns when all the jobs are done.
+class _contour_helpers{
+	std::vector<std::thread> threads ;
+	std::mutex lock ;
+	std::condition_variable wake, done ;
+	int generation, running, njobs ;
+	bool quit ;
+	std::atomic<int> next_job ;
+	const std::function<void(int, int)> *job ;	// job(thread id, job index) of the batch under way, thread id 0 is the calling thread
+
+	void work(int id)
+	{
+		int j ;
+		while ((j = next_job++) < njobs) (*job)(id, j) ;
+	}
+
+	void helper(int id)
+	{
+		int seen = 0 ;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> guard(lock) ;
+				wake.wait(guard, [&] { return quit || generation != seen ; }) ;
+				if (quit) return ;
+				seen = generation ;
+			}
+			work(id) ;
+			std::lock_guard<std::mutex> guard(lock) ;
+			if (--running == 0) done.notify_one() ;
+		}
+	}
+
+public:
+	_contour_helpers(int nthreads) : generation(0), running(0), njobs(0), quit(false), next_job(0), job(0) {
+		for (int id = 1; id < nthreads; id++) threads.emplace_back(&_contour_helpers::helper, this, id) ;
+	}
+
+	int size(void) const { return (int)threads.size() + 1 ; }
+
+	~_contour_helpers(void)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock) ;
+			quit = true ;
+		}
+		wake.notify_all() ;
+		for (auto &t : threads) t.join() ;
+	}
+
+	void run(int n, const std::function<void(int, int)> &job_)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock) ;
+			job = &job_ ;
+			njobs = n ;
+			next_job = 0 ;
+			running = (int)threads.size() ;
+			generation++ ;
+		}
+		wake.notify_all() ;
+		work(0) ;
+		std::unique_lock<std::mutex> guard(lock) ;
+		done.wait(guard, [&] { return running == 0 ; }) ;
+	}
+};
+
+#define _Contour_parallel_NPS 256	// BinaryMag and MultiMag with contourthreads > 1: points sampled serially before going to batches
+#define _Contour_batch 64			// intervals with the largest errors split in each batch of the parallel contour
+#define _Contour_sector 8			// consecutive new points of a batch solved by one thread, each from the roots of the previous one
+/*******************************************   end   *******************************************/
+
+
 
 
 
@@ -659,6 +1331,10 @@ VBMicrolensing::VBMicrolensing() {
 	t0_par_fixed = -1;
 	t0_par = 7000;
 	minannuli = 1;
+	/******************************************* changed *******************************************/
+	contourthreads = 1;
+	warmstart = false;
+	/*******************************************   end   *******************************************/
 	curLDprofile = LDlinear;
 	a1 = 0;
 	npLD = 0;
@@ -689,6 +1365,9 @@ VBMicrolensing::VBMicrolensing() {
 	Mag0 = 0;
 	NPcrit = 200;
 	ESPLoff = true;
+	/******************************************* changed *******************************************/
+	ESPLin = ESPLout = ESPLinastro = ESPLoutastro = 0;
+	/*******************************************   end   *******************************************/
 	multidark = false;
 	astrometry = false;
 	mass_luminosity_exponent = 4.0;
@@ -698,6 +1377,9 @@ VBMicrolensing::VBMicrolensing() {
 	squarecheck = false;
 	CumulativeFunction = &VBDefaultCumulativeFunction;
 	SelectedMethod = Method::Nopoly;
+	/******************************************* changed *******************************************/
+	stats = _call_stats();			// ws: see _workspace_ptr
+	/*******************************************   end   *******************************************/
 }
 
 VBMicrolensing::~VBMicrolensing() {
@@ -820,7 +1502,6 @@ VBMicrolensing::~VBMicrolensing() {
 	}
 
 	//delete s_offset;
-
 }
 
 #pragma endregion
@@ -828,26 +1509,84 @@ VBMicrolensing::~VBMicrolensing() {
 #pragma region single-source-mag
 
 
-void VBMicrolensing::LoadESPLTable(char* filename) {
-	FILE* f;
+/******************************************* changed *******************************************/
+// ESPL tables loaded so far in this process, by file name. Each file holds the four tables ESPLin, ESPLout,
+// ESPLinastro, ESPLoutastro one after the other; it is mapped read-only in memory (or read once into the heap 
+// when it cannot be mapped, e.g. on Windows) and never released, since all the instances that loaded it keep pointers
+// into it. Returns 0, caching nothing, if the file cannot be opened or is shorter than the four tables.
+static const double * shared_ESPL_table(const char *filename)
+{
+	static std::mutex lock;
+	static std::vector<std::pair<std::string, const double *> > tables;
+	const size_t table_size = 4 * sizeof(double) * __rsize_ESPL * __zsize_ESPL;
 
-	if ((f = fopen(filename, "rb")) != 0) {
-		/******************************************* changed *******************************************/
-		fread(ESPLin, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
-		fread(ESPLout, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
-		fread(ESPLinastro, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
-		fread(ESPLoutastro, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
-		/*******************************************   end   *******************************************/
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto &table : tables) {
+		if (table.first == filename) return table.second;
+	}
+
+	const double * data = 0;
+#ifndef _WIN32
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return 0;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= table_size) {
+		void * map = mmap(0, table_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (map != MAP_FAILED) data = (const double *)map;
+	}
+	close(fd);
+#endif
+	if (!data) {
+		FILE *f;
+		if ((f = fopen(filename, "rb")) == 0) return 0;
+		double * buffer = (double *)calloc(4 * __rsize_ESPL * __zsize_ESPL, sizeof(double));
+		size_t nread = fread(buffer, sizeof(double), 4 * __rsize_ESPL * __zsize_ESPL, f);
 		fclose(f);
+		if (nread < 4 * (size_t)__rsize_ESPL * __zsize_ESPL) {
+			free(buffer);
+			return 0;
+		}
+		data = buffer;
+	}
+	tables.push_back(std::make_pair(std::string(filename), data));
+	return data;
+}
+
+void VBMicrolensing::LoadESPLTable(char* filename) {
+	//FILE* f;
+	//
+	//if ((f = fopen(filename, "rb")) != 0) {
+	//	fread(ESPLin, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
+	//	fread(ESPLout, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
+	//	fread(ESPLinastro, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
+	//	fread(ESPLoutastro, sizeof(double), __rsize_ESPL * __zsize_ESPL, f);
+	//	fclose(f);
+	//	ESPLoff = false;
+	//}
+	//else {
+	//	printf("\nESPL table not found !");
+	//}
+	const double* table = shared_ESPL_table(filename);
+
+	if (table) {
+		const int n = __rsize_ESPL * __zsize_ESPL;
+		ESPLin = (const double (*)[__zsize_ESPL])(table);
+		ESPLout = (const double (*)[__zsize_ESPL])(table + n);
+		ESPLinastro = (const double (*)[__zsize_ESPL])(table + 2 * n);
+		ESPLoutastro = (const double (*)[__zsize_ESPL])(table + 3 * n);
 		ESPLoff = false;
 	}
 	else {
-		printf("\nESPL table not found !");
+		printf("\nESPL table not found or short !");
 	}
 }
+/*******************************************   end   *******************************************/
 
 double VBMicrolensing::PSPLMag(double u) {
-	static double u2, u22;
+	/******************************************* changed *******************************************/
+	double u2, u22;
+	//static double u2, u22;
+	/*******************************************   end   *******************************************/
 	u2 = u * u;
 	u22 = u2 + 2;
 	if (astrometry) {
@@ -1082,21 +1821,32 @@ double VBMicrolensing::ESPLMagDark(double u, double RSv) {
 #pragma region binary-mag
 
 /******************************************* changed *******************************************/
-double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v, _sols_for_skiplist_curve ** Images) {
+double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v, _sols_for_skiplist_curve ** Images, bool reuse_images) {
 //double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v, _sols ** Images) {
 /*******************************************   end   *******************************************/
-	static complex a, q, m1, m2, y;
-	static double av = -1.0, qv = -1.0;
-	static complex  coefs[24], d1, d2, dy, dJ, dz;
-	static double Mag, Ai;
-
-	static _theta* stheta;
 	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	// the coefficients cached on (s,q) live in the per-instance workspace, everything else is an automatic variable
+	complex &a = ws->a0, &q = ws->q0, m1, m2, y;
+	double &av = ws->av0, &qv = ws->qv0;
+	complex *coefs = ws->coefs0;
+	double Mag, Ai;
+	_theta* stheta;
+	_curve * Prov ;
+	_skiplist_curve * Prov2 ;
+	_point* scan1, * scan2;
+	//static complex a, q, m1, m2, y;
+	//static double av = -1.0, qv = -1.0;
+	//static complex  coefs[24], d1, d2, dy, dJ, dz;
+	//static double Mag, Ai;
+	//static _theta* stheta;
 	//static _curve *Prov, *Prov2; // there is also a 'Prov' in NewImages(), but they are different static local variables. 
-	static _curve * Prov ;
-	static _skiplist_curve * Prov2 ;
+	//static _point* scan1, * scan2;
 	/*******************************************   end   *******************************************/
-	static _point* scan1, * scan2;
 
 	Mag = Ai = -1.0;
 	stheta = new _theta(-1.);
@@ -1128,7 +1878,8 @@ double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v,
 	}
 	y = complex(y1v, y2v);
 	/******************************************* changed *******************************************/
-	(*Images) = new _sols_for_skiplist_curve ;
+	if (reuse_images) (*Images) = &ws->images ;	// already empty
+	else (*Images) = new _sols_for_skiplist_curve ;
 	//(*Images) = new _sols;      // create a _sols class variable without any member (_curve class variables) 
 								// and make static pointer 'images'(i.e. *Images) point to that object
 	/*******************************************   end   *******************************************/
@@ -1187,22 +1938,340 @@ double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v,
 double VBMicrolensing::BinaryMag0(double a1, double q1, double y1v, double y2v) {
 	/******************************************* changed *******************************************/
 	//static _sols *images;  	// create a pointer 'images' (points to _sols class variable) on data segment
-	static _sols_for_skiplist_curve * images ;
+	_sols_for_skiplist_curve * images = _workspace_images(ws) ;
+	//static _sols_for_skiplist_curve * images ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double mag;
+	//static double mag;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	mag = BinaryMag0(a1, q1, y1v, y2v, &images, true);
+	//mag = BinaryMag0(a1, q1, y1v, y2v, &images);
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	images->clear();		// the images of the workspace, emptied for the next call
+	//delete images;
 	/*******************************************   end   *******************************************/
-	static double mag;
-	mag = BinaryMag0(a1, q1, y1v, y2v, &images);
-	delete images;
 	return mag;
 }
 
+/******************************************* changed *******************************************/
+// Batched point-source magnification (BinaryMag0_Npoint). _quintic_lanes source positions are solved together, one per lane
+// of a SIMD register: the lane types below are GCC vector extensions, compiled to AVX-512 instructions (8 lanes) or
+// AVX/AVX2 instructions (4 lanes) by -march=native. Coefficients and roots are stored as structure of arrays.
+#ifdef __AVX512F__
+#define _quintic_lanes 8
+#else
+#define _quintic_lanes 4
+#endif
+#define _quintic_maxiter 50		// Aberth iterations before a lane is given to the scalar solver
+
+typedef double _lanes_double __attribute__((vector_size(_quintic_lanes * sizeof(double))));
+typedef long long _lanes_mask __attribute__((vector_size(_quintic_lanes * sizeof(long long))));
+
+struct _lanes_complex{
+	_lanes_double re, im;
+};
+
+static inline _lanes_complex operator+(const _lanes_complex &a, const _lanes_complex &b) { return { a.re + b.re, a.im + b.im }; }
+static inline _lanes_complex operator-(const _lanes_complex &a, const _lanes_complex &b) { return { a.re - b.re, a.im - b.im }; }
+static inline _lanes_complex operator+(const _lanes_complex &a, double b) { return { a.re + b, a.im }; }
+static inline _lanes_complex operator-(const _lanes_complex &a, double b) { return { a.re - b, a.im }; }
+static inline _lanes_complex operator+(double a, const _lanes_complex &b) { return { a + b.re, b.im }; }
+static inline _lanes_complex operator-(double a, const _lanes_complex &b) { return { a - b.re, -b.im }; }
+static inline _lanes_complex operator*(double a, const _lanes_complex &b) { return { a * b.re, a * b.im }; }
+static inline _lanes_complex operator*(const _lanes_complex &a, const _lanes_complex &b) {
+	return { a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re };
+}
+static inline _lanes_double norm(const _lanes_complex &a) { return a.re * a.re + a.im * a.im; }
+static inline _lanes_complex operator/(const _lanes_complex &a, const _lanes_complex &b) {
+	_lanes_double n = norm(b);
+	return { (a.re * b.re + a.im * b.im) / n, (a.im * b.re - a.re * b.im) / n };
+}
+static inline _lanes_complex conj(const _lanes_complex &a) { return { a.re, -a.im }; }
+
+// Roots of the quintics c[5]*z^5+...+c[0] of all lanes by the Aberth-Ehrlich iteration, which refines the five roots
+// together on the full polynomial (no deflation, so no branches that differ from lane to lane). z holds the starting
+// guesses, which must be distinct. Returns the mask of the lanes that converged; a lane stops moving once converged.
+static _lanes_mask _quintic_roots_lanes(const _lanes_complex *c, _lanes_complex *z) {
+	_lanes_mask done = {};
+	for (int iter = 0; iter < _quintic_maxiter; iter++) {
+		_lanes_mask converged = ~_lanes_mask{};
+		for (int k = 0; k < 5; k++) {
+			_lanes_complex p = c[5], dp = { _lanes_double{}, _lanes_double{} }, S = dp, w;
+			for (int j = 4; j >= 0; j--) {
+				dp = dp * z[k] + p;
+				p = p * z[k] + c[j];
+			}
+			for (int j = 0; j < 5; j++) {
+				if (j != k) S = S + _lanes_complex{ _lanes_double{} + 1.0, _lanes_double{} } / (z[k] - z[j]);
+			}
+			p = p / dp;
+			w = p / (1.0 - p * S);
+			converged &= norm(w) <= 1.e-28 * norm(z[k]) + 1.e-40;
+			z[k].re = done ? z[k].re : z[k].re - w.re;
+			z[k].im = done ? z[k].im : z[k].im - w.im;
+		}
+		done |= converged;
+		bool finished = true;
+		for (int l = 0; l < _quintic_lanes; l++) finished = finished && done[l];
+		if (finished) break;
+	}
+	return done;
+}
+
+// starting guesses of a lane without usable roots from the previous batch: on a circle of the radius of the roots' geometric mean
+static void _quintic_seeds_lane(const _lanes_complex *c, _lanes_complex *z, int l) {
+	double R = pow(sqrt((c[0].re[l] * c[0].re[l] + c[0].im[l] * c[0].im[l]) / (c[5].re[l] * c[5].re[l] + c[5].im[l] * c[5].im[l])), 0.2);
+	if (!(R > 0) || !std::isfinite(R)) R = 1.;
+	for (int k = 0; k < 5; k++) {
+		z[k].re[l] = R * cos(0.4 + 2 * M_PI * k / 5);
+		z[k].im[l] = R * sin(0.4 + 2 * M_PI * k / 5);
+	}
+}
+
+void VBMicrolensing::BinaryMag0_Npoint(double *s, double q, double *y1s, double *y2s, int np, double *mags) {
+	_lanes_complex a, m1, m2, y, yc, c[6], z[5], dza, J1, ll;
+	_lanes_double zero = {};
+	double dJ[5][_quintic_lanes], good[5][_quintic_lanes];
+	bool seeded[_quintic_lanes] = {};
+
+	for (int i0 = 0; i0 < np; i0 += _quintic_lanes) {
+		// lens geometry and source position of each lane as in BinaryMag0, with the less massive lens in the origin
+		// (the last batch is padded with copies of the last point)
+		_lanes_double av = {}, m1v = {}, m2v = {}, y1v = {}, y2v = {};
+		for (int l = 0; l < _quintic_lanes; l++) {
+			int i = (i0 + l < np) ? i0 + l : np - 1;
+			double qv = (q < 1) ? q : 1 / q;
+			av[l] = (q < 1) ? -s[i] : s[i];
+			m1v[l] = 1.0 / (1.0 + qv);
+			m2v[l] = qv * m1v[l];
+			y1v[l] = y1s[i] + av[l] * m1v[l];
+			y2v[l] = y2s[i];
+		}
+		a = { av, zero };
+		m1 = { m1v, zero };
+		m2 = { m2v, zero };
+		y = { y1v, y2v };
+		yc = conj(y);
+
+		// coefficients of the lens equation, as in NewImages
+		c[0] = a * a * m2 * m2 * y;
+		c[1] = a * m2 * (a + (2 * (a * yc) - 2 - a * a) * y) - a * a * m2 * m2;
+		c[2] = a * m2 * (1.0 + a * y - 2 * (yc * (a + y))) - (a * yc - 1) * (a * y * (a - yc) - (a - y));
+		c[3] = a * m2 * (a + 2 * yc) + (a * a * a + 2 * ((1.0 + a * a) * y) - a * yc * (a + 2 * y)) * yc - a * (a + y);
+		c[4] = (a - yc) * (1.0 - yc * (2 * a + y)) - a * m2;
+		c[5] = yc * (a - yc);
+
+		// the roots of the previous batch are the starting guesses of the next one, in each lane
+		for (int l = 0; l < _quintic_lanes; l++) {
+			if (!seeded[l]) _quintic_seeds_lane(c, z, l);
+		}
+		_lanes_mask converged = _quintic_roots_lanes(c, z);
+
+		// lens equation check and Jacobian determinant of the five roots
+		for (int k = 0; k < 5; k++) {
+			dza = z[k] - a;
+			ll = (y - z[k]) + m1 / conj(dza) + m2 / conj(z[k]);
+			J1 = m1 / (dza * dza) + m2 / (z[k] * z[k]);
+			_lanes_double n = norm(ll), d = 1.0 - norm(J1);
+			for (int l = 0; l < _quintic_lanes; l++) {
+				good[k][l] = sqrt(n[l]);
+				dJ[k][l] = d[l];
+			}
+		}
+
+		// images as in NewImages: the two worst roots are dropped if they are much worse than the third, and the parities
+		// must add up to -1. Lanes that did not converge or fail the parity check go through the scalar BinaryMag0, and so
+		// do lanes with an image closer to a critical curve than |dJ| = 1.e-5, where NewImages revises the parities (f1)
+		// and the magnification is most sensitive to the accuracy of the roots. The dubious band of NewImages
+		// (good[worst2] < dlmax*good[worst3]) only applies to contour points, a point source takes it as five images.
+		for (int l = 0; l < _quintic_lanes && i0 + l < np; l++) {
+			int i = i0 + l, worst1 = -1, worst2 = -1, worst3 = -1, checkJac = 0;
+			double Mag = 0.;
+			for (int k = 0; k < 5; k++) {
+				if (worst1 < 0 || good[k][l] > good[worst1][l]) {
+					worst3 = worst2;
+					worst2 = worst1;
+					worst1 = k;
+				}
+				else if (worst2 < 0 || good[k][l] > good[worst2][l]) {
+					worst3 = worst2;
+					worst2 = k;
+				}
+				else if (worst3 < 0 || good[k][l] > good[worst3][l]) {
+					worst3 = k;
+				}
+			}
+			bool three = good[worst2][l] * 1.0e-4 > (good[worst3][l] + 1.e-12), critical = false;
+			for (int k = 0; k < 5; k++) {
+				if (three && (k == worst1 || k == worst2)) continue;
+				checkJac += (fabs(dJ[k][l]) > 1.e-7) ? _sign(dJ[k][l]) : 10;
+				Mag += fabs(1 / dJ[k][l]);
+				if (fabs(dJ[k][l]) < 1.e-5) critical = true;
+			}
+			if (converged[l] && checkJac == -1 && !critical && std::isfinite(Mag)) {
+				mags[i] = Mag;
+				seeded[l] = true;
+			}
+			else {
+				mags[i] = BinaryMag0(s[i], q, y1s[i], y2s[i]);
+				seeded[l] = false;
+			}
+		}
+	}
+}
+/*******************************************   end   *******************************************/
+
+/******************************************* changed *******************************************/
+void _image_tracks::load(_sols_for_skiplist_curve *Images)
+{
+	auto track_index = [&](_skiplist_curve *c) {
+		int i = (int)(std::find(curves.begin(), curves.end(), c) - curves.begin()) ;
+		return (c && i < (int)curves.size()) ? i : -1 ;
+	};
+	auto push_point = [&](double px1, double px2, double pth, double psign, double pw) {
+		x1.push_back(px1); x2.push_back(px2); th.push_back(pth); sign.push_back(psign); w.push_back(pw);
+	};
+
+	x1.clear(); x2.clear(); th.clear(); sign.clear(); w.clear();
+	start.clear(); partneratstart.clear(); partneratend.clear(); curves.clear();
+
+	for (_skiplist_curve *scurve = Images->first; scurve; scurve = scurve->next) curves.push_back(scurve) ;
+	for (_skiplist_curve *scurve : curves) {
+		start.push_back((int)x1.size()) ;
+		partneratstart.push_back(track_index(scurve->partneratstart)) ;
+		partneratend.push_back(track_index(scurve->partneratend)) ;
+		for (_point *scan = scurve->first; scan; scan = scan->next) {
+			double sg = (scan->dJ > 0) ? -1 : 1 ;
+			push_point(scan->x1, scan->x2, scan->theta->th, sg, scan->next ? sg : 0.) ;
+		}
+	}
+	npoints = (int)x1.size() ;
+	start.push_back(npoints) ;
+}
+
+// derivatives of the area enclosed by the tracks, as summed by OrderImages: trapezium term and parabolic correction of the
+// segments inside the tracks and of those between partner tracks, for the derivatives dz, dd and dds of the points. The angle
+// steps are those of the sampling inside the tracks, and follow the points between partner tracks, as in OrderImages.
+void _image_tracks::area_gradient(double *dArea)
+{
+	auto segment = [&](int a, int b, double weight) {
+		const complex *da = &dz[5 * a], *db = &dz[5 * b] ;
+		for (int j = 0; j < 5; j++) {
+			dArea[j] += weight * 0.5 * ((da[j].im + db[j].im) * (x1[b] - x1[a]) + (x2[a] + x2[b]) * (db[j].re - da[j].re)) ;
+		}
+	};
+	// parabolic correction 0.5 * ((ds[a] + ds[b]) * cmp^3 / 24 + cross * cmp / 12) of the segment from a to b in a track,
+	// with cmp = th[a] - th[b] and cross = (x1[b] - x1[a]) (d[b].im - d[a].im) - (x2[b] - x2[a]) (d[b].re - d[a].re)
+	auto parabolic = [&](int a, int b, double weight) {
+		double cmp = th[a] - th[b], mi = cmp * cmp * cmp / 24. ;
+		for (int j = 0; j < 5; j++) {
+			complex dza = dz[5 * a + j], dzb = dz[5 * b + j], dda = dd[5 * a + j], ddb = dd[5 * b + j] ;
+			double dcross = (dzb.re - dza.re) * (d[b].im - d[a].im) + (x1[b] - x1[a]) * (ddb.im - dda.im)
+				- (dzb.im - dza.im) * (d[b].re - d[a].re) - (x2[b] - x2[a]) * (ddb.re - dda.re) ;
+			dArea[j] += weight * 0.5 * ((dds[5 * a + j] + dds[5 * b + j]) * mi + dcross * cmp / 12.) ;
+		}
+	};
+	// parabolic correction 0.5 * ((ds[a] - ds[b]) * cmp^3 / 24 - cross * cmp / 12) between the first points a and b of partner
+	// tracks, with cross = (x1[b] - x1[a]) (d[b].im + d[a].im) - (x2[b] - x2[a]) (d[b].re + d[a].re) and the angle step
+	// cmp = sqrt(|z[a] - z[b]|^2 / |d[a].d[b]|) (equation (29) in Bozza, 2010); the opposite one between the last points
+	auto parabolic_partners = [&](int a, int b, double weight) {
+		double dx1 = x1[b] - x1[a], dx2 = x2[b] - x2[a] ;
+		double D = dx1 * dx1 + dx2 * dx2, C = d[a].re * d[b].re + d[a].im * d[b].im ;
+		if (D == 0 || C == 0) return ;
+		double cmp = sqrt(D / fabs(C)), mi = cmp * cmp * cmp / 24. ;
+		double cross = dx1 * (d[b].im + d[a].im) - dx2 * (d[b].re + d[a].re) ;
+		for (int j = 0; j < 5; j++) {
+			complex dza = dz[5 * a + j], dzb = dz[5 * b + j], dda = dd[5 * a + j], ddb = dd[5 * b + j] ;
+			double dD = 2. * (dx1 * (dzb.re - dza.re) + dx2 * (dzb.im - dza.im)) ;
+			double dC = dda.re * d[b].re + d[a].re * ddb.re + dda.im * d[b].im + d[a].im * ddb.im ;
+			double dcmp = 0.5 * cmp * (dD / D - dC / C), dmi = cmp * cmp * dcmp / 8. ;
+			double dcross = (dzb.re - dza.re) * (d[b].im + d[a].im) + dx1 * (ddb.im + dda.im)
+				- (dzb.im - dza.im) * (d[b].re + d[a].re) - dx2 * (ddb.re + dda.re) ;
+			dArea[j] += weight * 0.5 * ((dds[5 * a + j] - dds[5 * b + j]) * mi + (ds[a] - ds[b]) * dmi - (dcross * cmp + cross * dcmp) / 12.) ;
+		}
+	};
+
+	for (int j = 0; j < 5; j++) dArea[j] = 0. ;
+	for (int k = 0; k + 1 < npoints; k++) {
+		if (w[k] != 0) {
+			segment(k, k + 1, w[k]) ;
+			parabolic(k, k + 1, w[k]) ;
+		}
+	}
+	for (int t = 0; t + 1 < (int)start.size(); t++) {
+		for (int end = 0; end < 2; end++) {
+			int partner = end ? partneratend[t] : partneratstart[t] ;
+			if (partner < 0) continue ;
+			int a = end ? start[t + 1] - 1 : start[t] ;
+			int b = end ? start[partner + 1] - 1 : start[partner] ;
+			segment(a, b, (end ? 0.5 : -0.5) * sign[a]) ;
+			parabolic_partners(a, b, -0.5 * sign[a]) ;		// the correction at the end is the opposite one, with the opposite weight
+		}
+	}
+}
+
+double VBMicrolensing::BinaryMagContours(double s, double q, double y1, double y2, double rho, double accuracy, \
+										 double *x1, double *x2, int *start, int maxpoints, int maxtracks, int *npoints, int *ntracks)
+{
+	_sols_for_skiplist_curve *images = _workspace_images(ws) ;
+	_image_tracks &tracks = ws->tracks ;
+	double Mag ;
+
+	Mag = BinaryMag(s, q, y1, y2, rho, accuracy, &images, true) ;
+	tracks.load(images) ;
+	images->clear() ;
+
+	*npoints = tracks.npoints ;
+	*ntracks = (int)tracks.start.size() - 1 ;
+	if (*npoints <= maxpoints && *ntracks <= maxtracks) {
+		memcpy(x1, tracks.x1.data(), sizeof(double) * (*npoints)) ;
+		memcpy(x2, tracks.x2.data(), sizeof(double) * (*npoints)) ;
+		memcpy(start, tracks.start.data(), sizeof(int) * (*ntracks + 1)) ;
+	}
+	return Mag ;
+}
+
+double VBMicrolensing::BinaryMag0Gradient(double s, double q, double y1, double y2, double* grad)
+{
+	_sols_for_skiplist_curve *images = _workspace_images(ws) ;
+	double Mag, g[5] ;
+
+	Mag = BinaryMag0(s, q, y1, y2, &images, true) ;
+	_point_gradient(images, _lens_tangents(s, q), g) ;
+	images->clear() ;
+	memcpy(grad, g, 4 * sizeof(double)) ;
+	return Mag ;
+}
+
+double VBMicrolensing::BinaryMag2Gradient(double s, double q, double y1, double y2, double rho, double* grad)
+{
+	double Mag ;
+
+	ws->grad = grad ;
+	Mag = BinaryMag2(s, q, y1, y2, rho) ;
+	ws->grad = 0 ;
+	return Mag ;
+}
+/*******************************************   end   *******************************************/
+
 
 /******************************************* changed *******************************************/
-double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v, double RS, _sols_for_skiplist_curve **images) {
+double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v, double RS, _sols_for_skiplist_curve **images, bool reuse_images) {
 //double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v, double RS, _sols** images) {
 /*******************************************   end   *******************************************/
-	static double Mag, mag1, mag2, RSi, RSo, delta1, delta2;
-	static int NPSsafe;
-	Mag = BinaryMag(s, q, y1v, y2v, RS, Tol, images);
+	/******************************************* changed *******************************************/
+	double Mag, mag1, mag2, RSi, RSo, delta1, delta2;
+	int NPSsafe;
+	//static double Mag, mag1, mag2, RSi, RSo, delta1, delta2;
+	//static int NPSsafe;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	Mag = BinaryMag(s, q, y1v, y2v, RS, Tol, images, reuse_images);
+	//Mag = BinaryMag(s, q, y1v, y2v, RS, Tol, images);
+	/*******************************************   end   *******************************************/
 	RSi = RS;
 	RSo = RS;
 	NPSsafe = NPS;
@@ -1210,10 +2279,22 @@ double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v,
 		mag1 = -1;
 		delta1 = 3.33333333e-8;
 		while (mag1 < 0.1 && RSi >= 0) {
-			delete* images;
+			/******************************************* changed *******************************************/
+			if (reuse_images) (*images)->clear();
+			else delete *images;
+			//delete* images;
+			/*******************************************   end   *******************************************/
 			delta1 *= 3.;
 			RSi = RS - delta1;
-			mag1 = (RSi > 0) ? BinaryMag(s, q, y1v, y2v, RSi, Tol, images) : BinaryMag0(s, q, y1v, y2v, images);
+			/******************************************* changed *******************************************/
+			mag1 = (RSi > 0) ? BinaryMag(s, q, y1v, y2v, RSi, Tol, images, reuse_images) : BinaryMag0(s, q, y1v, y2v, images, reuse_images);
+			//mag1 = (RSi > 0) ? BinaryMag(s, q, y1v, y2v, RSi, Tol, images) : BinaryMag0(s, q, y1v, y2v, images);
+			/*******************************************   end   *******************************************/
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.BinaryMagSafe_retries++;
+#endif
+			/*******************************************   end   *******************************************/
 			//			printf("\n-safe1 %lf %lf %d", RSi, mag1, NPS);
 			NPSsafe += NPS;
 		}
@@ -1223,8 +2304,20 @@ double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v,
 		while (mag2 < 0.1) {
 			delta2 *= 3.;
 			RSo = RS + delta2;
-			delete* images;
-			mag2 = BinaryMag(s, q, y1v, y2v, RSo, Tol, images);
+			/******************************************* changed *******************************************/
+			if (reuse_images) (*images)->clear();
+			else delete *images;
+			//delete* images;
+			/*******************************************   end   *******************************************/
+			/******************************************* changed *******************************************/
+			mag2 = BinaryMag(s, q, y1v, y2v, RSo, Tol, images, reuse_images);
+			//mag2 = BinaryMag(s, q, y1v, y2v, RSo, Tol, images);
+			/*******************************************   end   *******************************************/
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.BinaryMagSafe_retries++;
+#endif
+			/*******************************************   end   *******************************************/
 			//			printf("\n-safe2 %lf %lf %d", RSo,mag2,NPS);
 			NPSsafe += NPS;
 		}
@@ -1236,43 +2329,67 @@ double VBMicrolensing::BinaryMagSafe(double s, double q, double y1v, double y2v,
 }
 
 /******************************************* changed *******************************************/
-double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, double RSv, double Tol, _sols_for_skiplist_curve **Images) {
+double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, double RSv, double Tol, _sols_for_skiplist_curve **Images, bool reuse_images) {
 //double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, double RSv, double Tol, _sols** Images) {
 /*******************************************   end   *******************************************/
-	static complex a, q, m1, m2, y0, y, yc, z, zc;
-	static double av = -1.0, qv = -1.0;
-	static complex coefs[24], d1, d2, dy, dJ, dz;
-	static double thoff = 0.01020304, errbuff;
-	static double Mag, th;
-	////////////////////////////  
-	static double errimage, maxerr, currerr, Magold;
-	static int NPSmax, flag, NPSold, flagbad, flagbadmax = 3;
 	/******************************************* changed *******************************************/
-	//static _curve *Prov, *Prov2;	// there is also a 'Prov' in NewImages(), but they are different static local variables. 
-	static _curve * Prov ;
-	static _skiplist_curve * Prov2 ;
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
 	/*******************************************   end   *******************************************/
-	static _point* scan1, * scan2;
-	static _thetas* Thetas;
-	static _theta* stheta, * itheta;
 	/******************************************* changed *******************************************/
-	static std::minstd_rand engine_start{std::random_device{}()} ;
+	// the coefficients cached on (s,q), the skiplist level generator and the heap live in the per-instance workspace,
+	// everything else is an automatic variable
+	complex a, q, m1, m2, y0, y, yc, z, zc;
+	double &av = ws->av, &qv = ws->qv;
+	complex *coefs = ws->coefs;
+	const double thoff = 0.01020304;
+	double errbuff;
+	double Mag, th;
+	double errimage, currerr, Magold;
+	int NPSmax, flag, NPSold, flagbad;
+	const int flagbadmax = 3;
+	bool contour_batches = false;	// parallel contour: the rest of the call goes on in batches (see contourthreads)
+	int nseeds = 0, iseed = 0;		// frozen sampling, replay mode: recorded angles of the contour, in ws->theta_seeds
+	bool seeding = false;			// the seeds are being inserted, the heap of the intervals is built after the last one
+	bool frozen = false;			// frozen sampling, replay mode: the seeds are the recorded points, inserted in the same
+	double frozenerr = 0.;			// order; the contour is refined only if its error estimate is beyond twice frozenerr, the recorded one
+	_curve * Prov ;
+	_skiplist_curve * Prov2 ;
+	_point* scan1, * scan2;
+	_thetas* Thetas;
+	_theta* stheta, * itheta;
+	std::minstd_rand &engine_start = ws->engine ;
+	//static complex a, q, m1, m2, y0, y, yc, z, zc;
+	//static double av = -1.0, qv = -1.0;
+	//static complex coefs[24], d1, d2, dy, dJ, dz;
+	//static double thoff = 0.01020304, errbuff;
+	//static double Mag, th;
+	//static double errimage, maxerr, currerr, Magold;
+	//static int NPSmax, flag, NPSold, flagbad, flagbadmax = 3;
+	//static _curve *Prov, *Prov2;	// there is also a 'Prov' in NewImages(), but they are different static local variables. 
+	//static _point* scan1, * scan2;
+	//static _thetas* Thetas;
+	//static _theta* stheta, * itheta;
+	//static std::minstd_rand engine_start{std::random_device{}()} ;
 	/*******************************************   end   *******************************************/
 
 	/******************************************* changed *******************************************/
-	static _augmented_priority_queue APQ ;
+	// the heap of the intervals is now part of Thetas (see _thetas::clear)
+	//_augmented_priority_queue &APQ = ws->APQ ;
+	//static _augmented_priority_queue APQ ;
 
-	if (APQ.apq_array.capacity() > 2048)
-	{
-		APQ.apq_array.resize(2048) ;
-		APQ.sum_tree_array.resize(2048) ;
+	//if (APQ.apq_array.capacity() > 2048)
+	//{
+	//	APQ.apq_array.resize(2048) ;
+	//	APQ.sum_tree_array.resize(2048) ;
 
-		APQ.apq_array.shrink_to_fit() ;
-		APQ.sum_tree_array.shrink_to_fit() ;
-	}
+	//	APQ.apq_array.shrink_to_fit() ;
+	//	APQ.sum_tree_array.shrink_to_fit() ;
+	//}
 	
-	APQ.apq_array.clear() ;
-	APQ.sum_tree_array.clear() ;
+	//APQ.apq_array.clear() ;
+	//APQ.sum_tree_array.clear() ;
 	/*******************************************   end   *******************************************/
 
 	/******************************************* changed *******************************************/
@@ -1285,7 +2402,10 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 	/*******************************************   end   *******************************************/
 
 #ifdef _PRINT_TIMES
-	static double tim0, tim1;
+	/******************************************* changed *******************************************/
+	double tim0, tim1;
+	//static double tim0, tim1;
+	/*******************************************   end   *******************************************/
 #endif
 
 	// Initialization of the equation coefficients
@@ -1332,11 +2452,16 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 	// Calculation of the images
 
 	/******************************************* changed *******************************************/
-	(*Images) = new _sols_for_skiplist_curve ;
+	if (reuse_images) (*Images) = &ws->images ;	// already empty
+	else (*Images) = new _sols_for_skiplist_curve ;
 	//(*Images) = new _sols;			// create a _sols class variable without any member (_curve class variables) 
 									// and make static pointer 'images'(i.e. *Images) point to that object
 	/*******************************************   end   *******************************************/
-	Thetas = new _thetas;
+	/******************************************* changed *******************************************/
+	Thetas = &ws->thetas;			// the list of the workspace, emptied, with its storage kept from the previous calls
+	Thetas->clear();
+	//Thetas = new _thetas;
+	/*******************************************   end   *******************************************/
 	th = thoff;
 	stheta = Thetas->insert(th);
 	/******************************************* changed *******************************************/
@@ -1368,14 +2493,18 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			delete Prov;
 			stheta->th += 0.01;
 			if (stheta->th > 2.0 * M_PI) {
-				delete Thetas;
+				/******************************************* changed *******************************************/
+				//delete Thetas;				// Thetas belongs to the workspace
+				/*******************************************   end   *******************************************/
 				return -1;
 			}
 			y = y0 + complex(RSv * cos(stheta->th), RSv * sin(stheta->th));
 		}
 	}
 	/******************************************* changed *******************************************/
-	APQ.push_augmented_heap(0., itheta) ;	// this element will be first popped out anyway, 
+	Thetas->push_error(0., itheta) ;	// this element will be first popped out anyway,
+											// so we can just set maxerr_to_push to 0.
+	//APQ.push_augmented_heap(0., itheta) ;	// this element will be first popped out anyway,
 											// so we can just set maxerr_to_push to 0.
 	/*******************************************   end   *******************************************/
 #ifdef _PRINT_TIMES
@@ -1412,6 +2541,17 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 	delete Prov;
 
 	th = M_PI + Thetas->first->th;
+	/******************************************* changed *******************************************/
+	if (ws->frozen_point) {
+		nseeds = _frozen_contour_begin(ws, &frozenerr);
+		frozen = nseeds > 0;
+	}
+	if (nseeds > 0 && (!frozen || _frozen_parent(ws, Thetas, 0, &itheta))) {
+	//if (nseeds > 0) {
+		seeding = true;
+		th = ws->theta_seeds[iseed++];
+	}
+	/*******************************************   end   *******************************************/
 	flag = 0;
 	Magold = -1.;
 	NPSold = 2;
@@ -1468,7 +2608,17 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			}
 			/*******************************************   end   *******************************************/
 
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			auto OrderImages_begin = std::chrono::steady_clock::now();
+#endif
+			/*******************************************   end   *******************************************/
 			OrderImages((*Images), Prov);
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.OrderImages_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - OrderImages_begin).count();
+#endif
+			/*******************************************   end   *******************************************/
 
 			/******************************************* changed *******************************************/
 			Mag += stheta->prev->Mag ;
@@ -1493,8 +2643,14 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			}
 
 			/******************************************* changed *******************************************/
-			APQ.pop_then_push_augmented_heap(stheta->prev->maxerr, stheta->prev) ;
-			APQ.push_augmented_heap(stheta->maxerr, stheta) ;
+			if (ws->frozen_point && ws->frozen_mode == 1) _frozen_insertion(ws, stheta);
+			if (seeding) itheta = stheta ;	// the next seed goes after it; the heap is built after the last one
+			else {
+			Thetas->pop_then_push_error(stheta->prev->maxerr, stheta->prev) ;
+			Thetas->push_error(stheta->maxerr, stheta) ;
+			}
+			//APQ.pop_then_push_augmented_heap(stheta->prev->maxerr, stheta->prev) ;
+			//APQ.push_augmented_heap(stheta->maxerr, stheta) ;
 			/*******************************************   end   *******************************************/
 		}
 		else {
@@ -1502,14 +2658,17 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			flagbad++;
 			if (flagbad == flagbadmax) {
 				if (NPS < 16) {
-					delete Thetas;
+					/******************************************* changed *******************************************/
+					//delete Thetas;				// Thetas belongs to the workspace
+					/*******************************************   end   *******************************************/
 					return -1;
 				}
 				errbuff += stheta->prev->maxerr;
 				stheta->prev->maxerr = 0;
 
 				/******************************************* changed *******************************************/
-				APQ.pop_then_push_augmented_heap(0., stheta->prev) ;
+				if (!seeding) Thetas->pop_then_push_error(0., stheta->prev) ;
+				//APQ.pop_then_push_augmented_heap(0., stheta->prev) ;
 				/*******************************************   end   *******************************************/
 
 				NPS--;
@@ -1530,8 +2689,24 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			//maxerr = 0. ; //currerr = Mag = 0.;
 			//astrox1 = astrox2 = 0.;
 			
-			itheta  = APQ.apq_array[0].stheta ;
-			currerr = APQ.sum_tree_array[0].sumerr ;
+			if (seeding) {
+				if (frozen) {
+					if (iseed < nseeds && !_frozen_parent(ws, Thetas, iseed, &itheta)) iseed = nseeds;	// see _frozen_parent
+				}
+				else {
+					while (iseed < nseeds && ws->theta_seeds[iseed] <= itheta->th) iseed++;	// behind a point moved by a failure
+				}
+				if (iseed == nseeds) {
+					Thetas->rebuild_errors() ;
+					seeding = false ;
+				}
+			}
+			if (!seeding) {
+			itheta  = Thetas->worst() ;
+			currerr = Thetas->total_error() ;
+			}
+			//itheta  = APQ.apq_array[0].stheta ;
+			//currerr = APQ.sum_tree_array[0].sumerr ;
 			/*******************************************   end   *******************************************/
 
 			/******************************************* changed *******************************************/
@@ -1562,7 +2737,10 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 // #endif
 // 				}
 			/*******************************************   end   *******************************************/
-			th = (itheta->th + itheta->next->th) / 2;
+			/******************************************* changed *******************************************/
+			th = seeding ? ws->theta_seeds[iseed++] : (itheta->th + itheta->next->th) / 2;
+			//th = (itheta->th + itheta->next->th) / 2;
+			/*******************************************   end   *******************************************/
 			NPS++;
 //#ifndef _uniform
 			if (fabs(Magold - Mag) * 2 < errimage) {
@@ -1573,6 +2751,9 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 				Magold = Mag;
 				NPSold = NPS + 8;
 			}
+			/******************************************* changed *******************************************/
+			contour_batches = (!seeding && !ws->frozen_point && contourthreads > 1 && NPS >= _Contour_parallel_NPS);
+			/*******************************************   end   *******************************************/
 // #else
 // 			currerr = 2 * errimage;
 // 			if (NPS == 2 * NPSold) {
@@ -1590,15 +2771,165 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 			printf("\nNPS= %d Mag = %lf maxerr= %lg currerr =%lg th = %lf", NPS, Mag / (M_PI * RSv * RSv), maxerr / (M_PI * RSv * RSv), currerr / (M_PI * RSv * RSv), th);
 #endif
 			}
-		} while ((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && ((flag < NPSold)/* || NPS<8 ||(currerr>10*errimage)*/)/*&&(flagits)*/);
+		/******************************************* changed *******************************************/
+		} while ((seeding || ((currerr > errimage) && (currerr > RelTol * Mag) && (frozen ? currerr > 2 * frozenerr : (flag < NPSold)/* || NPS<8 ||(currerr>10*errimage)*/))) && (NPS < NPSmax)/*&&(flagits)*/ && !contour_batches);
+	//} while ((seeding || ((currerr > errimage) && (currerr > RelTol * Mag) && ((flag < NPSold)/* || NPS<8 ||(currerr>10*errimage)*/))) && (NPS < NPSmax)/*&&(flagits)*/ && !contour_batches);
+		//} while ((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && ((flag < NPSold)/* || NPS<8 ||(currerr>10*errimage)*/)/*&&(flagits)*/ && !contour_batches);
+		//} while ((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && ((flag < NPSold)/* || NPS<8 ||(currerr>10*errimage)*/)/*&&(flagits)*/);
+
+		// parallel contour: each batch splits the _Contour_batch intervals with the largest errors. The new points are
+		// sorted by angle and cut in sectors of _Contour_sector points; the roots of each sector are solved by a helper
+		// thread on its own worker instance, starting from the roots of the last merged point and following the sector.
+		// The points are then merged one by one in order of angle, exactly as in the loop above, so that the result
+		// depends on the batches but not on the threads.
+		if (contour_batches) {
+			struct contour_point{
+				_theta *itheta;				// interval split by the new point
+				double th;
+				complex roots[5];			// solved by the helper threads
+			};
+			std::vector<contour_point> batch;
+			std::vector<_theta *> intervals;
+			complex seeds[5];
+			std::vector<std::unique_ptr<VBMicrolensing>> &workers = ws->contour_workers;
+			if (!ws->contour_helpers || ws->contour_helpers->size() != contourthreads) ws->contour_helpers.reset(new _contour_helpers(contourthreads));
+			while ((int)workers.size() < contourthreads) workers.emplace_back(new VBMicrolensing);
+			for (int id = 0; id < contourthreads; id++) {
+				for (int i = 0; i < 24; i++) workers[id]->ws->coefs[i] = coefs[i];
+#ifdef _HOTPATH_STATS
+				workers[id]->stats = _call_stats();
+#endif
+			}
+			std::function<void(int, int)> solve_sector = [&](int id, int sector) {
+				VBMicrolensing &worker = *workers[id];
+				int kend = (sector + 1) * _Contour_sector < (int)batch.size() ? (sector + 1) * _Contour_sector : (int)batch.size();
+				for (int i = 0; i < 5; i++) worker.ws->zr_binary[i] = seeds[i];
+				for (int k = sector * _Contour_sector; k < kend; k++) {
+					_theta sectortheta(batch[k].th);
+					delete worker.NewImages(y0 + complex(RSv * std::cos(batch[k].th), RSv * std::sin(batch[k].th)), worker.ws->coefs, &sectortheta);
+					for (int i = 0; i < 5; i++) batch[k].roots[i] = worker.ws->zr_binary[i];
+				}
+			};
+
+			while ((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold)) {
+				intervals.clear();
+				currerr = 0.;
+				for (stheta = Thetas->first; stheta->next; stheta = stheta->next) {
+					currerr += stheta->maxerr;
+					if (stheta->maxerr > 0) intervals.push_back(stheta);
+				}
+				if (intervals.empty() || currerr <= errimage || currerr <= RelTol * Mag) break;
+				if ((int)intervals.size() > _Contour_batch) {
+					std::nth_element(intervals.begin(), intervals.begin() + _Contour_batch, intervals.end(), [](_theta *a, _theta *b) { return a->maxerr > b->maxerr; });
+					intervals.resize(_Contour_batch);
+				}
+				std::sort(intervals.begin(), intervals.end(), [](_theta *a, _theta *b) { return a->th < b->th; });
+				batch.resize(intervals.size());
+				for (size_t k = 0; k < intervals.size(); k++) {
+					batch[k].itheta = intervals[k];
+					batch[k].th = (intervals[k]->th + intervals[k]->next->th) / 2.0;
+				}
+				for (int i = 0; i < 5; i++) seeds[i] = ws->zr_binary[i];
+				ws->contour_helpers->run(((int)batch.size() + _Contour_sector - 1) / _Contour_sector, solve_sector);
+
+				for (size_t k = 0; k < batch.size(); k++) {
+					double olderr;
+					itheta = batch[k].itheta;
+					olderr = itheta->maxerr;
+					th = batch[k].th;
+					stheta = Thetas->insert_at_certain_position(itheta, th);
+					y = y0 + complex(RSv*std::cos(th), RSv*std::sin(th));
+					ws->zr_given = batch[k].roots;
+					Prov = NewImages(y, coefs, stheta);
+					ws->zr_given = 0;
+					for (flagbad = 1; Prov->length == 0 && flagbad < flagbadmax; flagbad++) {
+						// as in the loop above: try the two quadrisection points, solved here
+						delete Prov;
+						Thetas->remove(stheta);
+						th = (th - itheta->th >= itheta->next->th - th) ? (th + flagbad * itheta->th) / (1 + flagbad) : (th + flagbad * itheta->next->th) / (1 + flagbad);
+						stheta = Thetas->insert_at_certain_position(itheta, th);
+						y = y0 + complex(RSv*std::cos(th), RSv*std::sin(th));
+						Prov = NewImages(y, coefs, stheta);
+					}
+					if (Prov->length > 0) {
+						Mag -= itheta->Mag;
+						if (astrometry) {
+							astrox1 -= itheta->astrox1;
+							astrox2 -= itheta->astrox2;
+						}
+	#ifdef _HOTPATH_STATS
+						auto OrderImages_begin = std::chrono::steady_clock::now();
+	#endif
+						OrderImages((*Images), Prov);
+	#ifdef _HOTPATH_STATS
+						stats.OrderImages_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - OrderImages_begin).count();
+	#endif
+						Mag += itheta->Mag + stheta->Mag;
+						if (astrometry) {
+							astrox1 += itheta->astrox1 + stheta->astrox1;
+							astrox2 += itheta->astrox2 + stheta->astrox2;
+						}
+						if ((stheta->th - itheta->th)*RSv < 1.e-11) {
+							errbuff += stheta->maxerr + itheta->maxerr;
+							stheta->maxerr = 0;
+							itheta->maxerr = 0;
+						}
+						currerr += stheta->maxerr + itheta->maxerr - olderr;
+						NPS++;
+					}
+					else {							// give up this interval, as the loop above does after flagbadmax failures
+						delete Prov;
+						Thetas->remove(stheta);
+						errbuff += itheta->maxerr;
+						currerr -= itheta->maxerr;
+						itheta->maxerr = 0;
+						NPSmax--;
+					}
+					if (fabs(Magold - Mag) * 2 < errimage) {
+						flag++;
+					}
+					else {
+						flag = 0;
+						Magold = Mag;
+						NPSold = NPS + 8;
+					}
+					if (!((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold))) break;
+				}
+			}
+	#ifdef _HOTPATH_STATS
+			for (int id = 0; id < contourthreads; id++) _add_worker_stats(stats, workers[id]->stats);
+	#endif
+		}
+
+		// The totals summed again along the contour: the running sums depend on the order in which the points were added,
+		// which differs between a recorded sampling and its replay (all points seeded first).
+		Mag = currerr = 0.;
+		if (astrometry) astrox1 = astrox2 = 0.;
+		for (stheta = Thetas->first; stheta; stheta = stheta->next) {
+			Mag += stheta->Mag;
+			if (stheta->next) currerr += stheta->maxerr;
+			if (astrometry) {
+				astrox1 += stheta->astrox1;
+				astrox2 += stheta->astrox2;
+			}
+		}
+		/*******************************************   end   *******************************************/
 		if (astrometry) {
 			astrox1 /= (Mag);
 			astrox2 /= (Mag);
 		}
 		Mag /= (M_PI * RSv * RSv);
 		therr = (currerr + errbuff) / (M_PI * RSv * RSv);
+		/******************************************* changed *******************************************/
+		if (ws->frozen_point) _frozen_contour_end(ws, currerr);
+#ifdef _HOTPATH_STATS
+		stats.NPS += NPS;
+#endif
+		/*******************************************   end   *******************************************/
 
-		delete Thetas;
+		/******************************************* changed *******************************************/
+		//delete Thetas;				// Thetas belongs to the workspace
+		/*******************************************   end   *******************************************/
 		//	if (NPS == NPSmax) return 1.e100*Tol; // Only for testing
 		return Mag;
 
@@ -1608,38 +2939,116 @@ double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, d
 double VBMicrolensing::BinaryMag(double a1, double q1, double y1v, double y2v, double RSv, double Tol) {
 	/******************************************* changed *******************************************/
 	//static _sols *images;
-	static _sols_for_skiplist_curve * images ;
+	_sols_for_skiplist_curve * images = _workspace_images(ws) ;
+	//static _sols_for_skiplist_curve * images ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double mag;
+	//static double mag;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	mag = BinaryMag(a1, q1, y1v, y2v, RSv, Tol, &images, true);
+	//mag = BinaryMag(a1, q1, y1v, y2v, RSv, Tol, &images);
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	images->clear();		// the images of the workspace, emptied for the next call
+	//delete images;
 	/*******************************************   end   *******************************************/
-	static double mag;
-	mag = BinaryMag(a1, q1, y1v, y2v, RSv, Tol, &images);
-	delete images;
 	return mag;
 }
 
 double VBMicrolensing::BinaryMag2(double s, double q, double y1v, double y2v, double rho) {
-	static double Mag, rho2, y2a;//, sms , dy1, dy2;
-	static int c;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double Mag, rho2, y2a;//, sms , dy1, dy2;
+	int c;
+	//static double Mag, rho2, y2a;//, sms , dy1, dy2;
+	//static int c;
+	/*******************************************   end   *******************************************/
 	/******************************************* changed *******************************************/
 	//static _sols *Images;
-	static _sols_for_skiplist_curve *Images ;
+	_sols_for_skiplist_curve *Images ;
+	//static _sols_for_skiplist_curve *Images ;
+	_frozen_point *frozen = _frozen_sampling_point(ws);		// frozen sampling: record of this point of the light curve
+	// replay: a point recorded on BinaryMagDark stays on it, and starts from the recorded roots instead of those left
+	// by the tests of the cheaper branches, which are skipped; they are repeated otherwise, since the perturbed source
+	// may now need a finite-source calculation
+	int branch = (frozen && ws->frozen_mode == 2 && frozen->branch == 2) ? 2 : 0;
 	/*******************************************   end   *******************************************/
 
 	c = 0;
 
 	y2a = fabs(y2v);
 
-	Mag0 = BinaryMag0(s, q, y1v, y2a, &Images);
-	delete Images;
+	/******************************************* changed *******************************************/
+	Images = _workspace_images(ws);
+	bool warm = ws->warm_start && ws->warm_count > 0;	// light curve with warmstart: the source center starts from the roots
+	if (warm) ws->warm_seeds(complex(y1v, y2a));		// of the previous source centers (see _warm_start_scope)
+	Mag0 = BinaryMag0(s, q, y1v, y2a, &Images, true);
+	if (warm && (Mag0 < 0 || !_distinct_roots(ws->zr_binary))) {	// guard: the warm seeds did not converge to the five roots,
+		Images->clear();										// solve again from the cold seeds
+		ws->reset_seeds();
+		Mag0 = BinaryMag0(s, q, y1v, y2a, &Images, true);
+	}
+	if (ws->warm_start) ws->keep_warm(complex(y1v, y2a), Mag0 >= 0);
+	if (ws->grad) _point_gradient(Images, _lens_tangents(s, q), ws->grad0);
+	Images->clear();
+	//delete Images;
+	/*******************************************   end   *******************************************/
 	rho2 = rho * rho;
 	corrquad *= 6 * (rho2 + 1.e-4 * Tol);
 	corrquad2 *= (rho + 1.e-3);
-	if (corrquad < Tol && corrquad2 < 1 && (/*rho2 * s * s<q || */ safedist > 4 * rho2)) {
+	/******************************************* changed *******************************************/
+	if (branch == 0 && corrquad < Tol && corrquad2 < 1 && (/*rho2 * s * s<q || */ safedist > 4 * rho2)) {
+	//if (corrquad < Tol && corrquad2 < 1 && (/*rho2 * s * s<q || */ safedist > 4 * rho2)) {
+	/*******************************************   end   *******************************************/
 		Mag = Mag0;
+		/******************************************* changed *******************************************/
+		branch = 1;
+		if (ws->grad) memcpy(ws->grad, ws->grad0, sizeof(ws->grad0));
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 1;
+#endif
+		/*******************************************   end   *******************************************/
+	}
+	/******************************************* changed *******************************************/
+	// intermediate tier: hexadecapole approximation, if the source is not close to the ghost images and the error
+	// estimate is well within Tol + RelTol * Mag (the caustics are caught by the tests of MultipoleMag)
+	else if (branch == 0 && corrquad2 < 1 && !astrometry && curLDprofile == LDlinear &&
+			 (Mag = MultipoleMag(s, q, y1v, y2a, rho, Tol)) > 0) {
+		branch = 3;
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 3;
+#endif
 	}
+	/*******************************************   end   *******************************************/
 	else {
+		/******************************************* changed *******************************************/
+		if (frozen && ws->frozen_mode == 1) {
+			for (int i = 0; i < 5; i++) frozen->seeds[i] = ws->zr_binary[i];
+		}
+		else if (branch == 2) {
+			for (int i = 0; i < 5; i++) ws->zr_binary[i] = frozen->seeds[i];
+		}
+		/*******************************************   end   *******************************************/
 		Mag = BinaryMagDark(s, q, y1v, y2a, rho, Tol);
+		/******************************************* changed *******************************************/
+		branch = 2;
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 2;
+#endif
+		/*******************************************   end   *******************************************/
 	}
 	Mag0 = 0;
+	/******************************************* changed *******************************************/
+	if (frozen && ws->frozen_mode == 1) frozen->branch = branch;
+	ws->frozen_point = 0;
+	if (ws->grad && y2v < 0) ws->grad[3] = -ws->grad[3];	// computed at |y2|
+	/*******************************************   end   *******************************************/
 
 	if (y2v < 0) {
 		y_2 = y2v;
@@ -1649,7 +3058,10 @@ double VBMicrolensing::BinaryMag2(double s, double q, double y1v, double y2v, do
 }
 
 double VBDefaultCumulativeFunction(double cb, double* a1) {
-	static double r2, cr2, scr2, cc;
+	/******************************************* changed *******************************************/
+	double r2, cr2, scr2, cc;
+	//static double r2, cr2, scr2, cc;
+	/*******************************************   end   *******************************************/
 	r2 = cb * cb;
 	cr2 = 1 - r2;
 	scr2 = sqrt(cr2);
@@ -1657,17 +3069,103 @@ double VBDefaultCumulativeFunction(double cb, double* a1) {
 	return cc;
 }
 
+/******************************************* changed *******************************************/
+#define _Multipole_safety 4		// MultipoleMag: the rho^4 term times this factor must be within Tol + RelTol * A
+#define _Multipole_convergence 0.1	// MultipoleMag: the quadrupole term of each point must be below this fraction of its magnification
+
+double VBMicrolensing::MultipoleMag(double s, double q, double y1, double y2, double rho, double accuracy) {
+	double A0, A, A2, A4, N, M2, M4;
+	double Aring[3] = { 0., 0., 0. };
+	const double r[3] = { 0.5, 1., 1. }, phase[3] = { 0., 0., 0.25 * M_PI };	// rho/2 and rho on the axes, rho on the diagonals
+	int nim, nim0old = nim0, c;
+	double *grad = ws->grad, g0[5], g[5], gring[3][5] = {};	// BinaryMag2Gradient: derivatives of A0, A and Aring
+	_lens_tangents lens(s, q);
+	auto pointmag = [&](double py1, double py2, double *pg) {	// BinaryMag0, and its derivatives in pg with grad
+		_sols_for_skiplist_curve *images = _workspace_images(ws);
+		double Ap = BinaryMag0(s, q, py1, py2, &images, true);
+		if (grad) _point_gradient(images, lens, pg);
+		images->clear();
+		return Ap;
+	};
+
+	// the point-source magnification at the center, and averaged on the three crosses of 4 points.
+	// Every point must have as many images as the center and pass the ghost image test, so that no caustic (nor cusp
+	// between the points) enters the source. The quadrupole estimate of BinaryMag0 (Bozza et al. 2018, from J2 and J3)
+	// at each point must also be a small fraction of its magnification: the expansion in rho converges, which the
+	// ghost image test alone does not tell near the planetary caustics
+	A0 = pointmag(y1, y2, g0);
+	nim = nim0;
+	if (!(6 * corrquad * rho * rho < _Multipole_convergence * A0)) A0 = -1;
+	for (c = 0; c < 12 && A0 > 0; c++) {
+		double phi = phase[c / 4] + 0.5 * M_PI * (c % 4);
+		A = pointmag(y1 + r[c / 4] * rho * cos(phi), y2 + r[c / 4] * rho * sin(phi), g);
+		if (A <= 0 || nim0 != nim || corrquad2 * (rho + 1.e-3) >= 1) break;
+		if (!(6 * corrquad * rho * rho < _Multipole_convergence * A)) break;
+		Aring[c / 4] += 0.25 * A;
+		if (grad) {
+			for (int j = 0; j < 4; j++) gring[c / 4][j] += 0.25 * g[j];
+			gring[c / 4][4] += 0.25 * r[c / 4] * (cos(phi) * g[2] + sin(phi) * g[3]);	// the point moves with rho
+		}
+	}
+	nim0 = nim0old;										// BinaryMagDark may still use the nim0 of BinaryMag2
+	if (c < 12) return -1;
+
+	// ring average A0 + A2 r^2 + A4 r^4 of the magnification (Gould 2008), here A2 and A4 include rho^2 and rho^4
+	A2 = (16 * (Aring[0] - A0) - (Aring[1] - A0)) / 3;
+	A4 = 0.5 * (Aring[1] + Aring[2]) - A0 - A2;
+	// the rho^4 term is the error estimate of the rho^2 one, the truncated terms can be of the same order
+	if (!(fabs(A4) * _Multipole_safety < accuracy + RelTol * A0)) return -1;
+
+	// mean of r^2/rho^2 and r^4/rho^4 weighted by the linear limb darkening 1 - a1 (1 - sqrt(1 - r^2/rho^2))
+	N = 1 - a1 / 3;
+	M2 = ((1 - a1) / 2 + 4 * a1 / 15) / N;
+	M4 = ((1 - a1) / 3 + 16 * a1 / 105) / N;
+	if (grad) {
+		for (int j = 0; j < 5; j++) {
+			double G2 = (16 * (gring[0][j] - g0[j]) - (gring[1][j] - g0[j])) / 3;
+			grad[j] = g0[j] + G2 * M2 + (0.5 * (gring[1][j] + gring[2][j]) - g0[j] - G2) * M4;
+		}
+	}
+	y_1 = y1;
+	y_2 = y2;
+	return A0 + A2 * M2 + A4 * M4;
+}
+/*******************************************   end   *******************************************/
+
 double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, double RSv, double Tolnew) {
-	static double Mag, Magold, Tolv;
-	static double LDastrox1, LDastrox2;
-	static double tc, lc, rc, cb, rb;
-	static int c, flag;
-	static double currerr, maxerr;
-	static annulus* first, * scan, * scan2;
-	static int nannold, totNPS;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double Mag, Magold, Tolv;
+	double LDastrox1, LDastrox2;
+	double tc, cb, rb;
+	//double tc, lc, rc, cb, rb;
+	int c, flag;
+	double currerr, maxerr;
+	annulus* first, * scan, * scan2;
+	int nannold, totNPS;
+	//static double Mag, Magold, Tolv;
+	//static double LDastrox1, LDastrox2;
+	//static double tc, lc, rc, cb, rb;
+	//static int c, flag;
+	//static double currerr, maxerr;
+	//static annulus* first, * scan, * scan2;
+	//static int nannold, totNPS;
+	/*******************************************   end   *******************************************/
 	/******************************************* changed *******************************************/
 	//static _sols *Images;
-	static _sols_for_skiplist_curve *Images;
+	_sols_for_skiplist_curve *Images;
+	//static _sols_for_skiplist_curve *Images;
+	// frozen sampling (see RecordSampling): the annuli are computed one by one on this instance, so that their contours
+	// go to the record of the point. In replay mode, a single pass splits the annuli at the recorded radii, in order,
+	// and goes on as usual only if the error estimate is then beyond twice the recorded one
+	_frozen_point *frozen = ws->frozen_point;
+	bool replay = frozen && ws->frozen_mode == 2 && frozen->branch == 2;
+	size_t iannulus = 0;
+	double *grad = ws->grad;		// BinaryMag2Gradient: each annulus keeps its derivatives, combined at the end of a pass
 	/*******************************************   end   *******************************************/
 
 	Mag = -1.0;
@@ -1681,6 +3179,9 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 	y_1 = y1;
 	y_2 = y2;
 	while ((Mag < 0.9) && (c < 3)) {
+		/******************************************* changed *******************************************/
+		if (frozen && ws->frozen_mode == 1) frozen->clear();	// only the last pass is recorded
+		/*******************************************   end   *******************************************/
 
 		first = new annulus;
 		first->bin = 0.;
@@ -1688,11 +3189,19 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 		if (Mag0 > 0.5) {
 			first->Mag = Mag0;
 			first->nim = nim0;
+			/******************************************* changed *******************************************/
+			if (grad) memcpy(first->grad, ws->grad0, sizeof(ws->grad0));
+			/*******************************************   end   *******************************************/
 		}
 		else {
-			first->Mag = BinaryMag0(a, q, y_1, y_2, &Images);
+			/******************************************* changed *******************************************/
+			Images = _workspace_images(ws);
+			first->Mag = BinaryMag0(a, q, y_1, y_2, &Images, true);
 			first->nim = Images->length;
-			delete Images;
+			if (grad) _point_gradient(Images, _lens_tangents(a, q), first->grad);
+			Images->clear();
+			//delete Images;
+			/*******************************************   end   *******************************************/
 		}
 		if (astrometry) {
 			first->LDastrox1 = astrox1 * first->Mag;
@@ -1710,14 +3219,24 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 		scan->next = 0;
 		scan->bin = 1.;
 		scan->cum = 1.;
-		scan->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv, &Images);
+		/******************************************* changed *******************************************/
+		Images = _workspace_images(ws);
+		/*******************************************   end   *******************************************/
+		/******************************************* changed *******************************************/
+		scan->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv, &Images, true);
+		//scan->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv, &Images);
+		/*******************************************   end   *******************************************/
 		if (astrometry) {
 			scan->LDastrox1 = astrox1 * scan->Mag;
 			scan->LDastrox2 = astrox2 * scan->Mag;
 		}
 		totNPS += NPS;
 		scan->nim = Images->length;
-		delete Images;
+		/******************************************* changed *******************************************/
+		if (grad) _contour_gradient(ws, Images, a, q, RSv, 1., scan->Mag, scan->grad);
+		Images->clear();
+		//delete Images;
+		/*******************************************   end   *******************************************/
 		scr2 = sscr2 = 1;
 		scan->f = LDprofile(0.9999999);
 		if (scan->nim == scan->prev->nim) {
@@ -1736,7 +3255,10 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 		currerr = scan->err;
 		flag = 0;
 		nannuli = nannold = 1;
-		while (((flag < nannold + 5) && (currerr > Tolv) && (currerr > RelTol * Mag)) || (nannuli < minannuli)) {
+		/******************************************* changed *******************************************/
+		while (replay ? (iannulus < frozen->annuli.size() || ((currerr > 2 * frozen->annuli_error) && (currerr > Tolv) && (currerr > RelTol * Mag))) : (((flag < nannold + 5) && (currerr > Tolv) && (currerr > RelTol * Mag)) || (nannuli < minannuli))) {
+		//while (((flag < nannold + 5) && (currerr > Tolv) && (currerr > RelTol * Mag)) || (nannuli < minannuli)) {
+		/*******************************************   end   *******************************************/
 			maxerr = 0;
 			for (scan2 = first->next; scan2; scan2 = scan2->next) {
 #ifdef _PRINT_ERRORS_DARK
@@ -1747,6 +3269,11 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 					scan = scan2;
 				}
 			}
+			/******************************************* changed *******************************************/
+			if (replay && iannulus < frozen->annuli.size()) {		// the annulus containing the next recorded radius
+				for (scan = first->next; scan->next && scan->cum <= frozen->annuli[iannulus]; scan = scan->next);
+			}
+			/*******************************************   end   *******************************************/
 
 			nannuli++;
 			Magold = Mag;
@@ -1756,10 +3283,14 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 				LDastrox2 -= (scan->LDastrox2 * scan->bin * scan->bin - scan->prev->LDastrox2 * scan->prev->bin * scan->prev->bin) * (scan->cum - scan->prev->cum) / (scan->bin * scan->bin - scan->prev->bin * scan->prev->bin);
 			}
 			currerr -= scan->err;
-			lc = scan->prev->cum;
-			rc = scan->cum;
-			tc = (lc + rc) * 0.5;
+			/******************************************* changed *******************************************/
+			tc = (replay && iannulus < frozen->annuli.size()) ? frozen->annuli[iannulus++] : (scan->prev->cum + scan->cum) * 0.5;
 			cb = rCLDprofile(tc, scan->prev, scan);
+			if (frozen && ws->frozen_mode == 1) frozen->annuli.push_back(tc);
+			//lc = scan->prev->cum;
+			//rc = scan->cum;
+			//tc = (lc + rc) * 0.5;
+			/*******************************************   end   *******************************************/
 			scan->prev->next = new annulus;
 			scan->prev->next->prev = scan->prev;
 			scan->prev = scan->prev->next;
@@ -1767,13 +3298,21 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 			scan->prev->bin = cb;
 			scan->prev->cum = tc;
 			scan->prev->f = LDprofile(cb);
-			scan->prev->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv * cb, &Images);
+			/******************************************* changed *******************************************/
+			Images = _workspace_images(ws);
+			scan->prev->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv * cb, &Images, true);
+			//scan->prev->Mag = BinaryMagSafe(a, q, y_1, y_2, RSv * cb, &Images);
+			/*******************************************   end   *******************************************/
 			if (astrometry) {
 				scan->prev->LDastrox1 = astrox1 * scan->prev->Mag;
 				scan->prev->LDastrox2 = astrox2 * scan->prev->Mag;
 			}
 			totNPS += NPS;
 			scan->prev->nim = Images->length;
+			/******************************************* changed *******************************************/
+			if (grad) _contour_gradient(ws, Images, a, q, RSv * cb, cb, scan->prev->Mag, scan->prev->grad);
+			Images->clear();
+			/*******************************************   end   *******************************************/
 			if (scan->prev->prev->nim == scan->prev->nim) {
 				scan->prev->err = fabs((scan->prev->Mag - scan->prev->prev->Mag) * (scan->prev->prev->f - scan->prev->f) * (scan->prev->bin * scan->prev->bin - scan->prev->prev->bin * scan->prev->prev->bin) / 4);
 			}
@@ -1789,10 +3328,12 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 			rb = (scan->Mag + scan->prev->prev->Mag - 2 * scan->prev->Mag);
 			scan->prev->err += fabs(rb * (scan->prev->prev->f - scan->prev->f) * (scan->prev->bin * scan->prev->bin - scan->prev->prev->bin * scan->prev->prev->bin));
 			scan->err += fabs(rb * (scan->prev->f - scan->f) * (scan->bin * scan->bin - scan->prev->bin * scan->prev->bin));
+			/******************************************* changed *******************************************/
 #ifdef _PRINT_ERRORS_DARK
-			printf("\n%d", Images->length);
+			printf("\n%d", scan->prev->nim);
 #endif
-			delete Images;
+			//delete Images;				// cleared right after the gradient, see above
+			/*******************************************   end   *******************************************/
 
 			Mag += (scan->bin * scan->bin * scan->Mag - cb * cb * scan->prev->Mag) * (scan->cum - scan->prev->cum) / (scan->bin * scan->bin - scan->prev->bin * scan->prev->bin);
 			Mag += (cb * cb * scan->prev->Mag - scan->prev->prev->bin * scan->prev->prev->bin * scan->prev->prev->Mag) * (scan->prev->cum - scan->prev->prev->cum) / (scan->prev->bin * scan->prev->bin - scan->prev->prev->bin * scan->prev->prev->bin);
@@ -1814,6 +3355,13 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 			}
 
 		}
+		/******************************************* changed *******************************************/
+		if (frozen && ws->frozen_mode == 1) frozen->annuli_error = currerr;
+		if (grad) _annuli_gradient(first, grad);
+#ifdef _HOTPATH_STATS
+		stats.annuli += nannuli;
+#endif
+		/*******************************************   end   *******************************************/
 
 		if (multidark) {
 			annlist = first;
@@ -1828,6 +3376,9 @@ double VBMicrolensing::BinaryMagDark(double a, double q, double y1, double y2, d
 
 		Tolv /= 10;
 		c++;
+		/******************************************* changed *******************************************/
+		replay = false;		// the passes after a failed one are adaptive
+		/*******************************************   end   *******************************************/
 	}
 	NPS = totNPS;
 	therr = currerr;
@@ -1924,16 +3475,34 @@ void VBMicrolensing::BinaryMagMultiDark(double a, double q, double y1, double y2
 
 
 _curve* VBMicrolensing::NewImages(complex yi, complex * coefs, _theta * theta) {
-	static complex  y, yc, z, zc, J1, J1c, dy, dz, dJ, J2, J3, dza, za2, zb2, zaltc, Jalt, Jaltc, JJalt2;
-	static complex zr[5] = { 0.,0.,0.,0.,0. };
-	static double dlmin = 1.0e-4, dlmax = 1.0e-3, good[5], dJ2, ob2, cq;
-	static int worst1, worst2, worst3, bad, f1, checkJac;
-	static double av = 0.0, m1v = 0.0, disim, disisso;
-	static _curve* Prov;
-	static _point* scan, * prin, * fifth, * left, * right, * center;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	stats.NewImages_calls++;
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	// zr[] keeps the roots of the previous call in the per-instance workspace
+	complex  y, yc, z, zc, J1, J1c, dy, dz, dJ, J2, J3, dza, za2, zb2, zaltc, Jalt, Jaltc, JJalt2;
+	complex *zr = ws->zr_binary;
+	const double dlmin = 1.0e-4, dlmax = 1.0e-3;
+	double good[5], dJ2, ob2, cq;
+	int worst1 = 0, worst2 = 0, worst3 = 0, f1, checkJac;
+	_curve* Prov;
+	_point* scan, * prin, * fifth, * left, * right, * center;
+	//static complex  y, yc, z, zc, J1, J1c, dy, dz, dJ, J2, J3, dza, za2, zb2, zaltc, Jalt, Jaltc, JJalt2;
+	//static complex zr[5] = { 0.,0.,0.,0.,0. };
+	//static double dlmin = 1.0e-4, dlmax = 1.0e-3, good[5], dJ2, ob2, cq;
+	//static int worst1, worst2, worst3, bad, f1, checkJac;
+	//static double av = 0.0, m1v = 0.0, disim, disisso;
+	//static _curve* Prov;
+	//static _point* scan, * prin, * fifth, * left, * right, * center;
+	/*******************************************   end   *******************************************/
 
 #ifdef _PRINT_TIMES
-	static double tim0, tim1;
+	/******************************************* changed *******************************************/
+	double tim0, tim1;
+	//static double tim0, tim1;
+	/*******************************************   end   *******************************************/
 #endif
 
 	y = yi + coefs[11];
@@ -1965,13 +3534,21 @@ _curve* VBMicrolensing::NewImages(complex yi, complex * coefs, _theta * theta) {
 	// coefs[4] = yc * (coefs[4] - 1) - coefs[20] * (coefs[4] - coefs[21]);
 	// coefs[5] = yc * (coefs[20] - yc);
 
-	bad = 1;
-	disim = -1.;
+	/******************************************* changed *******************************************/
+	//bad = 1;			// never read
+	//disim = -1.;
+	/*******************************************   end   *******************************************/
 	f1 = 0;
 
 #ifdef _PRINT_TIMES
 	tim0 = Environment::TickCount;
 #endif
+	/******************************************* changed *******************************************/
+	if (ws->zr_given) {						// roots solved by a helper thread of the parallel contour of BinaryMag
+		for (int i = 0; i < 5; i++) zr[i] = ws->zr_given[i];
+	}
+	else
+	/*******************************************   end   *******************************************/
 	cmplx_roots_gen(zr, coefs, 5, true, true);
 
 #ifdef _PRINT_TIMES
@@ -2166,22 +3743,32 @@ _curve* VBMicrolensing::NewImages(complex yi, complex * coefs, _theta * theta) {
 /******************************************* changed *******************************************/
 //void VBMicrolensing::OrderImages(_sols *Sols, _curve *Newpts) {
 void VBMicrolensing::OrderImages(_sols_for_skiplist_curve * Sols, _curve * Newpts) {
-	static double A[5][5];
-	static _skiplist_curve *cprec[5];
-	static _skiplist_curve *cpres[5];
-	static _skiplist_curve *cfoll[5];
+	double A[5][5];
+	_skiplist_curve *cprec[5];
+	_skiplist_curve *cpres[5];
+	_skiplist_curve *cfoll[5];
+	//static double A[5][5];
+	//static _skiplist_curve *cprec[5];
+	//static _skiplist_curve *cpres[5];
+	//static _skiplist_curve *cfoll[5];
 	//static _curve *cprec[5];
 	//static _curve *cpres[5];
 	//static _curve *cfoll[5];
-	static _point *scan, *scan2, *isso[2];//*scan3, 
-	static _skiplist_curve *scurve, *scurve2 ;
+	_point *scan, *scan2, *isso[2] = { 0, 0 };//*scan3, 
+	_skiplist_curve *scurve, *scurve2 ;
+	//static _point *scan, *scan2, *isso[2];//*scan3, 
+	//static _skiplist_curve *scurve, *scurve2 ;
 	//static _curve *scurve, *scurve2;
 
-	static std::minstd_rand engine{std::random_device{}()} ;
+	std::minstd_rand &engine = ws->engine ;		// per-instance level generator, no longer a static local
+	//static std::minstd_rand engine{std::random_device{}()} ;
 /*******************************************   end   *******************************************/
 
 	_theta* theta;
-	static double th, mi, cmp, cmp2, cmp_2, dx2, avgx2, avgx1, avg2x1, pref, d2x2, dx1, d2x1, avgwedgex1, avgwedgex2, parab1, parab2;
+	/******************************************* changed *******************************************/
+	double th, mi, cmp, cmp2, cmp_2, dx2, avgx2, avgx1, avg2x1, pref, d2x2, dx1, d2x1, avgwedgex1, avgwedgex2, parab1, parab2;
+	//static double th, mi, cmp, cmp2, cmp_2, dx2, avgx2, avgx1, avg2x1, pref, d2x2, dx1, d2x1, avgwedgex1, avgwedgex2, parab1, parab2;
+	/*******************************************   end   *******************************************/
 
 	int nprec = 0, npres, nfoll = 0, issoc[2], ij;
 
@@ -2912,6 +4499,21 @@ void VBMicrolensing::SetLensGeometry(int nn, double* pr) {
 }
 
 void VBMicrolensing::SetLensGeometry(int nn, double* q, complex* s) {
+	/******************************************* changed *******************************************/
+	ws->geom_q.assign(q, q + nn);
+	ws->geom_s.assign(s, s + nn);
+	// planetary caustic of each light lens, at d - 1 / conj(d) from the heaviest lens at distance d, as for the binary lens
+	int imax = 0;
+	for (int i = 1; i < nn; i++) if (q[i] > q[imax]) imax = i;
+	ws->caustic_centers.clear();
+	ws->caustic_sizes2.clear();
+	for (int i = 0; i < nn; i++) {
+		complex d = s[i] - s[imax];
+		if (i == imax || !(q[i] < 0.01 * q[imax]) || abs2(d) == 0) continue;
+		ws->caustic_centers.push_back(s[i] - 1 / conj(d));
+		ws->caustic_sizes2.push_back(36 * q[i] / q[imax] / abs2(d));
+	}
+	/*******************************************   end   *******************************************/
 	switch (SelectedMethod)
 	{
 	case Method::Singlepoly:
@@ -2931,10 +4533,16 @@ void VBMicrolensing::SetMethod(Method Met) {
 }
 
 void VBMicrolensing::SetLensGeometry_spnp(int nn, double* q, complex* s) {
-	static double sumq, qmin, Jac;
-	static int iqmin, dg;
-	static complex pbin[2], z, S2, fac;
-	static int i, j;
+	/******************************************* changed *******************************************/
+	double sumq, qmin, Jac;
+	int iqmin, dg;
+	complex pbin[2], z, S2, fac;
+	int i, j;
+	//static double sumq, qmin, Jac;
+	//static int iqmin, dg;
+	//static complex pbin[2], z, S2, fac;
+	//static int i, j;
+	/*******************************************   end   *******************************************/
 
 	change_n(nn);
 
@@ -2964,15 +4572,29 @@ void VBMicrolensing::SetLensGeometry_spnp(int nn, double* q, complex* s) {
 	// Central images for close-by lenses. Only used if J<0 as additional initial conditions.
 	// Central images are calculated here because they do not depend on the source.
 	lencentralimages = 0;
+	/******************************************* changed *******************************************/
+	// only pairs of close-by lenses: for the others, centralimages[lencentralimages] is not set yet, and the test read
+	// whatever the allocation left there, so that results depended on the history of the heap
 	for (i = 0; i < n - 1; i++) {
 		for (j = i + 1; j < n; j++) {
-			if (abs(a[i] - a[j]) < m[i] + m[j])
+			if (abs(a[i] - a[j]) < m[i] + m[j]) {
 				centralimages[lencentralimages] = (m[j] * a[i] + m[i] * a[j]) / (m[i] + m[j]);
-			z = centralimages[lencentralimages];
-			_Jac
-				if (Jac < 0) lencentralimages++;
+				z = centralimages[lencentralimages];
+				_Jac
+					if (Jac < 0) lencentralimages++;
+			}
 		}
 	}
+	//for (i = 0; i < n - 1; i++) {
+	//	for (j = i + 1; j < n; j++) {
+	//		if (abs(a[i] - a[j]) < m[i] + m[j])
+	//			centralimages[lencentralimages] = (m[j] * a[i] + m[i] * a[j]) / (m[i] + m[j]);
+	//		z = centralimages[lencentralimages];
+	//		_Jac
+	//			if (Jac < 0) lencentralimages++;
+	//	}
+	//}
+	/*******************************************   end   *******************************************/
 
 	for (int i = 0; i < n; i++) {
 		pmza[i][0] = m[i];
@@ -2995,9 +4617,14 @@ void VBMicrolensing::SetLensGeometry_spnp(int nn, double* q, complex* s) {
 }
 
 void VBMicrolensing::SetLensGeometry_multipoly(int nn, double* q, complex* s) {
-	static int j, i, x, k, p, dg;
-	static double tempq, sumq;
-	static complex temps, pbin[2];
+	/******************************************* changed *******************************************/
+	int j, i, x, k, p = 0, dg;		// p = 0 as the static had on the first call: no swap, no further passes
+	double tempq, sumq;
+	complex temps, pbin[2];
+	//static int j, i, x, k, p, dg;
+	//static double tempq, sumq;
+	//static complex temps, pbin[2];
+	/*******************************************   end   *******************************************/
 
 	change_n_mp(nn);
 
@@ -3111,12 +4738,34 @@ void VBMicrolensing::SetLensGeometry_multipoly(int nn, double* q, complex* s) {
             break;                                         \
     }
 
+/******************************************* changed *******************************************/
+// the images of the current y by the selected method, as in the contour of MultiMag. The solvers of the three methods
+// do not start from the roots of the previous point, so a worker instance with the same lens geometry gives the images
+// of the serial loop (parallel contour of MultiMag).
+_curve* VBMicrolensing::NewImagesMethod(_theta* theta) {
+	_curve* Prov = 0;
+	EXECUTE_METHOD(SelectedMethod, theta)
+	return Prov;
+}
+/*******************************************   end   *******************************************/
+
 double VBMicrolensing::MultiMag0(complex yi, _sols** Images) {
-	static double Mag = -1.0;
+	/******************************************* changed *******************************************/
+	double Mag = -1.0;
+	//static double Mag = -1.0;
+	/*******************************************   end   *******************************************/
 	_theta* stheta;
-	_curve* Prov, * Prov2;
+	/******************************************* changed *******************************************/
+	_curve* Prov = 0, * Prov2;
+	//_curve* Prov, * Prov2;
+	/*******************************************   end   *******************************************/
 	_point* scan1, * scan2;
 
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+	/*******************************************   end   *******************************************/
 	stheta = new _theta(-1.);
 
 	y = yi - *s_offset; // Source position relative to first (lowest) mass
@@ -3125,6 +4774,13 @@ double VBMicrolensing::MultiMag0(complex yi, _sols** Images) {
 	(*Images) = new _sols;
 	corrquad = corrquad2 = 0; // to be implemented for v2.0
 	safedist = 10;
+	/******************************************* changed *******************************************/
+	// squared distance from the closest planetary caustic minus its squared size, as in BinaryMag0 (see SetLensGeometry)
+	for (size_t i = 0; i < ws->caustic_centers.size(); i++) {
+		double sd = abs2(yi - ws->caustic_centers[i]) - ws->caustic_sizes2[i];
+		if (sd < safedist) safedist = sd;
+	}
+	/*******************************************   end   *******************************************/
 
 	EXECUTE_METHOD(SelectedMethod, stheta)
 
@@ -3145,16 +4801,24 @@ double VBMicrolensing::MultiMag0(complex yi, _sols** Images) {
 }
 
 double VBMicrolensing::MultiMag0(complex y) {
-	static _sols* images;
-	static double mag;
+	/******************************************* changed *******************************************/
+	_sols* images;
+	double mag;
+	//static _sols* images;
+	//static double mag;
+	/*******************************************   end   *******************************************/
 	mag = MultiMag0(y, &images);
 	delete images;
 	return mag;
 }
 
 double VBMicrolensing::MultiMag0(double y1, double y2) {
-	static _sols* images;
-	static double mag;
+	/******************************************* changed *******************************************/
+	_sols* images;
+	double mag;
+	//static _sols* images;
+	//static double mag;
+	/*******************************************   end   *******************************************/
 	complex y = complex(y1, y2);
 	mag = MultiMag0(y, &images);
 	delete images;
@@ -3162,41 +4826,59 @@ double VBMicrolensing::MultiMag0(double y1, double y2) {
 }
 
 /******************************************* changed *******************************************/
-double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_skiplist_curve **Images) {
+double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_skiplist_curve **Images, bool reuse_images) {
 //double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols** Images) {
 /*******************************************   end   *******************************************/
-	static complex y0;
-	static double Mag = -1.0, th, thoff = 0.01020304, thoff2 = 0.7956012033974483; //0.01020304
-	static double errimage, maxerr, currerr, Magold, rhorad2, th2;
-	static int NPSmax, flag, NPSold, isquare, flagfinal;
-	static _thetas* Thetas;
-	static _theta* stheta, * itheta, * jtheta;
+	/******************************************* changed *******************************************/
+	complex y0;
+	double Mag = -1.0, th, thoff = 0.01020304, thoff2 = 0.7956012033974483; //0.01020304
+	double errimage, maxerr, currerr, Magold, rhorad2, th2;
+	int NPSmax, flag, NPSold, isquare, flagfinal;
+	_thetas* Thetas;
+	_theta* stheta, * itheta, * jtheta;
+	//static complex y0;
+	//static double Mag = -1.0, th, thoff = 0.01020304, thoff2 = 0.7956012033974483; //0.01020304
+	//static double errimage, maxerr, currerr, Magold, rhorad2, th2;
+	//static int NPSmax, flag, NPSold, isquare, flagfinal;
+	//static _thetas* Thetas;
+	//static _theta* stheta, * itheta, * jtheta;
+	/*******************************************   end   *******************************************/
 	/******************************************* changed *******************************************/
 	//static _curve *Prov, *Prov2;	// there is also a 'Prov' in NewImages(), but they are different static local variables. 
-	static _curve * Prov ;
-	static _skiplist_curve * Prov2 ;
+	_curve * Prov = 0 ;
+	_skiplist_curve * Prov2 ;
+	//static _curve * Prov ;
+	//static _skiplist_curve * Prov2 ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	_point* scan1, * scan2;
+	int lsquares[4];
+	//static _point* scan1, * scan2;
+	//static int lsquares[4];
+	bool contour_batches = false;	// parallel contour: the rest of the call goes on in batches (see contourthreads)
 	/*******************************************   end   *******************************************/
-	static _point* scan1, * scan2;
-	static int lsquares[4];
 
 	/******************************************* changed *******************************************/
-	static std::minstd_rand engine_start{std::random_device{}()} ;
+	std::minstd_rand &engine_start = ws->engine ;
+	//static std::minstd_rand engine_start{std::random_device{}()} ;
 	/*******************************************   end   *******************************************/
 	
 	/******************************************* changed *******************************************/
-	static _augmented_priority_queue APQ ;
+	// the heap of the intervals is now part of Thetas (see _thetas::clear)
+	//_augmented_priority_queue &APQ = ws->APQ ;
+	//static _augmented_priority_queue APQ ;
 
-	if (APQ.apq_array.capacity() > 2048)
-	{
-		APQ.apq_array.resize(2048) ;
-		APQ.sum_tree_array.resize(2048) ;
+	//if (APQ.apq_array.capacity() > 2048)
+	//{
+	//	APQ.apq_array.resize(2048) ;
+	//	APQ.sum_tree_array.resize(2048) ;
 
-		APQ.apq_array.shrink_to_fit() ;
-		APQ.sum_tree_array.shrink_to_fit() ;
-	}
+	//	APQ.apq_array.shrink_to_fit() ;
+	//	APQ.sum_tree_array.shrink_to_fit() ;
+	//}
 	
-	APQ.apq_array.clear() ;
-	APQ.sum_tree_array.clear() ;
+	//APQ.apq_array.clear() ;
+	//APQ.sum_tree_array.clear() ;
 	/*******************************************   end   *******************************************/
 
 	/******************************************* changed *******************************************/
@@ -3209,6 +4891,11 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 	/*******************************************   end   *******************************************/
 
 
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+	/*******************************************   end   *******************************************/
 	try {
 		y0 = yi - *s_offset; // Source position relative to first (lowest) mass
 		rho = RSv;
@@ -3228,12 +4915,17 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 
 		// Calculation of the images
 		/******************************************* changed *******************************************/
-		(*Images) = new _sols_for_skiplist_curve ;
+		if (reuse_images) (*Images) = &ws->images ;	// already empty
+		else (*Images) = new _sols_for_skiplist_curve ;
 		//(*Images) = new _sols;			// create a _sols class variable without any member (_curve class variables) 
 										// and make static pointer 'images'(i.e. *Images) point to that object
 		/*******************************************   end   *******************************************/
 
-		Thetas = new _thetas;
+		/******************************************* changed *******************************************/
+		Thetas = &ws->thetas;			// the list of the workspace, emptied, with its storage kept from the previous calls
+		Thetas->clear();
+		//Thetas = new _thetas;
+		/*******************************************   end   *******************************************/
 		th = thoff;
 		stheta = Thetas->insert(th);
 		/******************************************* changed *******************************************/
@@ -3303,7 +4995,17 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 
 			EXECUTE_METHOD(SelectedMethod, stheta)
 
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			auto OrderImages_begin = std::chrono::steady_clock::now();
+#endif
+			/*******************************************   end   *******************************************/
 				OrderMultipleImages((*Images), Prov);
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.OrderImages_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - OrderImages_begin).count();
+#endif
+			/*******************************************   end   *******************************************/
 		}
 		NPS = 4;
 
@@ -3365,14 +5067,17 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 //					itheta = stheta;
 //				}
 
-				APQ.push_augmented_heap(stheta->maxerr, stheta) ;
+				Thetas->push_error(stheta->maxerr, stheta) ;
+				//APQ.push_augmented_heap(stheta->maxerr, stheta) ;
 			}
 
 			stheta = stheta->next;
 		}
 
-		itheta  = APQ.apq_array[0].stheta ;
-		currerr = APQ.sum_tree_array[0].sumerr ;
+		itheta  = Thetas->worst() ;
+		currerr = Thetas->total_error() ;
+		//itheta  = APQ.apq_array[0].stheta ;
+		//currerr = APQ.sum_tree_array[0].sumerr ;
 		/*******************************************   end   *******************************************/
 		th = (itheta->th + itheta->next->th) * 0.5;
 
@@ -3381,7 +5086,10 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 		Magold = -1.;
 		NPSold = NPS + 1;
 
-		while (((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold))) {
+		/******************************************* changed *******************************************/
+		while (((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold)) && !contour_batches) {
+		//while (((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold))) {
+		/*******************************************   end   *******************************************/
 			
 			/******************************************* changed *******************************************/
 			//stheta = Thetas->insert(th);
@@ -3422,7 +5130,17 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 			/*******************************************   end   *******************************************/
 
 			// Assign new images to correct curves
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			auto OrderImages_begin = std::chrono::steady_clock::now();
+#endif
+			/*******************************************   end   *******************************************/
 			OrderMultipleImages((*Images), Prov);
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.OrderImages_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - OrderImages_begin).count();
+#endif
+			/*******************************************   end   *******************************************/
 
 			/******************************************* changed *******************************************/
 			Mag += stheta->prev->Mag ;
@@ -3447,8 +5165,10 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 				stheta->prev->maxerr = 0;				// stop to insert new theta behind stheta and stheta->prev
 			}
 
-			APQ.pop_then_push_augmented_heap(stheta->prev->maxerr, stheta->prev) ;
-			APQ.push_augmented_heap(stheta->maxerr, stheta) ;
+			Thetas->pop_then_push_error(stheta->prev->maxerr, stheta->prev) ;
+			Thetas->push_error(stheta->maxerr, stheta) ;
+			//APQ.pop_then_push_augmented_heap(stheta->prev->maxerr, stheta->prev) ;
+			//APQ.push_augmented_heap(stheta->maxerr, stheta) ;
 			/*******************************************   end   *******************************************/
 
 			/******************************************* changed *******************************************/
@@ -3479,8 +5199,10 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 			/*******************************************   end   *******************************************/
 
 			/******************************************* changed *******************************************/
-			itheta  = APQ.apq_array[0].stheta ;
-			currerr = APQ.sum_tree_array[0].sumerr ;
+			itheta  = Thetas->worst() ;
+			currerr = Thetas->total_error() ;
+			//itheta  = APQ.apq_array[0].stheta ;
+			//currerr = APQ.sum_tree_array[0].sumerr ;
 			/*******************************************   end   *******************************************/
 
 			th = (itheta->th + itheta->next->th) * 0.5;
@@ -3511,12 +5233,127 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 #ifdef _PRINT_ERRORS2
 			printf("\nNPS= %d nim=%d Mag = %lf maxerr= %lg currerr =%lg th = %lf", NPS, lim, Mag / (M_PI * RSv * RSv), maxerr / (M_PI * RSv * RSv), currerr / (M_PI * RSv * RSv), th);
 #endif
+			/******************************************* changed *******************************************/
+			contour_batches = (contourthreads > 1 && NPS >= _Contour_parallel_NPS);
+			/*******************************************   end   *******************************************/
+
+			}
 
+		/******************************************* changed *******************************************/
+		// parallel contour, as in BinaryMag: each batch splits the _Contour_batch intervals with the largest errors and
+		// the new points, sorted by angle, are solved in sectors of _Contour_sector points by the helper threads on their
+		// worker instances. The images of each point do not depend on the previous ones (see NewImagesMethod); they are
+		// merged one by one in order of angle, exactly as in the loop above, so that the result depends on the batches
+		// but not on the threads.
+		if (contour_batches) {
+			struct contour_point{
+				_theta *itheta;				// interval split by the new point
+				double th;
+				_curve *images;				// solved by the helper threads, owned here until merged
+				double errworst;
+				int imlength;
+			};
+			std::vector<contour_point> batch;
+			std::vector<_theta *> intervals;
+			std::vector<std::unique_ptr<VBMicrolensing>> &workers = ws->contour_workers;
+			if (!ws->contour_helpers || ws->contour_helpers->size() != contourthreads) ws->contour_helpers.reset(new _contour_helpers(contourthreads));
+			while ((int)workers.size() < contourthreads) workers.emplace_back(new VBMicrolensing);
+			for (int id = 0; id < contourthreads; id++) {
+				CopySettingsTo(workers[id].get());	// the lens geometry and the method
+				workers[id]->rho = rho;				// and the source, for the Jacobians of the images
+				workers[id]->rho2 = rho2;
+#ifdef _HOTPATH_STATS
+				workers[id]->stats = _call_stats();
+#endif
+			}
+			std::function<void(int, int)> solve_sector = [&](int id, int sector) {
+				VBMicrolensing &worker = *workers[id];
+				int kend = (sector + 1) * _Contour_sector < (int)batch.size() ? (sector + 1) * _Contour_sector : (int)batch.size();
+				for (int k = sector * _Contour_sector; k < kend; k++) {
+					_theta sectortheta(batch[k].th);
+					worker.y = y0 + complex(RSv * std::cos(batch[k].th), RSv * std::sin(batch[k].th));
+					batch[k].images = worker.NewImagesMethod(&sectortheta);
+					batch[k].errworst = sectortheta.errworst;
+					batch[k].imlength = sectortheta.imlength;
+				}
+			};
+
+			while ((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold)) {
+				intervals.clear();
+				currerr = 0.;
+				for (stheta = Thetas->first; stheta->next; stheta = stheta->next) {
+					currerr += stheta->maxerr;
+					if (stheta->maxerr > 0 && stheta->next->th - stheta->th > 1.e-8) intervals.push_back(stheta);
+				}
+				if (intervals.empty() || currerr <= errimage || currerr <= RelTol * Mag) break;
+				if ((int)intervals.size() > _Contour_batch) {
+					std::nth_element(intervals.begin(), intervals.begin() + _Contour_batch, intervals.end(), [](_theta *a, _theta *b) { return a->maxerr > b->maxerr; });
+					intervals.resize(_Contour_batch);
+				}
+				std::sort(intervals.begin(), intervals.end(), [](_theta *a, _theta *b) { return a->th < b->th; });
+				batch.resize(intervals.size());
+				for (size_t k = 0; k < intervals.size(); k++) {
+					batch[k].itheta = intervals[k];
+					batch[k].th = (intervals[k]->th + intervals[k]->next->th) * 0.5;
+				}
+				ws->contour_helpers->run(((int)batch.size() + _Contour_sector - 1) / _Contour_sector, solve_sector);
+
+				size_t k;
+				for (k = 0; k < batch.size(); k++) {
+					double olderr;
+					itheta = batch[k].itheta;
+					olderr = itheta->maxerr;
+					stheta = Thetas->insert_at_certain_position(itheta, batch[k].th);
+					stheta->errworst = batch[k].errworst;
+					stheta->imlength = batch[k].imlength;
+					Prov = batch[k].images;
+					for (scan1 = Prov->first; scan1; scan1 = scan1->next) scan1->theta = stheta;
+					Mag -= itheta->Mag;
+#ifdef _HOTPATH_STATS
+					auto OrderImages_begin = std::chrono::steady_clock::now();
+#endif
+					OrderMultipleImages((*Images), Prov);
+#ifdef _HOTPATH_STATS
+					stats.OrderImages_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - OrderImages_begin).count();
+#endif
+					Mag += itheta->Mag + stheta->Mag;
+					if ((stheta->th - itheta->th) < 1.e-8) {
+						stheta->maxerr = 0;
+						itheta->maxerr = 0;
+					}
+					currerr += stheta->maxerr + itheta->maxerr - olderr;
+					NPS++;
+					if (fabs(Magold - Mag) * 2 < errimage) {
+						flag++;
+					}
+					else {
+						flag = 0;
+						Magold = Mag;
+						NPSold = NPS + 1;
+					}
+					if (!((currerr > errimage) && (currerr > RelTol * Mag) && (NPS < NPSmax) && (flag < NPSold))) {
+						k++;
+						break;
+					}
+				}
+				for (; k < batch.size(); k++) delete batch[k].images;	// solved but not merged
 			}
+#ifdef _HOTPATH_STATS
+			for (int id = 0; id < contourthreads; id++) _add_worker_stats(stats, workers[id]->stats);
+#endif
+		}
+		/*******************************************   end   *******************************************/
 		Mag /= (M_PI * RSv * RSv);
 		therr = currerr / (M_PI * RSv * RSv);
+		/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+		stats.NPS += NPS;
+#endif
+		/*******************************************   end   *******************************************/
 
-		delete Thetas;
+		/******************************************* changed *******************************************/
+		//delete Thetas;				// Thetas belongs to the workspace
+		/*******************************************   end   *******************************************/
 
 		return Mag;
 
@@ -3542,36 +5379,269 @@ double VBMicrolensing::MultiMag(complex yi, double RSv, double Tol, _sols_for_sk
 double VBMicrolensing::MultiMag(complex y, double RSv, double Tol) {
 	/******************************************* changed *******************************************/
 	//static _sols *images;
-	static _sols_for_skiplist_curve * images ;
+	_sols_for_skiplist_curve * images = _workspace_images(ws) ;
+	//static _sols_for_skiplist_curve * images ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double mag;
+	//static double mag;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	mag = MultiMag(y, RSv, Tol, &images, true);
+	//mag = MultiMag(y, RSv, Tol, &images);
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	images->clear();		// the images of the workspace, emptied for the next call
+	//delete images;
 	/*******************************************   end   *******************************************/
-	static double mag;
-	mag = MultiMag(y, RSv, Tol, &images);
-	delete images;
 	return mag;
 }
 
 double VBMicrolensing::MultiMag(complex y, double RSv) {
 	/******************************************* changed *******************************************/
 	//static _sols *images;
-	static _sols_for_skiplist_curve * images ;
+	_sols_for_skiplist_curve * images = _workspace_images(ws) ;
+	//static _sols_for_skiplist_curve * images ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double mag;
+	//static double mag;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	mag = MultiMag(y, RSv, Tol, &images, true);
+	//mag = MultiMag(y, RSv, Tol, &images);
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	images->clear();		// the images of the workspace, emptied for the next call
+	//delete images;
 	/*******************************************   end   *******************************************/
-	static double mag;
-	mag = MultiMag(y, RSv, Tol, &images);
-	delete images;
 	return mag;
 }
 
 double VBMicrolensing::MultiMag(double y1, double y2, double RSv) {
 	/******************************************* changed *******************************************/
 	//static _sols *images;
-	static _sols_for_skiplist_curve * images ;
+	_sols_for_skiplist_curve * images = _workspace_images(ws) ;
+	//static _sols_for_skiplist_curve * images ;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	double mag;
+	//static double mag;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	mag = MultiMag(complex(y1, y2), RSv, Tol, &images, true);
+	//mag = MultiMag(complex(y1, y2), RSv, Tol, &images);
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	images->clear();		// the images of the workspace, emptied for the next call
+	//delete images;
 	/*******************************************   end   *******************************************/
-	static double mag;
-	mag = MultiMag(complex(y1, y2), RSv, Tol, &images);
-	delete images;
 	return mag;
 }
 
+/******************************************* changed *******************************************/
+double VBMicrolensing::MultiMag2(complex y, double RSv) {
+	double Mag, rho2;
+	bool ghosts = (SelectedMethod != Method::Nopoly);	// Nopoly does not look for the ghost images
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+
+	Mag0 = MultiMag0(y);
+	rho2 = RSv * RSv;
+	corrquad *= 6 * (rho2 + 1.e-4 * Tol);
+	corrquad2 *= corrquad2 * (RSv + 1.e-3);		// _MJacobians0bad gives |J3|, the test of Bozza et al. (2018) is on |J3|^2
+	if (ghosts && corrquad < Tol && corrquad2 < 1 && safedist > 4 * rho2) {
+		Mag = Mag0;
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 1;
+#endif
+	}
+	// hexadecapole approximation within Tol. Without the ghost image test, the checks on the 12 points of
+	// MultiMultipoleMag only replace it for sources where the point-source tier would apply
+	else if ((ghosts ? corrquad2 < 1 : corrquad < Tol) && (Mag = MultiMultipoleMag(y, RSv, Tol)) > 0) {
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 3;
+#endif
+	}
+	else {
+		Mag = MultiMag(y, RSv, Tol);
+#ifdef _HOTPATH_STATS
+		stats.BinaryMag2_branch = 2;
+#endif
+	}
+	Mag0 = 0;
+	return Mag;
+}
+
+double VBMicrolensing::MultiMag2(double y1, double y2, double RSv) {
+	return MultiMag2(complex(y1, y2), RSv);
+}
+
+double VBMicrolensing::MultiMultipoleMag(complex y, double RSv, double accuracy) {
+	double A0, A, A2, A4;
+	double Aring[3] = { 0., 0., 0. };
+	const double r[3] = { 0.5, 1., 1. }, phase[3] = { 0., 0., 0.25 * M_PI };	// rho/2 and rho on the axes, rho on the diagonals
+	bool ghosts = (SelectedMethod != Method::Nopoly);
+	int nim, c;
+#ifdef _HOTPATH_STATS
+	_stats_scope stats_scope(stats, ws->stats_depth);
+#endif
+
+	// the point-source magnification at the center, and averaged on the three crosses of 4 points, with the checks
+	// of MultipoleMag: same number of images as the center, the quadrupole estimate of each point below a fraction
+	// of its magnification and, if available, the ghost image test on every point
+	A0 = MultiMag0(y);
+	nim = nim0;
+	if (!(6 * corrquad * RSv * RSv < _Multipole_convergence * A0)) A0 = -1;
+	for (c = 0; c < 12 && A0 > 0; c++) {
+		double phi = phase[c / 4] + 0.5 * M_PI * (c % 4);
+		A = MultiMag0(y + complex(r[c / 4] * RSv * cos(phi), r[c / 4] * RSv * sin(phi)));
+		if (A <= 0 || nim0 != nim || (ghosts && corrquad2 * corrquad2 * (RSv + 1.e-3) >= 1)) break;
+		if (!(6 * corrquad * RSv * RSv < _Multipole_convergence * A)) break;
+		Aring[c / 4] += 0.25 * A;
+	}
+	if (c < 12) return -1;
+
+	// ring average A0 + A2 r^2 + A4 r^4 of the magnification (Gould 2008), with the moments 1/2 and 1/3 of a uniform source
+	A2 = (16 * (Aring[0] - A0) - (Aring[1] - A0)) / 3;
+	A4 = 0.5 * (Aring[1] + Aring[2]) - A0 - A2;
+	// the rho^4 term is the error estimate of the rho^2 one, the truncated terms can be of the same order
+	if (!(fabs(A4) * _Multipole_safety < accuracy + RelTol * A0)) return -1;
+	return A0 + A2 / 2 + A4 / 3;
+}
+/*******************************************   end   *******************************************/
+
+/******************************************* changed *******************************************/
+void VBMicrolensing::ObjectPoolStatistics(long long *objects, long long *slabs) {
+	*objects = pool_counters.objects;
+	*slabs = pool_counters.slabs;
+}
+/*******************************************   end   *******************************************/
+
+/******************************************* changed *******************************************/
+void VBMicrolensing::RecordSampling(void) {
+	ws->frozen_mode = 1;
+	ws->frozen.clear();
+}
+
+void VBMicrolensing::FreezeSampling(void) {
+	ws->frozen_mode = 2;
+}
+
+void VBMicrolensing::RemoveFrozenSampling(void) {
+	ws->frozen_mode = 0;
+	ws->frozen.clear();
+	ws->reset_seeds();		// the next curve as on a fresh instance
+}
+
+void VBMicrolensing::SetPointTolerances(double* tols, int np) {
+	ws->point_tols.assign(tols, tols + np);
+}
+
+void VBMicrolensing::SetPointTolerances(double* err, int* dataset, int ndatasets, double* FsFb, int np, double safety) {
+	double Fs;
+
+	ws->point_tols.assign(np, 0.);
+	for (int i = 0; i < np; i++) {
+		if (dataset[i] < 0 || dataset[i] >= ndatasets) continue;
+		Fs = fabs(FsFb[2 * dataset[i]]);
+		if (Fs > 0) ws->point_tols[i] = safety * err[i] / Fs;	// magnification error of a flux error of safety * err
+	}
+}
+
+void VBMicrolensing::RemovePointTolerances(void) {
+	ws->point_tols.clear();
+}
+/*******************************************   end   *******************************************/
+
+/******************************************* changed *******************************************/
+void VBMicrolensing::CopySettingsTo(VBMicrolensing *worker) {
+	worker->Tol = Tol;
+	worker->RelTol = RelTol;
+	worker->a1 = a1;
+	worker->a2 = a2;
+	worker->minannuli = minannuli;
+	worker->astrometry = astrometry;
+	worker->rootaccuracy = rootaccuracy;
+	worker->samplingfactor = samplingfactor;
+	worker->squarecheck = squarecheck;
+	worker->CumulativeFunction = CumulativeFunction;
+	worker->curLDprofile = curLDprofile;
+	if (worker->npLD > 0) {				// copy of an earlier call, on a reused worker
+		free(worker->LDtab);
+		free(worker->rCLDtab);
+		worker->npLD = 0;
+	}
+	if (npLD > 0) {						// the worker owns a copy of the user profile tables, freed by its destructor
+		worker->npLD = npLD;
+		worker->LDtab = (double*)malloc(sizeof(double) * (npLD + 1));
+		worker->rCLDtab = (double*)malloc(sizeof(double) * (npLD + 1));
+		memcpy(worker->LDtab, LDtab, sizeof(double) * (npLD + 1));
+		memcpy(worker->rCLDtab, rCLDtab, sizeof(double) * (npLD + 1));
+	}
+	if (!ESPLoff) {						// the ESPL tables are shared, not copied
+		worker->ESPLin = ESPLin;
+		worker->ESPLout = ESPLout;
+		worker->ESPLinastro = ESPLinastro;
+		worker->ESPLoutastro = ESPLoutastro;
+		worker->ESPLoff = false;
+	}
+	worker->SelectedMethod = SelectedMethod;
+	if (!ws->geom_q.empty()) worker->SetLensGeometry((int)ws->geom_q.size(), ws->geom_q.data(), ws->geom_s.data());
+}
+
+void VBMicrolensing::MultiMagMap(double RSv, double x_min, double x_max, double y_min, double y_max, int nx, int ny, double* mags, double* costs, int nthreads) {
+	if (ws->geom_q.empty()) {
+		printf("\nMultiMagMap: call SetLensGeometry first");
+		return;
+	}
+	int ntx = (nx + _Map_tile - 1) / _Map_tile;
+	int nty = (ny + _Map_tile - 1) / _Map_tile;
+	int ntiles = ntx * nty;
+	double dx = (x_max - x_min) / (double)nx;
+	double dy = (y_max - y_min) / (double)ny;
+
+	if (nthreads <= 0) nthreads = (int)std::thread::hardware_concurrency();
+	if (nthreads > ntiles) nthreads = ntiles;
+	if (nthreads < 1) nthreads = 1;
+
+	// tiles are numbered row by row, so that the contiguous range initially owned by each thread is a compact band of the map
+	_work_stealing_chunks tiles(nthreads, ntiles);
+
+	auto work = [&](int id) {
+		std::unique_ptr<VBMicrolensing> worker(new VBMicrolensing);
+		CopySettingsTo(worker.get());
+		int t;
+		while ((t = tiles.next(id)) >= 0) {
+			// every tile starts from a freshly set geometry, whichever thread takes it and whatever it computed before
+			worker->SetLensGeometry((int)ws->geom_q.size(), ws->geom_q.data(), ws->geom_s.data());
+			worker->ws->reset_seeds();
+			int ix0 = (t % ntx) * _Map_tile, iy0 = (t / ntx) * _Map_tile;
+			int ix1 = ix0 + _Map_tile < nx ? ix0 + _Map_tile : nx;
+			int iy1 = iy0 + _Map_tile < ny ? iy0 + _Map_tile : ny;
+			for (int iy = iy0; iy < iy1; iy++) {
+				double y_current = y_min + iy * dy;
+				// rows are scanned back and forth, so that each pixel starts from the roots of an adjacent one
+				int forward = ((iy - iy0) % 2 == 0);
+				for (int k = ix0; k < ix1; k++) {
+					int ix = forward ? k : ix0 + ix1 - 1 - k;
+					int ipix = iy * nx + ix;
+					auto begin = std::chrono::steady_clock::now();
+					mags[ipix] = worker->MultiMag(complex(x_min + ix * dx, y_current), RSv);
+					if (costs) costs[ipix] = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int id = 1; id < nthreads; id++) threads.emplace_back(work, id);
+	work(0);
+	for (auto& t : threads) t.join();
+}
+/*******************************************   end   *******************************************/
+
 
 
 ///////////////////////////////////////////////
@@ -3654,8 +5724,12 @@ double VBMicrolensing::MultiMag(double y1, double y2, double RSv) {
 	/*******************************************   end   *******************************************/
 
 void VBMicrolensing::initroot() {
-	static complex fac, fac2, z, S2;
-	static double Jac;
+	/******************************************* changed *******************************************/
+	complex fac, fac2, z, S2;
+	double Jac;
+	//static complex fac, fac2, z, S2;
+	//static double Jac;
+	/*******************************************   end   *******************************************/
 
 	// Main image, should be positive and close to source
 	init[n] = y;
@@ -3690,9 +5764,14 @@ void VBMicrolensing::initroot() {
 }
 
 int VBMicrolensing::froot(complex zi) {
-	static complex z, zc, S1, S2, S2v, S3, zo, zo2, epso, epsbase, epsn, epsl, gradL, zl, fac, fac2, dz, dzo, TJold, TJnew, Lv, den;
-	static int iter3, iter4, ipseudo, flagmain, flag;
-	static double Lnew, Lold, fad, Jac, Jacold, prefac, epsbo;
+	/******************************************* changed *******************************************/
+	complex z, zc, S1, S2, S2v, S3, zo, zo2, epso, epsbase, epsn, epsl, gradL, zl, fac, fac2, dz, dzo, TJold, TJnew, Lv, den;
+	int iter3, iter4, ipseudo, flagmain, flag;
+	double Lnew, Lold, fad, Jac, Jacold, prefac, epsbo;
+	//static complex z, zc, S1, S2, S2v, S3, zo, zo2, epso, epsbase, epsn, epsl, gradL, zl, fac, fac2, dz, dzo, TJold, TJnew, Lv, den;
+	//static int iter3, iter4, ipseudo, flagmain, flag;
+	//static double Lnew, Lold, fad, Jac, Jacold, prefac, epsbo;
+	/*******************************************   end   *******************************************/
 
 	Lold = 100.;
 	epso = 1.e100;
@@ -3855,6 +5934,11 @@ int VBMicrolensing::froot(complex zi) {
 		iter++;
 	}
 	newtonstep += iter;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	stats.laguerre_iterations += iter;
+#endif
+	/*******************************************   end   *******************************************/
 	err = 3.163e-15 / Jac;
 	err *= err;
 	err += abs2(epsbase);
@@ -3866,10 +5950,16 @@ int VBMicrolensing::froot(complex zi) {
 }
 
 bool VBMicrolensing::checkroot(_theta * theta) {
-	static double mn, fac;
-	static int imn;
-	static complex S3, z, S4;
-	static double fad;
+	/******************************************* changed *******************************************/
+	double mn, fac;
+	int imn;
+	complex S3, z, S4;
+	double fad;
+	//static double mn, fac;
+	//static int imn;
+	//static complex S3, z, S4;
+	//static double fad;
+	/*******************************************   end   *******************************************/
 	if ((iter2 < 9 && iter < maxiter) || L0f < 1.e-29) {
 		mn = 1.e100;
 		imn = 0;
@@ -3915,13 +6005,27 @@ bool VBMicrolensing::checkroot(_theta * theta) {
 
 
 _curve* VBMicrolensing::NewImages(_theta * theta) {
-	static _curve* Prov;
-	static int nminus, nplus;
-	static complex z, zc, dy, dz, J2, J3, Jalt, JJalt2, Jaltc, J1c2;
-	static complex S2, S2c, S3, S3c, vec, newseed0;
-	static double ob2, dJ2, cq, Jac, imul, phi;
-	static complex newseedtrial[6] = { complex(1,0.5),complex(1,-0.5), 0.5, 0.75, 2., 4., };
-	static int imass, iphi, nsafe;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	stats.NewImages_calls++;
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	_curve* Prov;
+	int nminus, nplus;
+	complex z, zc, dy, dz, J2, J3, Jalt, JJalt2, Jaltc, J1c2;
+	complex S2, S2c, S3, S3c, vec, newseed0;
+	double ob2, dJ2, cq, Jac, imul, phi;
+	complex newseedtrial[6] = { complex(1,0.5),complex(1,-0.5), 0.5, 0.75, 2., 4., };
+	int imass, iphi, nsafe;
+	//static _curve* Prov;
+	//static int nminus, nplus;
+	//static complex z, zc, dy, dz, J2, J3, Jalt, JJalt2, Jaltc, J1c2;
+	//static complex S2, S2c, S3, S3c, vec, newseed0;
+	//static double ob2, dJ2, cq, Jac, imul, phi;
+	//static complex newseedtrial[6] = { complex(1,0.5),complex(1,-0.5), 0.5, 0.75, 2., 4., };
+	//static int imass, iphi, nsafe;
+	/*******************************************   end   *******************************************/
 
 	yc = conj(y);
 	initroot();
@@ -4042,9 +6146,14 @@ _curve* VBMicrolensing::NewImages(_theta * theta) {
 }
 
 void VBMicrolensing::initrootpoly() {
-	static double mrt;
-	static complex dev, dev2, zplus, shear, alpha0;
-	static int ir;
+	/******************************************* changed *******************************************/
+	double mrt;
+	complex dev, dev2, zplus, shear, alpha0;
+	int ir;
+	//static double mrt;
+	//static complex dev, dev2, zplus, shear, alpha0;
+	//static int ir;
+	/*******************************************   end   *******************************************/
 	zplus = y;
 	ir = nroots - 1;
 	for (int i = 0; i < n; i++) {
@@ -4080,9 +6189,14 @@ void VBMicrolensing::initrootpoly() {
 }
 
 int VBMicrolensing::findimagepoly(int i) {
-	static complex z, zc, yc, LL, zo, delta, lambda;
-	static double dlmax = 1.0e-12, LLold, Jold, deltafac;
-	static int iter, iter2, success;
+	/******************************************* changed *******************************************/
+	complex z, zc, yc, LL, zo, delta, lambda;
+	double dlmax = 1.0e-12, LLold, Jold, deltafac;
+	int iter, iter2, success;
+	//static complex z, zc, yc, LL, zo, delta, lambda;
+	//static double dlmax = 1.0e-12, LLold, Jold, deltafac;
+	//static int iter, iter2, success;
+	/*******************************************   end   *******************************************/
 	yc = conj(y);
 	z = zr[i];
 	zc = conj(z);
@@ -4123,15 +6237,31 @@ int VBMicrolensing::findimagepoly(int i) {
 	return success;
 }
 _curve* VBMicrolensing::NewImagespoly(_theta * theta) {
-	static complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
-	static double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
-	static int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
-	static double mi, tst, isgood;
-	static _curve* Prov;
-	static _point* scan, * prin, * fifth, * left, * right, * center;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	stats.NewImages_calls++;
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
+	double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
+	int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
+	double mi, tst, isgood;
+	_curve* Prov;
+	_point* scan, * prin, * fifth, * left, * right, * center;
+	//static complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
+	//static double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
+	//static int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
+	//static double mi, tst, isgood;
+	//static _curve* Prov;
+	//static _point* scan, * prin, * fifth, * left, * right, * center;
+	/*******************************************   end   *******************************************/
 
 #ifdef _PRINT_TIMES
-	static double tim0, tim1;
+	/******************************************* changed *******************************************/
+	double tim0, tim1;
+	//static double tim0, tim1;
+	/*******************************************   end   *******************************************/
 #endif
 
 	yc = conj(y);
@@ -4197,7 +6327,11 @@ _curve* VBMicrolensing::NewImagespoly(_theta * theta) {
 			}
 		Prov->last->theta = theta;
 	}
-	corrquad2 = 1.e200;
+	/******************************************* changed *******************************************/
+	// largest ghost image correction, as in BinaryMag2: the closest ghost pair decides (MultiMag2)
+	corrquad2 = 0;
+	//corrquad2 = 1.e200;
+	/*******************************************   end   *******************************************/
 	theta->errworst = 1.e100;
 	for (int i = ngood; i < n2 + 1; i++) {
 		z = zr[worst[i]];
@@ -4205,7 +6339,10 @@ _curve* VBMicrolensing::NewImagespoly(_theta * theta) {
 			zc = conj(z);
 			_MJacobians2
 				_MJacobians0bad
-				if (cq < corrquad2) corrquad2 = cq;
+				/******************************************* changed *******************************************/
+				if (cq > corrquad2) corrquad2 = cq;
+				//if (cq < corrquad2) corrquad2 = cq;
+				/*******************************************   end   *******************************************/
 		}
 		else {
 			for (int j = ngood; j < i; j++) { // Find the two ghost roots with minimum distance.
@@ -4221,15 +6358,31 @@ _curve* VBMicrolensing::NewImagespoly(_theta * theta) {
 }
 
 _curve* VBMicrolensing::NewImagesmultipoly(_theta * theta) {
-	static complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
-	static double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
-	static int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
-	static double mi, tst, isgood;
-	static _curve* Prov;
-	static _point* scan, * prin, * fifth, * left, * right, * center;
+	/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+	stats.NewImages_calls++;
+#endif
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
+	double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
+	int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
+	double mi, tst, isgood;
+	_curve* Prov;
+	_point* scan, * prin, * fifth, * left, * right, * center;
+	//static complex  yc, z, zc, zo, delta, dy, dz, J2, J3, Jalt, Jaltc, JJalt2, LL, J1c2, dzita;
+	//static double dlmax = 1.0e-12, dzmax = 1.e-10, dJ2, ob2, cq, Jold, LLold;
+	//static int ngood, nplus, nminus, bad, isso, ncrit, igood, iter, iter2;
+	//static double mi, tst, isgood;
+	//static _curve* Prov;
+	//static _point* scan, * prin, * fifth, * left, * right, * center;
+	/*******************************************   end   *******************************************/
 
 #ifdef _PRINT_TIMES
-	static double tim0, tim1;
+	/******************************************* changed *******************************************/
+	double tim0, tim1;
+	//static double tim0, tim1;
+	/*******************************************   end   *******************************************/
 #endif
 
 	yc = conj(y);
@@ -4288,7 +6441,11 @@ _curve* VBMicrolensing::NewImagesmultipoly(_theta * theta) {
 			}
 		Prov->last->theta = theta;
 	}
-	corrquad2 = 1.e200;
+	/******************************************* changed *******************************************/
+	// largest ghost image correction, as in BinaryMag2: the closest ghost pair decides (MultiMag2)
+	corrquad2 = 0;
+	//corrquad2 = 1.e200;
+	/*******************************************   end   *******************************************/
 	theta->errworst = 1.e100;
 	for (int i = ngood; i < n2 + 1; i++) {
 		z = zr[worst[i]];
@@ -4296,7 +6453,10 @@ _curve* VBMicrolensing::NewImagesmultipoly(_theta * theta) {
 			zc = conj(z);
 			_MJacobians2
 				_MJacobians0bad
-				if (cq < corrquad2) corrquad2 = cq;
+				/******************************************* changed *******************************************/
+				if (cq > corrquad2) corrquad2 = cq;
+				//if (cq < corrquad2) corrquad2 = cq;
+				/*******************************************   end   *******************************************/
 		}
 		else {
 			for (int j = ngood; j < i; j++) { // Find the two ghost roots with minimum distance.
@@ -4314,16 +6474,24 @@ _curve* VBMicrolensing::NewImagesmultipoly(_theta * theta) {
 /******************************************* changed *******************************************/
 void VBMicrolensing::OrderMultipleImages(_sols_for_skiplist_curve * Sols, _curve * Newpts) {
 //void VBMicrolensing::OrderMultipleImages(_sols * Sols, _curve * Newpts) {
-	static _point* scan, * scan2, * scan3, * isso[2];
-	static _skiplist_curve *scurve, *scurve2 ;
+	_point* scan, * scan2, * scan3, * isso[2] = { 0, 0 };
+	_skiplist_curve *scurve, *scurve2 ;
+	//static _point* scan, * scan2, * scan3, * isso[2];
+	//static _skiplist_curve *scurve, *scurve2 ;
 	//static _curve *scurve, *scurve2;
 
-	static std::minstd_rand engine{std::random_device{}()} ;
+	std::minstd_rand &engine = ws->engine ;		// per-instance level generator, no longer a static local
+	//static std::minstd_rand engine{std::random_device{}()} ;
 /*******************************************   end   *******************************************/
 
-	static _theta* theta;
-	static double th, mi, cmp, cmp2, cmp_2, er3, parab1, parab2;
-	static int nprec, npres, npres2, nfoll, issoc[2], ij;
+	/******************************************* changed *******************************************/
+	_theta* theta;
+	double th, mi, cmp, cmp2, cmp_2, er3, parab1, parab2;
+	int nprec, npres, npres2, nfoll, issoc[2] = { 0, 0 }, ij;
+	//static _theta* theta;
+	//static double th, mi, cmp, cmp2, cmp_2, er3, parab1, parab2;
+	//static int nprec, npres, npres2, nfoll, issoc[2], ij;
+	/*******************************************   end   *******************************************/
 
 	nprec = nfoll = 0;
 
@@ -5128,9 +7296,15 @@ void VBMicrolensing::PSPLLightCurveParallax(double* pr, double* ts, double* mags
 
 
 void VBMicrolensing::ESPLLightCurve(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double u0 = exp(pr[0]), t0 = pr[2], tE_inv = exp(-pr[1]), tn, u, rho = exp(pr[3]);
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - t0) * tE_inv;
 		u = sqrt(tn * tn + u0 * u0);
 
@@ -5142,11 +7316,17 @@ void VBMicrolensing::ESPLLightCurve(double* pr, double* ts, double* mags, double
 }
 
 void VBMicrolensing::ESPLLightCurveParallax(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double u0 = pr[0], t0 = pr[2], tE_inv = exp(-pr[1]), tn, u, u1, rho = exp(pr[3]), pai1 = pr[4], pai2 = pr[5];
 	double Et[2];
 	t0old = 0;
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		ComputeParallax(ts[i], t0, Et);
 		tn = (ts[i] - t0) * tE_inv + pai1 * Et[0] + pai2 * Et[1];
 		u1 = u0 + pai1 * Et[1] - pai2 * Et[0];
@@ -5161,12 +7341,20 @@ void VBMicrolensing::ESPLLightCurveParallax(double* pr, double* ts, double* mags
 
 
 void VBMicrolensing::BinaryLightCurve(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]);
 	double salpha = sin(pr[3]), calpha = cos(pr[3]);
 
 	//	_sols *Images; double Mag; // For debugging
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - pr[6]) * tE_inv;
 		y1s[i] = pr[2] * salpha - tn * calpha;
 		y2s[i] = -pr[2] * calpha - tn * salpha;
@@ -5181,10 +7369,42 @@ void VBMicrolensing::BinaryLightCurve(double* pr, double* ts, double* mags, doub
 	}
 }
 
+/******************************************* changed *******************************************/
+void VBMicrolensing::BinaryLightCurveGradient(double* pr, double* ts, double* mags, double* grads, double* y1s, double* y2s, int np) {
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]);
+	double salpha = sin(pr[3]), calpha = cos(pr[3]);
+	double g[5], *grad;
+
+	for (int i = 0; i < np; i++) {
+		tols.point(i);
+		tn = (ts[i] - pr[6]) * tE_inv;
+		y1s[i] = pr[2] * salpha - tn*calpha;
+		y2s[i] = -pr[2] * calpha - tn*salpha;
+		mags[i] = BinaryMag2Gradient(s, q, y1s[i], y2s[i], rho, g);
+		// chain rule from (s, q, y1, y2, rho) to the parameters (log_s, log_q, u0, alpha, log_rho, log_tE, t0)
+		grad = grads + 7 * i;
+		grad[0] = s * g[0];
+		grad[1] = q * g[1];
+		grad[2] = salpha * g[2] - calpha * g[3];
+		grad[3] = (pr[2] * calpha + tn * salpha) * g[2] + (pr[2] * salpha - tn * calpha) * g[3];
+		grad[4] = rho * g[4];
+		grad[5] = tn * (calpha * g[2] + salpha * g[3]);
+		grad[6] = tE_inv * (calpha * g[2] + salpha * g[3]);
+	}
+}
+/*******************************************   end   *******************************************/
+
 
 
 void VBMicrolensing::TripleLightCurve(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
-	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi;
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]);
+	//double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi;
+	/*******************************************   end   *******************************************/
 	double q[3] = { 1, exp(pr[1]),exp(pr[8]) };
 	complex s[3];
 	double salpha = sin(pr[3]), calpha = cos(pr[3]), sbeta = sin(pr[9]), cbeta = cos(pr[9]);
@@ -5198,27 +7418,37 @@ void VBMicrolensing::TripleLightCurve(double* pr, double* ts, double* mags, doub
 	SetLensGeometry(3, q, s);
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - pr[6]) * tE_inv;
 		y1s[i] = pr[2] * salpha - tn * calpha;
 		y2s[i] = -pr[2] * calpha - tn * salpha;
-		mindi = 1.e100;
-		for (int i = 0; i < n; i++) {
-			di = fabs(y1s[i] - s[i].re) + fabs(y2s[i] - s[i].im);
-			di /= sqrt(q[i]);
-			if (di < mindi) mindi = di;
-		}
-		if (mindi >= 10.) {
-
-			mags[i] = 1.;
-		}
-		else {
-			mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
-		}
+		/******************************************* changed *******************************************/
+		mags[i] = MultiMag2(complex(y1s[i], y2s[i]), rho);
+		//mindi = 1.e100;
+		//for (int i = 0; i < n; i++) {
+		//	di = fabs(y1s[i] - s[i].re) + fabs(y2s[i] - s[i].im);
+		//	di /= sqrt(q[i]);
+		//	if (di < mindi) mindi = di;
+		//}
+		//if (mindi >= 10.) {
+		//
+		//	mags[i] = 1.;
+		//}
+		//else {
+		//	mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
+		//}
+		/*******************************************   end   *******************************************/
 	}
 }
 
 void VBMicrolensing::TripleLightCurveParallax(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
-	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi, u, u0 = pr[2], t0 = pr[6], pai1 = pr[10], pai2 = pr[11];
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), u, u0 = pr[2], t0 = pr[6], pai1 = pr[10], pai2 = pr[11];
+	//double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi, u, u0 = pr[2], t0 = pr[6], pai1 = pr[10], pai2 = pr[11];
+	/*******************************************   end   *******************************************/
 	double q[3] = { 1, exp(pr[1]),exp(pr[8]) };
 	complex s[3];
 	double salpha = sin(pr[3]), calpha = cos(pr[3]), sbeta = sin(pr[9]), cbeta = cos(pr[9]);
@@ -5233,29 +7463,39 @@ void VBMicrolensing::TripleLightCurveParallax(double* pr, double* ts, double* ma
 	SetLensGeometry(3, q, s);
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		ComputeParallax(ts[i], t0, Et);
 		tn = (ts[i] - t0) * tE_inv + pai1 * Et[0] + pai2 * Et[1];
 		u = u0 + pai1 * Et[1] - pai2 * Et[0];
 		y1s[i] = u * salpha - tn * calpha;
 		y2s[i] = -u * calpha - tn * salpha;
-		mindi = 1.e100;
-		for (int i = 0; i < n; i++) {
-			di = fabs(y1s[i] - s[i].re) + fabs(y2s[i] - s[i].im);
-			di /= sqrt(q[i]);
-			if (di < mindi) mindi = di;
-		}
-		if (mindi >= 10.) {
-
-			mags[i] = 1.;
-		}
-		else {
-			mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
-		}
+		/******************************************* changed *******************************************/
+		mags[i] = MultiMag2(complex(y1s[i], y2s[i]), rho);
+		//mindi = 1.e100;
+		//for (int i = 0; i < n; i++) {
+		//	di = fabs(y1s[i] - s[i].re) + fabs(y2s[i] - s[i].im);
+		//	di /= sqrt(q[i]);
+		//	if (di < mindi) mindi = di;
+		//}
+		//if (mindi >= 10.) {
+		//
+		//	mags[i] = 1.;
+		//}
+		//else {
+		//	mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
+		//}
+		/*******************************************   end   *******************************************/
 	}
 }
 
 void VBMicrolensing::LightCurve(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np, int nl) {
-	double rho = exp(pr[2]), tn, tE_inv = exp(-pr[1]), di, mindi;
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	double rho = exp(pr[2]), tn, tE_inv = exp(-pr[1]);
+	//double rho = exp(pr[2]), tn, tE_inv = exp(-pr[1]), di, mindi;
+	/*******************************************   end   *******************************************/
 
 	double* q = (double*)malloc(sizeof(double) * (nl));
 	complex* s = (complex*)malloc(sizeof(complex) * (nl));
@@ -5277,28 +7517,112 @@ void VBMicrolensing::LightCurve(double* pr, double* ts, double* mags, double* y1
 	free(s);
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - pr[0]) * tE_inv;
 		y1s[i] = -tn;
 		y2s[i] = 0.;
-		mindi = 1.e100;
-		for (int i = 0; i < n; i++) {
-			di = fabs(y1s[i] - a[i].re) + fabs(y2s[i] - a[i].im);
-			di /= sqrt(m[i]);
-			if (di < mindi) mindi = di;
-		}
-		if (mindi >= 10.) {
+		/******************************************* changed *******************************************/
+		mags[i] = MultiMag2(complex(y1s[i], y2s[i]), rho);
+		//mindi = 1.e100;
+		//for (int i = 0; i < n; i++) {
+		//	di = fabs(y1s[i] - a[i].re) + fabs(y2s[i] - a[i].im);
+		//	di /= sqrt(m[i]);
+		//	if (di < mindi) mindi = di;
+		//}
+		//if (mindi >= 10.) {
+		//
+		//	mags[i] = 1.;
+		//}
+		//else {
+		//	mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
+		//}
+		/*******************************************   end   *******************************************/
+	}
+
+}
+
+/******************************************* changed *******************************************/
+// LightCurveChi2: weighted least squares fit of flux = Fs * mag + Fb on each dataset, from the magnifications in chi2.mags,
+// and chi square of the fit. The sums of the normal equations are taken in one pass over the points, the residuals in a second.
+// Points without a dataset or with err <= 0 (flagged) are left out, with residual 0.
+static double _flux_chi2(_chi2_arrays &chi2, double *flux, double *err, int *dataset, int ndatasets, int np, double *FsFb, double *residuals)
+{
+	double *sums, *fluxes, w, m, det, r, chisq = 0.;
 
-			mags[i] = 1.;
+	for (int i = 0; i < np; i++) {
+		if (dataset[i] < 0 || dataset[i] >= ndatasets || err[i] <= 0) continue;
+		sums = &chi2.sums[5 * dataset[i]];
+		w = 1. / (err[i] * err[i]);
+		m = chi2.mags[i];
+		sums[0] += w;
+		sums[1] += w * m;
+		sums[2] += w * m * m;
+		sums[3] += w * flux[i];
+		sums[4] += w * m * flux[i];
+	}
+	for (int k = 0; k < ndatasets; k++) {
+		sums = &chi2.sums[5 * k];
+		fluxes = &chi2.fluxes[2 * k];
+		det = sums[0] * sums[2] - sums[1] * sums[1];
+		if (det > 1.e-12 * sums[0] * sums[2]) {
+			fluxes[0] = (sums[0] * sums[4] - sums[1] * sums[3]) / det;
+			fluxes[1] = (sums[2] * sums[3] - sums[1] * sums[4]) / det;
+		}
+		else if (sums[2] > 0) {		// constant magnification: Fs and Fb are degenerate, the blend is left out
+			fluxes[0] = sums[4] / sums[2];
+		}
+		if (FsFb) {
+			FsFb[2 * k] = fluxes[0];
+			FsFb[2 * k + 1] = fluxes[1];
 		}
-		else {
-			mags[i] = MultiMag(complex(y1s[i], y2s[i]), rho, Tol);
+	}
+	for (int i = 0; i < np; i++) {
+		if (dataset[i] < 0 || dataset[i] >= ndatasets || err[i] <= 0) {
+			if (residuals) residuals[i] = 0.;
+			continue;
 		}
+		fluxes = &chi2.fluxes[2 * dataset[i]];
+		r = (flux[i] - fluxes[0] * chi2.mags[i] - fluxes[1]) / err[i];
+		if (residuals) residuals[i] = r;
+		chisq += r * r;
 	}
+	return chisq;
+}
+
+double VBMicrolensing::LightCurveChi2(LightCurveFunction curve, double* pr, double* ts, double* flux, double* err, int* dataset, int ndatasets, int np, double* FsFb, double* residuals) {
+	_chi2_arrays &chi2 = ws->chi2;
+
+	chi2.resize(np, ndatasets);
+	(this->*curve)(pr, ts, chi2.mags.data(), chi2.y1s.data(), chi2.y2s.data(), np);
+	return _flux_chi2(chi2, flux, err, dataset, ndatasets, np, FsFb, residuals);
+}
+
+double VBMicrolensing::LightCurveChi2(SepLightCurveFunction curve, double* pr, double* ts, double* flux, double* err, int* dataset, int ndatasets, int np, double* FsFb, double* residuals) {
+	_chi2_arrays &chi2 = ws->chi2;
+
+	chi2.resize(np, ndatasets);
+	(this->*curve)(pr, ts, chi2.mags.data(), chi2.y1s.data(), chi2.y2s.data(), chi2.seps.data(), np);
+	return _flux_chi2(chi2, flux, err, dataset, ndatasets, np, FsFb, residuals);
+}
+
+double VBMicrolensing::LightCurveChi2(double* pr, double* ts, double* flux, double* err, int* dataset, int ndatasets, int np, int nl, double* FsFb, double* residuals) {
+	_chi2_arrays &chi2 = ws->chi2;
 
+	chi2.resize(np, ndatasets);
+	LightCurve(pr, ts, chi2.mags.data(), chi2.y1s.data(), chi2.y2s.data(), np, nl);
+	return _flux_chi2(chi2, flux, err, dataset, ndatasets, np, FsFb, residuals);
 }
+/*******************************************   end   *******************************************/
 
 
 void VBMicrolensing::BinaryLightCurveW(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), t0, u0;
 	double salpha = sin(pr[3]), calpha = cos(pr[3]), xc;
 
@@ -5308,6 +7632,9 @@ void VBMicrolensing::BinaryLightCurveW(double* pr, double* ts, double* mags, dou
 	u0 = pr[2] + xc * salpha;
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - t0) * tE_inv;
 		y1s[i] = u0 * salpha - tn * calpha;
 		y2s[i] = -u0 * calpha - tn * salpha;
@@ -5317,12 +7644,20 @@ void VBMicrolensing::BinaryLightCurveW(double* pr, double* ts, double* mags, dou
 
 
 void VBMicrolensing::BinaryLightCurveParallax(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), u0 = pr[2], rho = exp(pr[4]), tn, u, tE_inv = exp(-pr[5]), t0 = pr[6], pai1 = pr[7], pai2 = pr[8];
 	double salpha = sin(pr[3]), calpha = cos(pr[3]);
 	double Et[2];
 	t0old = 0;
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		ComputeParallax(ts[i], t0, Et);
 		tn = (ts[i] - t0) * tE_inv + pai1 * Et[0] + pai2 * Et[1];
 		u = u0 + pai1 * Et[1] - pai2 * Et[0];
@@ -5334,6 +7669,11 @@ void VBMicrolensing::BinaryLightCurveParallax(double* pr, double* ts, double* ma
 
 
 void VBMicrolensing::BinaryLightCurveOrbital(double* pr, double* ts, double* mags, double* y1s, double* y2s, double* seps, int np) {
+	/******************************************* changed *******************************************/
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), u0 = pr[2], rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), t0 = pr[6], pai1 = pr[7], pai2 = pr[8], w1 = pr[9], w2 = pr[10], w3 = pr[11];
 	double salpha = sin(pr[3]), calpha = cos(pr[3]);
 	double Et[2];
@@ -5365,6 +7705,9 @@ void VBMicrolensing::BinaryLightCurveOrbital(double* pr, double* ts, double* mag
 	SOm = (Cphi0 * salpha - Cinc * calpha * Sphi0) / den0;
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		ComputeParallax(ts[i], t0, Et);
 
 		phi = (ts[i] - t0_par) * w + phi0;
@@ -5382,6 +7725,11 @@ void VBMicrolensing::BinaryLightCurveOrbital(double* pr, double* ts, double* mag
 }
 
 void VBMicrolensing::BinaryLightCurveKepler(double* pr, double* ts, double* mags, double* y1s, double* y2s, double* seps, int np) {
+	/******************************************* changed *******************************************/
+	_warm_start_scope warm(ws, warmstart);		// see warmstart
+	_frozen_sampling_scope frozen(ws);			// see RecordSampling
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), u0 = pr[2], alpha = pr[3], rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), t0 = pr[6], pai1 = pr[7], pai2 = pr[8], w1 = pr[9], w2 = pr[10], w3 = pr[11], szs = pr[12], ar = pr[13] + 1.e-8;
 	double Et[2];
 	double u, w22, w11, w33, w12, w23, szs2, ar2, EE, dE;
@@ -5444,6 +7792,9 @@ void VBMicrolensing::BinaryLightCurveKepler(double* pr, double* ts, double* mags
 		//coY1 = -(-1 + 2 * ar)*w2*(w1 + szs * w3);
 		//coY2 = w2 * (-szs2 * w12 + 2 * szs*w1*w3 - w23 + ar * (-4 * szs*w1*w3 + szs2 * (w12 - w33) + (-w11 + w23)));
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		ComputeParallax(ts[i], t0, Et);
 		M = n * (ts[i] - tperi);
 		EE = M + e * sin(M);
@@ -5591,9 +7942,15 @@ void VBMicrolensing::BinSourceLightCurveXallarap(double* pr, double* ts, double*
 }
 
 void VBMicrolensing::BinSourceExtLightCurve(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double u1 = pr[2], u2 = pr[3], t01 = pr[4], t02 = pr[5], tE_inv = exp(-pr[0]), FR = exp(pr[1]), rho = exp(pr[6]), rho2, tn, u;
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 		tn = (ts[i] - t01) * tE_inv;
 		u = tn * tn + u1 * u1;
 
@@ -5612,6 +7969,9 @@ void VBMicrolensing::BinSourceExtLightCurve(double* pr, double* ts, double* mags
 }
 
 void VBMicrolensing::BinSourceBinLensXallarap(double* pr, double* ts, double* mags, double* y1s, double* y2s, int np) {
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), u0;
 	double salpha = sin(pr[3]), calpha = cos(pr[3]), xi1 = pr[7], xi2 = pr[8], omega = pr[9], inc = pr[10], phi = pr[11], qs = exp(pr[12]);
 
@@ -5624,6 +7984,9 @@ void VBMicrolensing::BinSourceBinLensXallarap(double* pr, double* ts, double* ma
 
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 
 		phit = omega * (ts[i] - t0_par);
 
@@ -5657,6 +8020,9 @@ void VBMicrolensing::BinSourceBinLensXallarap(double* pr, double* ts, double* ma
 }
 
 void VBMicrolensing::BinSourceSingleLensXallarap(double* pr, double* ts, double* mags, double* y1s, double* y2s, double* y1s2, double* y2s2, int np) {
+	/******************************************* changed *******************************************/
+	_point_tolerance_scope tols(Tol, ws->point_tols);	// see SetPointTolerances
+	/*******************************************   end   *******************************************/
 	double  t0 = pr[1], rho = exp(pr[3]), tn, tE_inv = exp(-pr[2]), u0;
 	double  xi1 = pr[4], xi2 = pr[5], omega = pr[6], inc = pr[7], phi = pr[8], qs = exp(pr[9]);
 
@@ -5669,6 +8035,9 @@ void VBMicrolensing::BinSourceSingleLensXallarap(double* pr, double* ts, double*
 
 
 	for (int i = 0; i < np; i++) {
+		/******************************************* changed *******************************************/
+		tols.point(i);
+		/*******************************************   end   *******************************************/
 
 		phit = omega * (ts[i] - t0_par);
 
@@ -5783,11 +8152,21 @@ double VBMicrolensing::BinaryLightCurve(double* pr, double t) {
 }
 
 double VBMicrolensing::TripleLightCurve(double* pr, double t) {
-	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi;
-	static double q[3];
-	static double prold[] = { 0,0,0,0,0 };
-	static Method oldmethod = Method::Nopoly;
-	static complex s[3];
+	/******************************************* changed *******************************************/
+	double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]);
+	//double rho = exp(pr[4]), tn, tE_inv = exp(-pr[5]), di, mindi;
+	/*******************************************   end   *******************************************/
+	/******************************************* changed *******************************************/
+	// lens geometry cached on the parameters in the per-instance workspace
+	double *q = ws->tlc_q;
+	double *prold = ws->tlc_prold;
+	Method &oldmethod = ws->tlc_oldmethod;
+	complex *s = ws->tlc_s;
+	//static double q[3];
+	//static double prold[] = { 0,0,0,0,0 };
+	//static Method oldmethod = Method::Nopoly;
+	//static complex s[3];
+	/*******************************************   end   *******************************************/
 	double salpha = sin(pr[3]), calpha = cos(pr[3]), sbeta = sin(pr[9]), cbeta = cos(pr[9]);
 	int inew = 0;
 	bool changed = false;
@@ -5817,19 +8196,22 @@ double VBMicrolensing::TripleLightCurve(double* pr, double t) {
 	y_1 = pr[2] * salpha - tn * calpha;
 	y_2 = -pr[2] * calpha - tn * salpha;
 
-	mindi = 1.e100;
-	for (int i = 0; i < n; i++) {
-		di = fabs(y_1 - s[i].re) + fabs(y_2 - s[i].im);
-		di /= sqrt(q[i]);
-		if (di < mindi) mindi = di;
-	}
-	if (mindi >= 10.) {
-
-		return 1.;
-	}
-	else {
-		return MultiMag(complex(y_1, y_2), rho, Tol);
-	}
+	/******************************************* changed *******************************************/
+	return MultiMag2(complex(y_1, y_2), rho);
+	//mindi = 1.e100;
+	//for (int i = 0; i < n; i++) {
+	//	di = fabs(y_1 - s[i].re) + fabs(y_2 - s[i].im);
+	//	di /= sqrt(q[i]);
+	//	if (di < mindi) mindi = di;
+	//}
+	//if (mindi >= 10.) {
+	//
+	//	return 1.;
+	//}
+	//else {
+	//	return MultiMag(complex(y_1, y_2), rho, Tol);
+	//}
+	/*******************************************   end   *******************************************/
 }
 
 double VBMicrolensing::BinaryLightCurveW(double* pr, double t) {
@@ -6311,8 +8693,12 @@ double VBMicrolensing::BinSourceBinLensPOX(double* pr, double t) {
 
 
 double VBMicrolensing::LDprofile(double r) {
-	static int ir;
-	static double rr, ret;
+	/******************************************* changed *******************************************/
+	int ir;
+	double rr, ret = 0;
+	//static int ir;
+	//static double rr, ret;
+	/*******************************************   end   *******************************************/
 	switch (curLDprofile) {
 	case LDuser:
 		rr = r * npLD;
@@ -6336,8 +8722,12 @@ double VBMicrolensing::LDprofile(double r) {
 }
 
 double VBMicrolensing::rCLDprofile(double tc, annulus* left, annulus* right) {
-	static int ic;
-	static double rc, cb, lc, r2, cr2, cc, lb, rb;
+	/******************************************* changed *******************************************/
+	int ic;
+	double rc, cb = 0, lc, r2, cr2, cc, lb, rb;
+	//static int ic;
+	//static double rc, cb, lc, r2, cr2, cc, lb, rb;
+	/*******************************************   end   *******************************************/
 
 	switch (curLDprofile) {
 	case LDuser:
@@ -6658,15 +9048,27 @@ void VBMicrolensing::SetObjectCoordinates(char* CoordinateString) {
 }
 
 void VBMicrolensing::ComputeParallax(double t, double t0, double* Et) {
-	static double a0 = 1.00000261, adot = 0.00000562; // Ephemeris from JPL website 
-	static double e0 = 0.01671123, edot = -0.00004392;
-	static double inc0 = -0.00001531, incdot = -0.01294668;
-	static double L0 = 100.46457166, Ldot = 35999.37244981;
-	static double om0 = 102.93768193, omdot = 0.32327364;
-	static double deg = M_PI / 180;
-	static double a, e, inc, L, om, M, EE, dE, dM;
-	static double x1, y1, vx, vy, Ear[3], vEar[3];
-	static double Et0[2], vt0[2], r, sp, ty, Spit;
+	/******************************************* changed *******************************************/
+	// no static locals, so that the function is reentrant. Et0 and vt0 are now class members cached on t0old
+	const double a0 = 1.00000261, adot = 0.00000562; // Ephemeris from JPL website 
+	const double e0 = 0.01671123, edot = -0.00004392;
+	const double inc0 = -0.00001531, incdot = -0.01294668;
+	const double L0 = 100.46457166, Ldot = 35999.37244981;
+	const double om0 = 102.93768193, omdot = 0.32327364;
+	const double deg = M_PI / 180;
+	double a, e, inc, L, om, M, EE, dE, dM;
+	double x1, y1, vx, vy, Ear[3], vEar[3];
+	double r, sp, ty, Spit;
+	//static double a0 = 1.00000261, adot = 0.00000562; // Ephemeris from JPL website 
+	//static double e0 = 0.01671123, edot = -0.00004392;
+	//static double inc0 = -0.00001531, incdot = -0.01294668;
+	//static double L0 = 100.46457166, Ldot = 35999.37244981;
+	//static double om0 = 102.93768193, omdot = 0.32327364;
+	//static double deg = M_PI / 180;
+	//static double a, e, inc, L, om, M, EE, dE, dM;
+	//static double x1, y1, vx, vy, Ear[3], vEar[3];
+	//static double Et0[2], vt0[2], r, sp, ty, Spit;
+	/*******************************************   end   *******************************************/
 	int c = 0, ic;
 
 	if (t0_par_fixed == 0) t0_par = t0;
@@ -7421,8 +9823,12 @@ void VBMicrolensing::change_n_mp(int nn) {
 }
 
 void VBMicrolensing::polycritcoefficients(complex eiphi) {
-	static int dg;
-	static complex pbin[3];
+	/******************************************* changed *******************************************/
+	int dg;
+	complex pbin[3];
+	//static int dg;
+	//static complex pbin[3];
+	/*******************************************   end   *******************************************/
 
 	for (int i = 0; i < n; i++) {
 		pmza2[i][0] = m[i];
@@ -7460,8 +9866,12 @@ void VBMicrolensing::polycritcoefficients(complex eiphi) {
 
 void VBMicrolensing::polycoefficients() {
 
-	static int dg;
-	static complex pbin[2], lam;
+	/******************************************* changed *******************************************/
+	int dg;
+	complex pbin[2], lam;
+	//static int dg;
+	//static complex pbin[2], lam;
+	/*******************************************   end   *******************************************/
 
 
 	for (int k = 0; k < n; k++) {
@@ -7520,8 +9930,12 @@ void VBMicrolensing::polycoefficients() {
 
 void VBMicrolensing::polycoefficients_multipoly() {
 
-	static int dg;
-	static complex pbin[2], lam;
+	/******************************************* changed *******************************************/
+	int dg;
+	complex pbin[2], lam;
+	//static int dg;
+	//static complex pbin[2], lam;
+	/*******************************************   end   *******************************************/
 
 	for (int l = 0; l < n; l++) {
 		for (int i = 0; i < nnm1 + 1; i++) {
@@ -7620,10 +10034,16 @@ void VBMicrolensing::cmplx_roots_gen(complex* roots, complex* poly, int degree,
 	//very rough idea where some of the roots can be.
 	//
 
-	static complex poly2[MAXM];
-	static int i, j, n, iter;
-	static bool success;
-	static complex coef, prev;
+	/******************************************* changed *******************************************/
+	complex poly2[MAXM];
+	int i, j, n, iter;
+	bool success;
+	complex coef, prev;
+	//static complex poly2[MAXM];
+	//static int i, j, n, iter;
+	//static bool success;
+	//static complex coef, prev;
+	/*******************************************   end   *******************************************/
 
 	if (!use_roots_as_starting_points) {
 		for (int jj = 0; jj < degree; jj++) {
@@ -7641,9 +10061,24 @@ void VBMicrolensing::cmplx_roots_gen(complex* roots, complex* poly, int degree,
 
 	for (n = degree; n >= 3; n--) {
 		cmplx_laguerre2newton(poly2, n, &roots[n - 1], iter, success, 2);
+		/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+		stats.laguerre_iterations += iter;
+#endif
+		/*******************************************   end   *******************************************/
 		if (!success) {
 			roots[n - 1] = complex(0, 0);
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.laguerre_iterations -= iter;	// cmplx_laguerre goes on counting from iter
+#endif
+			/*******************************************   end   *******************************************/
 			cmplx_laguerre(poly2, n, &roots[n - 1], iter, success);
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.laguerre_iterations += iter;
+#endif
+			/*******************************************   end   *******************************************/
 		}
 
 		// Divide by root
@@ -7674,6 +10109,11 @@ void VBMicrolensing::cmplx_roots_gen(complex* roots, complex* poly, int degree,
 		for (n = 0; n < degree-1; n++) {
 		/*******************************************   end   *******************************************/
 			cmplx_newton_spec(poly, degree, &roots[n], iter, success); // Polish roots with full polynomial
+			/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+			stats.polish_iterations += iter;
+#endif
+			/*******************************************   end   *******************************************/
 		}
 	}
 
@@ -7682,11 +10122,18 @@ void VBMicrolensing::cmplx_roots_gen(complex* roots, complex* poly, int degree,
 
 void VBMicrolensing::cmplx_roots_multigen(complex* roots, complex** poly, int degree, bool polish_roots_after, bool use_roots_as_starting_points) {
 
-	static complex poly2[MAXM];
-	static int l, j, i, k, nl, ind, degreenew, croots, n;
-	static double dif0, br;
-	static bool success;
-	static complex coef, prev, przr;
+	/******************************************* changed *******************************************/
+	complex poly2[MAXM];
+	int l, j, i, k, nl, ind, degreenew, croots, n;
+	double dif0, br;
+	bool success;
+	complex coef, prev, przr;
+	//static complex poly2[MAXM];
+	//static int l, j, i, k, nl, ind, degreenew, croots, n;
+	//static double dif0, br;
+	//static bool success;
+	//static complex coef, prev, przr;
+	/*******************************************   end   *******************************************/
 
 
 	nl = sqrt(degree - 1);
@@ -7712,9 +10159,24 @@ void VBMicrolensing::cmplx_roots_multigen(complex* roots, complex** poly, int de
 			//Do Laguerre for degree >=3
 			for (n = degree; n >= 3; n--) {
 				cmplx_laguerre2newton(poly2, n, &zr_mp[l][n - 1], iter, success, 2);
+				/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+				stats.laguerre_iterations += iter;
+#endif
+				/*******************************************   end   *******************************************/
 				if (!success) {
 					zr_mp[l][n - 1] = complex(0, 0);
+					/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+					stats.laguerre_iterations -= iter;	// cmplx_laguerre goes on counting from iter
+#endif
+					/*******************************************   end   *******************************************/
 					cmplx_laguerre(poly2, n, &zr_mp[l][n - 1], iter, success);
+					/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+					stats.laguerre_iterations += iter;
+#endif
+					/*******************************************   end   *******************************************/
 				}
 				nrootsmp_mp[l]++;
 				//distance check
@@ -7797,9 +10259,24 @@ void VBMicrolensing::cmplx_roots_multigen(complex* roots, complex** poly, int de
 
 			for (n = degreenew; n >= 3; n--) {
 				cmplx_laguerre2newton(poly2, n, &zr_mp[l][n - 1], iter, success, 2);
+				/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+				stats.laguerre_iterations += iter;
+#endif
+				/*******************************************   end   *******************************************/
 				if (!success) {
 					zr_mp[l][n - 1] = complex(0, 0);
+					/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+					stats.laguerre_iterations -= iter;	// cmplx_laguerre goes on counting from iter
+#endif
+					/*******************************************   end   *******************************************/
 					cmplx_laguerre(poly2, n, &zr_mp[l][n - 1], iter, success);
+					/******************************************* changed *******************************************/
+#ifdef _HOTPATH_STATS
+					stats.laguerre_iterations += iter;
+#endif
+					/*******************************************   end   *******************************************/
 				}
 				nrootsmp_mp[l] += 1;
 
@@ -7833,7 +10310,10 @@ void VBMicrolensing::cmplx_roots_multigen(complex* roots, complex** poly, int de
 }
 
 void VBMicrolensing::solve_quadratic_eq(complex& x0, complex& x1, complex* poly) {
-	static complex a, b, c, b2, delta;
+	/******************************************* changed *******************************************/
+	complex a, b, c, b2, delta;
+	//static complex a, b, c, b2, delta;
+	/*******************************************   end   *******************************************/
 	a = poly[2];
 	b = poly[1];
 	c = poly[0];
@@ -7862,16 +10342,29 @@ void VBMicrolensing::solve_cubic_eq(complex& x0, complex& x1, complex& x2, compl
 	// poly is an array of polynomial cooefs, length = degree+1, poly[0] is constant
 	//	0				1				2			3
 	//poly[0] x^0 + poly[1] x^1 + poly[2] x^2 + poly[3] x^3
-	static complex zeta = complex(-0.5, 0.8660254037844386);
-	static complex zeta2 = complex(-0.5, -0.8660254037844386);
-	static double third = 0.3333333333333333;
-	static complex s0, s1, s2;
-	static complex E1; //x0+x1+x2
-	static complex E2; //x0*x1+x1*x2+x2*x0
-	static complex E3; //x0*x1*x2
-	static complex A, B, a_1, E12, delta, A2;
-
-	static complex val, x;
+	/******************************************* changed *******************************************/
+	complex zeta = complex(-0.5, 0.8660254037844386);
+	complex zeta2 = complex(-0.5, -0.8660254037844386);
+	double third = 0.3333333333333333;
+	complex s0, s1, s2;
+	complex E1; //x0+x1+x2
+	complex E2; //x0*x1+x1*x2+x2*x0
+	complex E3; //x0*x1*x2
+	complex A, B, a_1, E12, delta, A2;
+	//static complex zeta = complex(-0.5, 0.8660254037844386);
+	//static complex zeta2 = complex(-0.5, -0.8660254037844386);
+	//static double third = 0.3333333333333333;
+	//static complex s0, s1, s2;
+	//static complex E1; //x0+x1+x2
+	//static complex E2; //x0*x1+x1*x2+x2*x0
+	//static complex E3; //x0*x1*x2
+	//static complex A, B, a_1, E12, delta, A2;
+	/*******************************************   end   *******************************************/
+
+	/******************************************* changed *******************************************/
+	complex val, x;
+	//static complex val, x;
+	/*******************************************   end   *******************************************/
 	a_1 = 1 / poly[3];
 	E1 = -poly[2] * a_1;
 	E2 = poly[1] * a_1;
@@ -7933,25 +10426,48 @@ void VBMicrolensing::cmplx_laguerre(complex* poly, int degree, complex* root, in
 	//For a summary of the method go to :
 	//http://en.wikipedia.org/wiki/Laguerre's_method
 	//
-	static int FRAC_JUMP_EVERY = 10;
+	/******************************************* changed *******************************************/
+	int FRAC_JUMP_EVERY = 10;
+	//static int FRAC_JUMP_EVERY = 10;
+	/*******************************************   end   *******************************************/
 	const int FRAC_JUMP_LEN = 10;
-	static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297,
+	/******************************************* changed *******************************************/
+	double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297,
 		0.91577881, 0.25921289, 0.50487203,
 		0.08177045, 0.13653241, 0.306162,
 		0.37794326, 0.04618805, 0.75132137 }; // some random numbers
+	//static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297,
+//		0.91577881, 0.25921289, 0.50487203,
+//		0.08177045, 0.13653241, 0.306162,
+//		0.37794326, 0.04618805, 0.75132137 }; // some random numbers
+	/*******************************************   end   *******************************************/
 
-	static double faq; //jump length
-	static double FRAC_ERR = 2.0e-15; //Fractional Error for double precision
-	static complex p, dp, d2p_half; //value of polynomial, 1st derivative, and 2nd derivative
-	static int i, j, k;
-	static bool good_to_go;
-	static complex denom, denom_sqrt, dx, newroot;
-	static double ek, absroot, abs2p;
-	static complex fac_newton, fac_extra, F_half, c_one_nth;
-	static double one_nth, n_1_nth, two_n_div_n_1;
-	static complex c_one = complex(1, 0);
-	static complex zero = complex(0, 0);
-	static double stopping_crit2;
+	/******************************************* changed *******************************************/
+	double faq; //jump length
+	double FRAC_ERR = 2.0e-15; //Fractional Error for double precision
+	complex p, dp, d2p_half; //value of polynomial, 1st derivative, and 2nd derivative
+	int i, j, k;
+	bool good_to_go;
+	complex denom, denom_sqrt, dx, newroot;
+	double ek, absroot, abs2p;
+	complex fac_newton, fac_extra, F_half, c_one_nth;
+	double one_nth, n_1_nth, two_n_div_n_1;
+	complex c_one = complex(1, 0);
+	complex zero = complex(0, 0);
+	double stopping_crit2;
+	//static double faq; //jump length
+	//static double FRAC_ERR = 2.0e-15; //Fractional Error for double precision
+	//static complex p, dp, d2p_half; //value of polynomial, 1st derivative, and 2nd derivative
+	//static int i, j, k;
+	//static bool good_to_go;
+	//static complex denom, denom_sqrt, dx, newroot;
+	//static double ek, absroot, abs2p;
+	//static complex fac_newton, fac_extra, F_half, c_one_nth;
+	//static double one_nth, n_1_nth, two_n_div_n_1;
+	//static complex c_one = complex(1, 0);
+	//static complex zero = complex(0, 0);
+	//static double stopping_crit2;
+	/*******************************************   end   *******************************************/
 
 	//--------------------------------------------------------------------------------------------
 
@@ -8093,19 +10609,35 @@ void VBMicrolensing::cmplx_newton_spec(complex* poly, int degree, complex* root,
 	//For a summary of the method go to: 
 	//http://en.wikipedia.org/wiki/Newton's_method
 
-	static int FRAC_JUMP_EVERY = 10;
+	/******************************************* changed *******************************************/
+	int FRAC_JUMP_EVERY = 10;
+	//static int FRAC_JUMP_EVERY = 10;
+	/*******************************************   end   *******************************************/
 	const int FRAC_JUMP_LEN = 10;
-	static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
-	static double faq; //jump length
-	static double FRAC_ERR = 2e-15;
-	static complex p; //value of polynomial
-	static complex dp; //value of 1st derivative
-	static int i, k;
-	static bool good_to_go;
-	static complex dx, newroot;
-	static double ek, absroot, abs2p;
-	static complex zero = complex(0, 0);
-	static double stopping_crit2;
+	/******************************************* changed *******************************************/
+	double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
+	double faq; //jump length
+	double FRAC_ERR = 2e-15;
+	complex p; //value of polynomial
+	complex dp; //value of 1st derivative
+	int i, k;
+	bool good_to_go;
+	complex dx, newroot;
+	double ek, absroot, abs2p;
+	complex zero = complex(0, 0);
+	double stopping_crit2;
+	//static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
+	//static double faq; //jump length
+	//static double FRAC_ERR = 2e-15;
+	//static complex p; //value of polynomial
+	//static complex dp; //value of 1st derivative
+	//static int i, k;
+	//static bool good_to_go;
+	//static complex dx, newroot;
+	//static double ek, absroot, abs2p;
+	//static complex zero = complex(0, 0);
+	//static double stopping_crit2;
+	/*******************************************   end   *******************************************/
 
 	iter = 0;
 	success = true;
@@ -8245,27 +10777,54 @@ void VBMicrolensing::cmplx_laguerre2newton(complex* poly, int degree, complex* r
 
 	//For a summary of the method see the paper: Skowron & Gould (2012)
 
-	static int FRAC_JUMP_EVERY = 10;
+	/******************************************* changed *******************************************/
+	int FRAC_JUMP_EVERY = 10;
+	//static int FRAC_JUMP_EVERY = 10;
+	/*******************************************   end   *******************************************/
 	const int FRAC_JUMP_LEN = 10;
-	static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
+	/******************************************* changed *******************************************/
+	double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
+	//static double FRAC_JUMPS[FRAC_JUMP_LEN] = { 0.64109297, 0.91577881, 0.25921289, 0.50487203, 0.08177045, 0.13653241, 0.306162, 0.37794326, 0.04618805, 0.75132137 }; //some random numbers
+	/*******************************************   end   *******************************************/
 
-	static double faq; //jump length
-	static double FRAC_ERR = 2.0e-15;
+	/******************************************* changed *******************************************/
+	double faq; //jump length
+	double FRAC_ERR = 2.0e-15;
+	//static double faq; //jump length
+	//static double FRAC_ERR = 2.0e-15;
+	/*******************************************   end   *******************************************/
 
-	static complex p; //value of polynomial
-	static complex dp; //value of 1st derivative
-	static complex d2p_half; //value of 2nd derivative
-	static int i, j, k;
-	static bool good_to_go;
+	/******************************************* changed *******************************************/
+	complex p; //value of polynomial
+	complex dp; //value of 1st derivative
+	complex d2p_half; //value of 2nd derivative
+	int i, j, k;
+	bool good_to_go;
+	//static complex p; //value of polynomial
+	//static complex dp; //value of 1st derivative
+	//static complex d2p_half; //value of 2nd derivative
+	//static int i, j, k;
+	//static bool good_to_go;
+	/*******************************************   end   *******************************************/
 	//complex G, H, G2;
-	static complex denom, denom_sqrt, dx, newroot;
-	static double ek, absroot, abs2p, abs2_F_half;
-	static complex fac_netwon, fac_extra, F_half, c_one_nth;
-	static double one_nth, n_1_nth, two_n_div_n_1;
-	static int mode;
-	static complex c_one = complex(1, 0);
-	static complex zero = complex(0, 0);
-	static double stopping_crit2;
+	/******************************************* changed *******************************************/
+	complex denom, denom_sqrt, dx, newroot;
+	double ek, absroot, abs2p, abs2_F_half;
+	complex fac_netwon, fac_extra, F_half, c_one_nth;
+	double one_nth, n_1_nth, two_n_div_n_1;
+	int mode;
+	complex c_one = complex(1, 0);
+	complex zero = complex(0, 0);
+	double stopping_crit2;
+	//static complex denom, denom_sqrt, dx, newroot;
+	//static double ek, absroot, abs2p, abs2_F_half;
+	//static complex fac_netwon, fac_extra, F_half, c_one_nth;
+	//static double one_nth, n_1_nth, two_n_div_n_1;
+	//static int mode;
+	//static complex c_one = complex(1, 0);
+	//static complex zero = complex(0, 0);
+	//static double stopping_crit2;
+	/*******************************************   end   *******************************************/
 
 	iter = 0;
 	success = true;
@@ -8591,13 +11150,24 @@ inline _point::_point(double x, double y, _theta *theta1) {
 }
 
 inline double _point::operator-(_point p2) {
-	static double dx1, dx2;
+	double dx1, dx2;
+	//static double dx1, dx2;
 	dx1 = x1 - p2.x1;
 	dx2 = x2 - p2.x2;
 	return dx1 * dx1 + dx2 * dx2;
 }
 /*******************************************   end   *******************************************/
 
+/******************************************* changed *******************************************/
+void * _point::operator new(size_t) {
+	return _object_pool<_point>::local().allocate() ;
+}
+
+void _point::operator delete(void * p) {
+	_object_pool<_point>::local().deallocate(p) ;
+}
+/*******************************************   end   *******************************************/
+
 
 
 
@@ -8607,6 +11177,16 @@ inline double _point::operator-(_point p2) {
 //////////////////////////////
 //////////////////////////////
 
+/******************************************* changed *******************************************/
+void * _curve::operator new(size_t) {
+	return _object_pool<_curve>::local().allocate() ;
+}
+
+void _curve::operator delete(void * p) {
+	_object_pool<_curve>::local().deallocate(p) ;
+}
+/*******************************************   end   *******************************************/
+
 _curve::_curve(void) {
 	length = 0;
 	first = last = 0;
@@ -8942,25 +11522,162 @@ void _sols::join(_sols* nc) {
 
 _theta::_theta(double th1) {
 	th = th1;
+	/******************************************* changed *******************************************/
+	index = -1;
+	/*******************************************   end   *******************************************/
+}
+
+/******************************************* changed *******************************************/
+void * _theta::operator new(size_t) {
+	return _object_pool<_theta>::local().allocate() ;
+}
+
+void _theta::operator delete(void * p) {
+	_object_pool<_theta>::local().deallocate(p) ;
 }
+/*******************************************   end   *******************************************/
 _thetas::_thetas(void) {
 	length = 0;
+	/******************************************* changed *******************************************/
+	first = last = 0;
+	nnodes = 0;
+	/*******************************************   end   *******************************************/
 }
 
+/******************************************* changed *******************************************/
 _thetas::~_thetas(void) {
-	_theta* scan, * scan2;
-	scan = first;
-	while (scan) {
-		scan2 = scan->next;
-		delete scan;
-		scan = scan2;
+	for (_theta *block : blocks) ::operator delete(block);	// _theta has a trivial destructor
+}
+//_thetas::~_thetas(void) {
+//	_theta* scan, * scan2;
+//	scan = first;
+//	while (scan) {
+//		scan2 = scan->next;
+//		delete scan;
+//		scan = scan2;
+//	}
+//}
+
+void _thetas::clear(void) {
+	// after an unusually long contour, give back what the next ones are unlikely to need, as the old heap did beyond 2048
+	while (blocks.size() > 2048 / _thetas_block) {
+		::operator delete(blocks.back());
+		blocks.pop_back();
+	}
+	if (heap.capacity() > 2048) {
+		heap.resize(2048);
+		err.resize(2048);
+		sumerr.resize(2048);
+		heap.shrink_to_fit();
+		err.shrink_to_fit();
+		sumerr.shrink_to_fit();
+	}
+	heap.clear();
+	err.clear();
+	sumerr.clear();
+	first = last = 0;
+	length = 0;
+	nnodes = 0;
+}
+
+_theta *_thetas::new_theta(double th) {
+	if (nnodes == (int)blocks.size() * _thetas_block) {
+		blocks.push_back(static_cast<_theta *>(::operator new(sizeof(_theta) * _thetas_block)));
 	}
+	_theta *theta = ::new (node(nnodes)) _theta(th);	// placement new, the class operator new is the object pool's
+	theta->index = nnodes++;
+	err.push_back(0.);
+	sumerr.push_back(0.);
+	return theta;
 }
 
+void _thetas::update_sums(int i) {
+	// from index i up to the root, each sum is recomputed from its children rather than incremented,
+	// so that errors which fall by orders of magnitude during a contour leave no rounding residue
+	// The total error is then equal to the incremental sums of the former _augmented_priority_queue up to rounding only,
+	// and so are the magnifications: a total error within rounding of the accuracy goal may stop the sampling one point
+	// earlier or later (none on grids over the three magnification ranges of the test drivers, which are bit-identical)
+	while (true) {
+		int left = 2 * i + 1;
+		double sum = err[i];
+		if (left < nnodes) {
+			sum += sumerr[left];
+			if (left + 1 < nnodes) sum += sumerr[left + 1];
+		}
+		sumerr[i] = sum;
+		if (i == 0) break;
+		i = (i - 1) / 2;
+	}
+}
+
+void _thetas::push_error(double maxerr, _theta *theta) {
+	heap_node node_to_push = {maxerr, theta->index};
+	int hole_index = heap.size();
+	int parent_index = (hole_index - 1) / 2;
+
+	heap.push_back(node_to_push);
+	while (hole_index > 0 && heap[parent_index].maxerr < node_to_push.maxerr) {
+		heap[hole_index] = heap[parent_index];
+		hole_index = parent_index;
+		parent_index = (hole_index - 1) / 2;
+	}
+	heap[hole_index] = node_to_push;
+
+	err[theta->index] = maxerr;
+	update_sums(theta->index);
+}
+
+void _thetas::pop_then_push_error(double maxerr, _theta *theta) {
+	heap_node node_to_push = {maxerr, theta->index};
+	int popped_index = heap[0].index;
+	int last_index = heap.size() - 1;
+	int hole_index = 0;
+
+	while (true) {
+		int max_child_index = 2 * hole_index + 1;
+		if (max_child_index > last_index) break;
+		if (max_child_index + 1 <= last_index && heap[max_child_index + 1].maxerr > heap[max_child_index].maxerr) max_child_index++;
+		if (node_to_push.maxerr >= heap[max_child_index].maxerr) break;
+		heap[hole_index] = heap[max_child_index];
+		hole_index = max_child_index;
+	}
+	heap[hole_index] = node_to_push;
+
+	if (popped_index != theta->index) {
+		err[popped_index] = 0.;
+		update_sums(popped_index);
+	}
+	err[theta->index] = maxerr;
+	update_sums(theta->index);
+}
+
+void _thetas::rebuild_errors(void) {
+	// every interval of the list enters the heap with its maxerr, and the sums are recomputed from the leaves
+	heap.clear();
+	for (int i = 0; i < nnodes; i++) err[i] = 0.;
+	for (_theta *scan = first; scan->next; scan = scan->next) {
+		heap.push_back({scan->maxerr, scan->index});
+		err[scan->index] = scan->maxerr;
+	}
+	std::make_heap(heap.begin(), heap.end(), [](const heap_node &a, const heap_node &b) { return a.maxerr < b.maxerr; });
+	for (int i = nnodes - 1; i >= 0; i--) {
+		int left = 2 * i + 1;
+		sumerr[i] = err[i];
+		if (left < nnodes) {
+			sumerr[i] += sumerr[left];
+			if (left + 1 < nnodes) sumerr[i] += sumerr[left + 1];
+		}
+	}
+}
+/*******************************************   end   *******************************************/
+
 _theta* _thetas::insert(double th) {
 	_theta* scan, * scan2;
 
-	scan2 = new _theta(th);
+	/******************************************* changed *******************************************/
+	scan2 = new_theta(th);
+	//scan2 = new _theta(th);
+	/*******************************************   end   *******************************************/
 	if (length) {
 		if (th < first->th) {
 			first->prev = scan2;
@@ -9001,7 +11718,8 @@ _theta * _thetas::insert_at_certain_position(_theta * itheta, double th)
 {
 	_theta *scan2;
 
-	scan2 = new _theta(th); // create an object of class _theta using 'new' keyword, 
+	scan2 = new_theta(th);	// taken from the storage of the list
+	//scan2 = new _theta(th); // create an object of class _theta using 'new' keyword, 
 	                        // memory of the object is allocated on heap and the pointer to that object is assigned to scan2, 
 							// constructor is called.
 							// (as the object is on heap, we can return it's pointer;
@@ -9021,20 +11739,30 @@ _theta * _thetas::insert_at_certain_position(_theta * itheta, double th)
 }
 /*******************************************   end   *******************************************/
 
+/******************************************* changed *******************************************/
 void _thetas::remove(_theta* stheta) {
-	_theta* scan;
-	scan = first;
-	while (scan != 0) {
-		if (scan == stheta) {
-			if (scan != first) scan->prev->next = stheta->next;
-			if (scan != last) scan->next->prev = stheta->prev;
-			delete stheta;
-			length--;
-			break;
-		}
-		scan = scan->next;
-	}
-}
+	// the slot of the element stays unused until clear(); the element must not be in the heap
+	if (stheta == first) first = stheta->next;
+	else stheta->prev->next = stheta->next;
+	if (stheta == last) last = stheta->prev;
+	else stheta->next->prev = stheta->prev;
+	length--;
+}
+//void _thetas::remove(_theta* stheta) {
+//	_theta* scan;
+//	scan = first;
+//	while (scan != 0) {
+//		if (scan == stheta) {
+//			if (scan != first) scan->prev->next = stheta->next;
+//			if (scan != last) scan->next->prev = stheta->prev;
+//			delete stheta;
+//			length--;
+//			break;
+//		}
+//		scan = scan->next;
+//	}
+//}
+/*******************************************   end   *******************************************/
 
 //////////////////////////////
 //////////////////////////////
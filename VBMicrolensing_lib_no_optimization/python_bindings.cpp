@@ -1,6 +1,19 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+/******************************************* changed *******************************************/
+#include <pybind11/numpy.h>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+// compile_all_VBMicrolensing.sh builds the module with -DVBM_ALGORITHMIC_LIBRARY against the algorithmic library,
+// which keeps the solver state per instance; without it the bindings use the library of this folder, as before
+#ifdef VBM_ALGORITHMIC_LIBRARY
+#include "../VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h"
+#else
 #include "VBMicrolensingLibrary.h"
+#endif
+//#include "VBMicrolensingLibrary.h"
+/*******************************************   end   *******************************************/
 #include <string>
 #include <pybind11/functional.h>
 
@@ -12,6 +25,151 @@ namespace py = pybind11;
 // Declaration of an instance to VBMicrolensing class. 
 VBMicrolensing VBM;
 
+/******************************************* changed *******************************************/
+// Zero-copy light curves (the ...Into functions): params and times are read in place from NumPy arrays
+// (a copy is made only if they are not C-contiguous float64), and the results are written straight into the
+// caller's mags, y1s, y2s (and seps) arrays, which must be writeable one-dimensional C-contiguous float64 arrays as long as times.
+// The GIL is released during the computation, and the computation holds the lock of its instance (see instance_lock),
+// so that two Python threads never drive the same instance at once.
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> input_array;
+typedef void (VBMicrolensing::*light_curve)(double *, double *, double *, double *, double *, int);
+typedef void (VBMicrolensing::*light_curve_sep)(double *, double *, double *, double *, double *, double *, int);
+
+// One lock per VBMicrolensing instance: computations on different instances run concurrently.
+// The lock of a deleted instance is kept and reused by the next instance created at the same address.
+// The library of this folder keeps its solver state in function-level statics shared by all the instances,
+// so there all the instances share a single lock.
+static std::mutex &instance_lock(VBMicrolensing &self)
+{
+#ifdef VBM_ALGORITHMIC_LIBRARY
+    static std::mutex registry_lock;
+    static std::unordered_map<const VBMicrolensing *, std::unique_ptr<std::mutex> > locks;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    std::unique_ptr<std::mutex> &lock = locks[&self];
+    if (!lock) lock.reset(new std::mutex);
+    return *lock;
+#else
+    static std::mutex shared_lock;
+    (void)self;
+    return shared_lock;
+#endif
+}
+
+static double *output_buffer(py::array &a, py::ssize_t np, const char *name)
+{
+    if (!py::array_t<double, py::array::c_style>::check_(a) || !a.writeable() || a.ndim() != 1)
+        throw py::value_error(std::string(name) + " must be a writeable one-dimensional C-contiguous float64 array");
+    if (a.size() != np)
+        throw py::value_error(std::string(name) + " must have the same length as times");
+    return (double *)a.mutable_data();
+}
+
+static void light_curve_into(VBMicrolensing &self, light_curve method, input_array params, input_array times,
+    py::array mags, py::array y1s, py::array y2s)
+{
+    py::ssize_t np = times.size();
+    double *pr = (double *)params.data(), *ts = (double *)times.data();
+    double *m = output_buffer(mags, np, "mags"), *y1 = output_buffer(y1s, np, "y1s"), *y2 = output_buffer(y2s, np, "y2s");
+
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> guard(instance_lock(self));
+    (self.*method)(pr, ts, m, y1, y2, (int)np);
+}
+
+static void light_curve_sep_into(VBMicrolensing &self, light_curve_sep method, input_array params, input_array times,
+    py::array mags, py::array y1s, py::array y2s, py::array seps)
+{
+    py::ssize_t np = times.size();
+    double *pr = (double *)params.data(), *ts = (double *)times.data();
+    double *m = output_buffer(mags, np, "mags"), *y1 = output_buffer(y1s, np, "y1s"), *y2 = output_buffer(y2s, np, "y2s");
+    double *sep = output_buffer(seps, np, "seps");
+
+    py::gil_scoped_release release;
+    std::lock_guard<std::mutex> guard(instance_lock(self));
+    (self.*method)(pr, ts, m, y1, y2, sep, (int)np);
+}
+
+#ifdef VBM_ALGORITHMIC_LIBRARY
+// LightCurveChi2 (algorithmic library only): the model is one of the light curves of wrapVBBL_LightCurveChi2, or LightCurve,
+// given by name. flux, err and dataset are read in place like params and times (dataset is converted to int32 if needed),
+// and must be as long as times; FsFb and the residuals are returned in new arrays. The GIL is released as in the ...Into functions.
+typedef py::array_t<int, py::array::c_style | py::array::forcecast> index_array;
+
+static void input_length(input_array &a, py::ssize_t np, const char *name)
+{
+    if (a.size() != np)
+        throw py::value_error(std::string(name) + " must have the same length as times");
+}
+
+static py::tuple light_curve_chi2(VBMicrolensing &self, const std::string &curve, input_array params, input_array times,
+    input_array flux, input_array err, index_array dataset, int ndatasets)
+{
+    static const std::unordered_map<std::string, light_curve> curves = {
+        {"PSPLLightCurve", &VBMicrolensing::PSPLLightCurve},
+        {"PSPLLightCurveParallax", &VBMicrolensing::PSPLLightCurveParallax},
+        {"ESPLLightCurve", &VBMicrolensing::ESPLLightCurve},
+        {"ESPLLightCurveParallax", &VBMicrolensing::ESPLLightCurveParallax},
+        {"BinaryLightCurve", &VBMicrolensing::BinaryLightCurve},
+        {"BinaryLightCurveW", &VBMicrolensing::BinaryLightCurveW},
+        {"BinaryLightCurveParallax", &VBMicrolensing::BinaryLightCurveParallax},
+        {"BinSourceLightCurve", &VBMicrolensing::BinSourceLightCurve},
+        {"BinSourceLightCurveParallax", &VBMicrolensing::BinSourceLightCurveParallax}};
+    static const std::unordered_map<std::string, light_curve_sep> sep_curves = {
+        {"BinaryLightCurveOrbital", &VBMicrolensing::BinaryLightCurveOrbital},
+        {"BinaryLightCurveKepler", &VBMicrolensing::BinaryLightCurveKepler},
+        {"BinSourceLightCurveXallarap", &VBMicrolensing::BinSourceLightCurveXallarap}};
+
+    auto c = curves.find(curve);
+    auto s = sep_curves.find(curve);
+    if (c == curves.end() && s == sep_curves.end() && curve != "LightCurve")
+        throw py::value_error("unknown light curve " + curve);
+    if (ndatasets < 1)
+        throw py::value_error("ndatasets must be at least 1");
+    py::ssize_t np = times.size();
+    input_length(flux, np, "flux");
+    input_length(err, np, "err");
+    if (dataset.size() != np)
+        throw py::value_error("dataset must have the same length as times");
+
+    py::array_t<double> FsFb(2 * (py::ssize_t)ndatasets), residuals(np);
+    double *pr = (double *)params.data(), *ts = (double *)times.data();
+    double *fl = (double *)flux.data(), *er = (double *)err.data();
+    int *ds = (int *)dataset.data();
+    double *fsfb = FsFb.mutable_data(), *res = residuals.mutable_data();
+    int nl = (int)(params.size() - 4) / 3 + 1;
+    double chi2;
+    {
+        py::gil_scoped_release release;
+        std::lock_guard<std::mutex> guard(instance_lock(self));
+        if (c != curves.end()) chi2 = self.LightCurveChi2(c->second, pr, ts, fl, er, ds, ndatasets, (int)np, fsfb, res);
+        else if (s != sep_curves.end()) chi2 = self.LightCurveChi2(s->second, pr, ts, fl, er, ds, ndatasets, (int)np, fsfb, res);
+        else chi2 = self.LightCurveChi2(pr, ts, fl, er, ds, ndatasets, (int)np, nl, fsfb, res);
+    }
+    return py::make_tuple(chi2, FsFb, residuals);
+}
+#endif
+
+#define _into_doc(description, parameters) \
+    "\n            " description " Zero-copy version writing into caller-provided arrays.\n" \
+    "            The GIL is released during the computation.\n" \
+    "\n" \
+    "            Parameters\n" \
+    "            ----------\n" \
+    "            params : numpy.ndarray[float64]\n" \
+    "                " parameters "\n" \
+    "            times : numpy.ndarray[float64]\n" \
+    "                Array of times at which the magnification is calculated.\n" \
+    "            mags, y1s, y2s : numpy.ndarray[float64]\n" \
+    "                Writeable one-dimensional C-contiguous arrays as long as times, receiving magnification,\n" \
+    "                source position y1 and source position y2.\n" \
+    "\n" \
+    "            Returns\n" \
+    "            -------\n" \
+    "            None\n" \
+    "            "
+/*******************************************   end   *******************************************/
+
 PYBIND11_MODULE(VBMicrolensing, m) {
     py::options options;
     options.disable_function_signatures();
@@ -51,6 +209,43 @@ PYBIND11_MODULE(VBMicrolensing, m) {
             "Exponent for the mass-luminosity relation: L = M^q; default value is q=4.0");
         vbm.def_readwrite("mass_radius_exponent", &VBMicrolensing::mass_radius_exponent,
             "Exponent for the mass-radius relation: R = M^q; default value is q=0.89");
+        /******************************************* changed *******************************************/
+#ifdef VBM_ALGORITHMIC_LIBRARY
+        py::class_<_call_stats>(m, "CallStats",
+            "Hot path statistics of a magnification call, see _call_stats in VBMicrolensingLibrary.h.")
+            .def_readonly("NPS", &_call_stats::NPS,
+                "Contour points sampled, all annuli and BinaryMagSafe retries included.")
+            .def_readonly("NewImages_calls", &_call_stats::NewImages_calls,
+                "Lens equation solutions on the source contours.")
+            .def_readonly("laguerre_iterations", &_call_stats::laguerre_iterations,
+                "Root finding iterations (Newton iterations of froot with the Nopoly method).")
+            .def_readonly("polish_iterations", &_call_stats::polish_iterations,
+                "Newton iterations polishing the roots with the full polynomial.")
+            .def_readonly("OrderImages_seconds", &_call_stats::OrderImages_seconds,
+                "Time spent linking the new images to the image tracks.")
+            .def_readonly("BinaryMagSafe_retries", &_call_stats::BinaryMagSafe_retries,
+                "Contours recomputed with a slightly shifted radius by BinaryMagSafe.")
+            .def_readonly("annuli", &_call_stats::annuli,
+                "Annuli computed by BinaryMagDark.")
+            .def_readonly("BinaryMag2_branch", &_call_stats::BinaryMag2_branch,
+                "Tier taken by BinaryMag2 or MultiMag2: 0 none, 1 point source, 2 finite source, 3 hexadecapole.");
+        // whether the library is compiled with -D_HOTPATH_STATS, i.e. whether the statistics are collected
+        m.attr("hotpath_stats") =
+#ifdef _HOTPATH_STATS
+            true;
+#else
+            false;
+#endif
+        // a copy, taken under the lock of the instance so that it is not read while a light curve writes it
+        vbm.def_property_readonly("stats",
+            [](VBMicrolensing &self) {
+                std::lock_guard<std::mutex> guard(instance_lock(self));
+                return self.stats;
+            },
+            "Hot path statistics of the last magnification call (a CallStats). Collected only if the library\n"
+            "is compiled with -D_HOTPATH_STATS, otherwise every field is 0.");
+#endif
+        /*******************************************   end   *******************************************/
         vbm.def("LoadESPLTable", &VBMicrolensing::LoadESPLTable,
             """Loads a pre calculated binary table for extended source calculation.""");
         // Maginfication calculations
@@ -844,6 +1039,152 @@ PYBIND11_MODULE(VBMicrolensing, m) {
                 [Magnification array, source position y1 array, source position y2 array]
             )mydelimiter");
 
+        /******************************************* changed *******************************************/
+        // Zero-copy light curve calculations (see light_curve_into)
+        vbm.def("PSPLLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::PSPLLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("PSPL light curve.", "Array of parameters [log_u0, log_tE, t0]."));
+        vbm.def("PSPLLightCurveParallaxInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::PSPLLightCurveParallax, params, times, mags, y1s, y2s);
+            },
+            _into_doc("PSPL light curve including parallax.", "Array of parameters [u0, log_tE, t0, pai1, pai2]."));
+        vbm.def("ESPLLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::ESPLLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("ESPL light curve.", "Array of parameters [log_u0, log_tE, t0, log_rho]."));
+        vbm.def("ESPLLightCurveParallaxInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::ESPLLightCurveParallax, params, times, mags, y1s, y2s);
+            },
+            _into_doc("ESPL light curve including parallax.", "Array of parameters [u0, log_tE, t0, pai1, pai2]."));
+        vbm.def("BinaryLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinaryLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Static binary lens light curve.", "Array of parameters [log_s, log_q, u0, alpha, log_rho, log_tE, t0]."));
+        vbm.def("BinaryLightCurveWInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinaryLightCurveW, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Static binary lens light curve with u0_c and t0_c defined with respect to the center of the caustic.", "Array of parameters [log_s, log_q, u0_c, alpha, log_rho, log_tE, t0_c]."));
+        vbm.def("BinaryLightCurveParallaxInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinaryLightCurveParallax, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Static binary lens light curve including parallax.", "Array of parameters [log_s, log_q, u0, alpha, log_rho, log_tE, t0, pai1, pai2]."));
+        vbm.def("BinSourceLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinSourceLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Binary source light curve.", "Array of parameters [log_tE, log_fluxratio, u0_1, u0_2, t0_1, t0_2]."));
+        vbm.def("BinSourceLightCurveParallaxInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinSourceLightCurveParallax, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Binary source light curve including parallax.", "Array of parameters [log_tE, log_fluxratio, u0_1, u0_2, t0_1, t0_2, pai1, pai2]."));
+        vbm.def("BinSourceExtLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinSourceExtLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Binary source light curve with extended sources.", "Array of parameters [log_tE, log_fluxratio, u0_1, u0_2, t0_1, t0_2, rho]."));
+        vbm.def("BinSourceBinLensXallarapInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::BinSourceBinLensXallarap, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Binary source and binary lens light curve including xallarap.", "Array of parameters [log_s, log_q, u0, alpha, log_rho, log_tE, t0, xi1, xi2, omega, inc, phi, log_qs]."));
+        vbm.def("TripleLightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::TripleLightCurve, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Static triple lens light curve.", "Array of parameters [log(s12), log(q2), u0, alpha, log(rho), log(tE), t0, log(s13), log(q3), psi]."));
+        vbm.def("TripleLightCurveParallaxInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                light_curve_into(self, &VBMicrolensing::TripleLightCurveParallax, params, times, mags, y1s, y2s);
+            },
+            _into_doc("Static triple lens light curve including parallax.", "Array of parameters [log(s12), log(q2), u0, alpha, log(rho), log(tE), t0, log(s13), log(q3), psi, px1, px2]."));
+        vbm.def("BinaryLightCurveOrbitalInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s, py::array seps)
+            {
+                light_curve_sep_into(self, &VBMicrolensing::BinaryLightCurveOrbital, params, times, mags, y1s, y2s, seps);
+            },
+            _into_doc("Binary lens light curve including circular orbital motion; seps receives the separation of the lenses.", "Array of parameters [log_s, log_q, u0, alpha_0, log_rho, log_tE, t0, pai1, pai2, w1, w2, w3]."));
+        vbm.def("BinaryLightCurveKeplerInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s, py::array seps)
+            {
+                light_curve_sep_into(self, &VBMicrolensing::BinaryLightCurveKepler, params, times, mags, y1s, y2s, seps);
+            },
+            _into_doc("Binary lens light curve including keplerian orbital motion; seps receives the separation of the lenses.", "Array of parameters [log_s, log_q, u0, alpha_0, log_rho, log_tE, t0, pai1, pai2, w1, w2, w3]."));
+        vbm.def("BinSourceLightCurveXallarapInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s, py::array seps)
+            {
+                light_curve_sep_into(self, &VBMicrolensing::BinSourceLightCurveXallarap, params, times, mags, y1s, y2s, seps);
+            },
+            _into_doc("Binary source light curve including xallarap; seps receives the separation of the sources.", "Array of parameters [log_tE, log_fluxratio, u0_1, u0_2, t0_1, t0_2, pai1, pai2, q, w1, w2, w3]."));
+        vbm.def("LightCurveInto",
+            [](VBMicrolensing &self, input_array params, input_array times, py::array mags, py::array y1s, py::array y2s)
+            {
+                py::ssize_t np = times.size();
+                double *pr = (double *)params.data(), *ts = (double *)times.data();
+                double *m = output_buffer(mags, np, "mags"), *y1 = output_buffer(y1s, np, "y1s"), *y2 = output_buffer(y2s, np, "y2s");
+                int nl = (int)(params.size() - 4) / 3 + 1;
+
+                py::gil_scoped_release release;
+                std::lock_guard<std::mutex> guard(instance_lock(self));
+                self.LightCurve(pr, ts, m, y1, y2, (int)np, nl);
+            },
+            _into_doc("Static multiple lens light curve.", "Array of parameters [t0, log_tE, log_rho, s1_im, s2_real,....,s2_im,...., q2,...,qn]."));
+#ifdef VBM_ALGORITHMIC_LIBRARY
+        vbm.def("LightCurveChi2", &light_curve_chi2,
+            R"mydelimiter(
+            Chi square of a light curve model against observed fluxes, with the source and blend
+            fluxes of each dataset fitted by weighted least squares (flux = Fs * mag + Fb).
+            The GIL is released during the computation.
+
+            Parameters
+            ----------
+            curve : str
+                Name of the light curve function: PSPLLightCurve, PSPLLightCurveParallax,
+                ESPLLightCurve, ESPLLightCurveParallax, BinaryLightCurve, BinaryLightCurveW,
+                BinaryLightCurveParallax, BinaryLightCurveOrbital, BinaryLightCurveKepler,
+                BinSourceLightCurve, BinSourceLightCurveParallax, BinSourceLightCurveXallarap
+                or LightCurve (multiple lens, number of lenses from the length of params).
+            params : numpy.ndarray[float64]
+                Array of parameters of the light curve function.
+            times : numpy.ndarray[float64]
+                Array of times of the observations.
+            flux, err : numpy.ndarray[float64]
+                Observed fluxes and their errors, as long as times. Points with err <= 0 are left out.
+            dataset : numpy.ndarray[int]
+                Dataset of each point, 0 to ndatasets - 1, as long as times. Points with other
+                indices are left out.
+            ndatasets : int
+                Number of datasets.
+
+            Returns
+            -------
+            results: tuple[float, numpy.ndarray[float64], numpy.ndarray[float64]]
+                (chi square, [Fs_0, Fb_0, Fs_1, Fb_1, ...], normalized residuals (flux - Fs * mag - Fb) / err)
+            )mydelimiter");
+#endif
+        /*******************************************   end   *******************************************/
+
         // Other functions
 
 
@@ -0,0 +1,60 @@
+###Common benchmark of the six versions (see test_benchmark.cpp)
+###run compile_all_VBBL.sh and compile_all_VBMicrolensing.sh first, they build the six libraries in bin/
+###usage: ./benchmark_all.sh [grid_side] [ESPL_table]
+###       grid_side  : side of the magnification map grids (default 51; 251 is the size used by the other tests)
+###       ESPL_table : pre calculated ESPL table file, to also run the ESPL workloads
+###output: result/benchmark_<version>.json for each version, and all of them in result/benchmark.json
+###       the accuracy of each version is measured against the No Optimization version of the same library
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:bin/
+
+GRID_SIDE=${1:-51}
+ESPL_TABLE=$2
+
+mkdir -p result
+
+
+### build the benchmark once per version
+build_benchmark()   # $1: version name, $2: header, $3: library, $4: extra flags
+{
+    rm -rf bin/test_benchmark_$1.out
+    g++ -O3 -g -Wall -Wextra -march=native $4 -D_BENCH_HEADER="\"$2\"" -D_BENCH_VARIANT="\"$1\"" test_benchmark.cpp -Lbin -l$3 -o bin/test_benchmark_$1.out
+}
+
+build_benchmark VBBL_no_optimization                             VBBL_lib_no_optimization/VBBinaryLensingLibrary_v3p6.h                          _VBBinaryLensingLibraryNoOptimization
+build_benchmark VBBL_compiling_optimization                      VBBL_lib_compiling_optimization/VBBinaryLensingLibrary_v3p6.h                   _VBBinaryLensingLibraryCompilingOptimization
+build_benchmark VBBL_algorithmic_compiling_optimization          VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h       _VBBinaryLensingLibraryAlgorithmicCompilingOptimization
+build_benchmark VBMicrolensing_no_optimization                   VBMicrolensing_lib_no_optimization/VBMicrolensingLibrary.h                      _VBMicrolensingLibraryNoOptimization                     -D_BENCH_VBM
+build_benchmark VBMicrolensing_compiling_optimization            VBMicrolensing_lib_compiling_optimization/VBMicrolensingLibrary.h               _VBMicrolensingLibraryCompilingOptimization              -D_BENCH_VBM
+build_benchmark VBMicrolensing_algorithmic_compiling_optimization VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h  _VBMicrolensingLibraryAlgorithmicCompilingOptimization   -D_BENCH_VBM
+
+
+### run: the No Optimization version of each library first, as reference of the two others
+run_benchmark()     # $1: version name, $2: reference version name (or none)
+{
+    REFERENCE=none
+    if [ "$2" != "none" ]; then REFERENCE=result/benchmark_mags_$2.txt; fi
+    bin/test_benchmark_$1.out result/benchmark_$1.json result/benchmark_mags_$1.txt $REFERENCE $GRID_SIDE $ESPL_TABLE
+}
+
+run_benchmark VBBL_no_optimization                              none
+run_benchmark VBBL_compiling_optimization                       VBBL_no_optimization
+run_benchmark VBBL_algorithmic_compiling_optimization           VBBL_no_optimization
+run_benchmark VBMicrolensing_no_optimization                    none
+run_benchmark VBMicrolensing_compiling_optimization             VBMicrolensing_no_optimization
+run_benchmark VBMicrolensing_algorithmic_compiling_optimization VBMicrolensing_no_optimization
+
+
+### gather the six reports in one file
+{
+    echo "["
+    SEPARATOR=""
+    for VERSION in VBBL_no_optimization VBBL_compiling_optimization VBBL_algorithmic_compiling_optimization \
+                   VBMicrolensing_no_optimization VBMicrolensing_compiling_optimization VBMicrolensing_algorithmic_compiling_optimization
+    do
+        printf "%s" "$SEPARATOR"
+        cat result/benchmark_$VERSION.json
+        SEPARATOR=","
+    done
+    echo "]"
+} > result/benchmark.json
+echo "all reports gathered in result/benchmark.json"
@@ -58,7 +58,7 @@ g++ -O3 -g -Wall -Wextra -march=native test_VBBLCompilingOptimization.cpp -Lbin
 
 ### build a dynamic library(.a is static link, .so is dynamic/runtime link)
 rm -rf bin/lib_VBBinaryLensingLibraryAlgorithmicCompilingOptimization.so
-g++ -fPIC -O3 -g -flto -Wall -Wextra -shared -march=native -o bin/lib_VBBinaryLensingLibraryAlgorithmicCompilingOptimization.so VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.cpp
+g++ -fPIC -O3 -g -flto -Wall -Wextra -shared -march=native -pthread -o bin/lib_VBBinaryLensingLibraryAlgorithmicCompilingOptimization.so VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.cpp
 chmod -x bin/lib_VBBinaryLensingLibraryAlgorithmicCompilingOptimization.so
 
 
@@ -67,3 +67,54 @@ rm -rf bin/test_VBBLAlgorithmicCompilingOptimization.out
 #the source file should be in front of the dynamic library
 g++ -O3 -g -Wall -Wextra -march=native test_VBBLAlgorithmicCompilingOptimization.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLAlgorithmicCompilingOptimization.out
 
+
+
+### build the allocation count test, which counts the heap allocations done per point with the object pools
+rm -rf bin/test_VBBLAllocationCount.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLAllocationCount.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLAllocationCount.out
+
+
+### build the test of the batched point-source solver (BinaryMag0_Npoint, and BinaryMag2_Npoint with the caustic index)
+rm -rf bin/test_VBBLBatchedPointSource.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLBatchedPointSource.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLBatchedPointSource.out
+
+
+### build the test of the parallel contour (contourthreads > 1)
+rm -rf bin/test_VBBLParallelContour.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLParallelContour.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLParallelContour.out
+
+### build the test of the warm start of the light curves (warmstart = true)
+rm -rf bin/test_VBBLWarmStart.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLWarmStart.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLWarmStart.out
+
+### build the test of the derivatives of BinaryMag2Gradient
+rm -rf bin/test_VBBLGradient.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLGradient.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLGradient.out
+
+### build the test of the C interface of LightCurveChi2 (wrapVBBL_LightCurveChi2)
+rm -rf bin/test_VBBLLightCurveChi2.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLLightCurveChi2.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLLightCurveChi2.out
+
+### build the test of the hexadecapole tier of BinaryMag2 (MultipoleMag)
+rm -rf bin/test_VBBLMultipole.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLMultipole.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLMultipole.out
+
+### build the test of the frozen sampling of the light curves (RecordSampling / FreezeSampling)
+rm -rf bin/test_VBBLFrozenSampling.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLFrozenSampling.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLFrozenSampling.out
+
+### build the test of the per-point tolerances of the light curves (SetPointTolerances)
+rm -rf bin/test_VBBLPointTolerances.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLPointTolerances.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLPointTolerances.out
+
+### build the test of concurrent instances (VBBinaryLensing objects on several threads)
+rm -rf bin/test_VBBLConcurrentInstances.out
+g++ -O3 -g -Wall -Wextra -march=native -pthread test_VBBLConcurrentInstances.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLConcurrentInstances.out
+
+### build the test of the multithreaded point lists and maps (BinaryMag2_Npoint, BinaryMagMap)
+rm -rf bin/test_VBBLParallelMaps.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLParallelMaps.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLParallelMaps.out
+
+### build the test of the settings of the C interface handles (wrapVBBL_SetLDprofile, wrapVBBL_SetThreads, wrapVBBL_SetWarmStart)
+rm -rf bin/test_VBBLHandleSettings.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBBLHandleSettings.cpp -Lbin -l_VBBinaryLensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBBLHandleSettings.out
@@ -58,7 +58,7 @@ g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingCompilingOptimization.
 
 ### build a dynamic library(.a is static link, .so is dynamic/runtime link)
 rm -rf bin/lib_VBMicrolensingLibraryAlgorithmicCompilingOptimization.so
-g++ -fPIC -O3 -g -flto -Wall -Wextra -shared -march=native -o bin/lib_VBMicrolensingLibraryAlgorithmicCompilingOptimization.so VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.cpp
+g++ -fPIC -O3 -g -flto -Wall -Wextra -shared -march=native -pthread -o bin/lib_VBMicrolensingLibraryAlgorithmicCompilingOptimization.so VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.cpp
 chmod -x bin/lib_VBMicrolensingLibraryAlgorithmicCompilingOptimization.so
 
 
@@ -68,5 +68,41 @@ rm -rf bin/test_VBMicrolensingAlgorithmicCompilingOptimization.out
 g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingAlgorithmicCompilingOptimization.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingAlgorithmicCompilingOptimization.out
 
 
+### build the test of the batched point-source solver (BinaryMag0_Npoint)
+rm -rf bin/test_VBMicrolensingBatchedPointSource.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingBatchedPointSource.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingBatchedPointSource.out
+
+### build the test of the tiers of MultiMag2 (MultiMultipoleMag)
+rm -rf bin/test_VBMicrolensingMultiMag2.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingMultiMag2.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingMultiMag2.out
+
+### build the test of concurrent instances (VBMicrolensing objects on several threads)
+rm -rf bin/test_VBMicrolensingConcurrentInstances.out
+g++ -O3 -g -Wall -Wextra -march=native -pthread test_VBMicrolensingConcurrentInstances.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingConcurrentInstances.out
+
+### build the test of the multithreaded maps (MultiMagMap)
+rm -rf bin/test_VBMicrolensingParallelMaps.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingParallelMaps.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingParallelMaps.out
+
+### build the test of the parallel contour of MultiMag (contourthreads)
+rm -rf bin/test_VBMicrolensingParallelContour.out
+g++ -O3 -g -Wall -Wextra -march=native test_VBMicrolensingParallelContour.cpp -Lbin -l_VBMicrolensingLibraryAlgorithmicCompilingOptimization -o bin/test_VBMicrolensingParallelContour.out
+
+
+
+### build the Python module (only if pybind11 is installed), against the algorithmic version whose solver state is per instance,
+### then run its smoke test (which needs NumPy)
+if python3 -c "import pybind11" 2>/dev/null; then
+rm -rf bin/VBMicrolensing$(python3 -c "import sysconfig; print(sysconfig.get_config_var('EXT_SUFFIX'))")
+g++ -fPIC -O3 -g -Wall -Wextra -shared -march=native -pthread -DVBM_ALGORITHMIC_LIBRARY $(python3 -m pybind11 --includes) VBMicrolensing_lib_no_optimization/python_bindings.cpp VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.cpp -o bin/VBMicrolensing$(python3 -c "import sysconfig; print(sysconfig.get_config_var('EXT_SUFFIX'))")
+python3 test_VBMicrolensingPythonBindings.py
+### the same module with the hot path statistics (-D_HOTPATH_STATS) in bin/hotpath_stats, whose smoke test checks the counters
+mkdir -p bin/hotpath_stats
+rm -rf bin/hotpath_stats/VBMicrolensing$(python3 -c "import sysconfig; print(sysconfig.get_config_var('EXT_SUFFIX'))")
+g++ -fPIC -O3 -g -Wall -Wextra -shared -march=native -pthread -DVBM_ALGORITHMIC_LIBRARY -D_HOTPATH_STATS $(python3 -m pybind11 --includes) VBMicrolensing_lib_no_optimization/python_bindings.cpp VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.cpp -o bin/hotpath_stats/VBMicrolensing$(python3 -c "import sysconfig; print(sysconfig.get_config_var('EXT_SUFFIX'))")
+python3 test_VBMicrolensingPythonBindings.py bin/hotpath_stats
+fi
+
+
 
 
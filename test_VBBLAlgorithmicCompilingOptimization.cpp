@@ -72,11 +72,6 @@ int main(int argc, char *argv[])
     x_max += shift_x ;
 
     
-    // calculate dy (and dx) according to y(x)_min, y(x)_max, Npoint_y(x)
-    double dy = (y_max - y_min) / (double)Npoint_y;
-    double dx = (x_max - x_min) / (double)Npoint_x;
-
-
     // first declare an instance to the VBBinaryLensing class
 	VBBinaryLensing VBBL;
     VBBL.a1  = 0.;
@@ -84,42 +79,19 @@ int main(int argc, char *argv[])
     VBBL.RelTol = 0.0001 ;
 
     
-    // use a variable to store a point's magnification
-    double mag ;
-
     // declare arrays to store all points' magnification and computation time
-    float * magnification_array ;
-    magnification_array    = (float *)malloc( Npoint_y * Npoint_x * 4 ) ;
-    float * computation_time_array ;
-    computation_time_array = (float *)malloc( Npoint_y * Npoint_x * 4 ) ;
+    double * magnification_array ;
+    magnification_array    = (double *)malloc( Npoint_y * Npoint_x * sizeof(double) ) ;
+    double * computation_time_array ;
+    computation_time_array = (double *)malloc( Npoint_y * Npoint_x * sizeof(double) ) ;
 
     // measure the total time
     auto begin_total = std::chrono::high_resolution_clock::now() ;
 
-    // double loop to calculate ( Npoint_y * Npoint_x ) points' magnification using BinaryMag2
-    for(int y_arg=0; y_arg < Npoint_y; y_arg++)
-    {   
-        double y_current = y_min + y_arg * dy ;
-
-        for(int x_arg=0; x_arg < Npoint_x; x_arg++)
-        {
-            double x_current = x_min + x_arg * dx ; 
-
-            int total_arg = y_arg * Npoint_x + x_arg ;
-
-            auto begin = std::chrono::high_resolution_clock::now();
-            
-            mag = VBBL.BinaryMag2(s, q, x_current, y_current, rho) ;
-            //mag = VBBL.BinaryMag0(s, q, x_current, y_current) ;
-            
-            auto end = std::chrono::high_resolution_clock::now();
-            auto elapsed_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin);
-
-            magnification_array[total_arg]    = (float)mag ;
-            computation_time_array[total_arg] = (float)(elapsed_time.count() * 1e-9) ; // nanosecond to second
-            //printf("CPU code                   needs %e (second)\n", cpu_code_time) ; 
-        }
-    }
+    // calculate ( Npoint_y * Npoint_x ) points' magnification using BinaryMag2,
+    // in tiles distributed over all the hardware threads (0 = use all of them)
+    VBBL.BinaryMagMap(s, q, rho, x_min, x_max, y_min, y_max, Npoint_x, Npoint_y, \
+                      magnification_array, computation_time_array, 0) ;
 
     auto end_total   = std::chrono::high_resolution_clock::now() ;
     auto elapsed_time_total = std::chrono::duration_cast<std::chrono::nanoseconds>(end_total - begin_total) ;
@@ -148,7 +120,7 @@ int main(int argc, char *argv[])
 
         for(int arg=0; arg < Npoint_y * Npoint_x; arg++)
         {
-            fprintf(file_pointer, "%e %e\n", magnification_array[arg], computation_time_array[arg]) ; 
+            fprintf(file_pointer, "%e %e\n", (float)magnification_array[arg], (float)computation_time_array[arg]) ; 
             //fprintf(file_pointer, "%e\n", magnification_array[arg]) ; 
         }
         
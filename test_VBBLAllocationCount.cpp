@@ -0,0 +1,103 @@
+/**************************************************************************************/
+// this code is calling VBBL to calculate the magnification of points from low to high magnification,
+// to count how many heap allocations each point needs with the object pools of the algorithmic version:
+// "objects" is the number of _point, _theta, _curve and _skiplist_curve created, i.e. the number of
+// malloc/free pairs one point would cost without the pools, "mallocs" is the number actually done
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <new>
+#include <chrono>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+// every heap allocation of the program (library included) goes through here and is counted
+static long long malloc_count = 0 ;
+
+void * operator new(size_t size)
+{
+    malloc_count++ ;
+    void * p = malloc(size ? size : 1) ;
+    if (!p) throw std::bad_alloc() ;
+    return p ;
+}
+
+void operator delete(void * p) noexcept
+{
+    free(p) ;
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    free(p) ;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        printf("wrong number of argument!");
+        exit(0) ;
+    }
+
+    printf("s   = %s\n", argv[1]);
+    printf("q   = %s\n", argv[2]);
+    printf("rho = %s\n", argv[3]);
+
+    double s   = atof( argv[1] ) ;
+    double q   = atof( argv[2] ) ;
+    double rho = atof( argv[3] ) ;
+
+    // change the origin to primary lens to compare with VBMicrolensing
+    double shift_x = -s*q/(1.+q) ;
+
+    // distance of the source from the primary lens, from far (low magnification) to close (high magnification)
+    int Ndistance = 8 ;
+    double distance[] = {1.0, 0.3, 0.1, 0.03, 0.01, 0.003, 0.001, 0.0003} ;
+    // each point is repeated, so that the pools are warm after the first call
+    int Nrepeat = 100 ;
+
+
+    // first declare an instance to the VBBinaryLensing class
+	VBBinaryLensing VBBL;
+    VBBL.a1  = 0.;
+    VBBL.Tol = 0.001;
+    VBBL.RelTol = 0.0001 ;
+
+    printf("%10s %14s %14s %14s %14s %14s\n", "distance", "magnification", "objects/point", "mallocs/point", "slabs", "time/point(s)") ;
+
+    for(int i=0; i < Ndistance; i++)
+    {
+        double y1 = shift_x + distance[i] * cos(0.3) ;
+        double y2 = distance[i] * sin(0.3) ;
+        double magnification = 0. ;
+
+        long long objects_begin, slabs_begin, objects_end, slabs_end ;
+        VBBinaryLensing::ObjectPoolStatistics(&objects_begin, &slabs_begin) ;
+        long long malloc_begin = malloc_count ;
+        auto begin = std::chrono::high_resolution_clock::now() ;
+
+        for(int repeat=0; repeat < Nrepeat; repeat++)
+        {
+            magnification = VBBL.BinaryMag2(s, q, y1, y2, rho) ;
+        }
+
+        auto end = std::chrono::high_resolution_clock::now() ;
+        long long malloc_end = malloc_count ;
+        VBBinaryLensing::ObjectPoolStatistics(&objects_end, &slabs_end) ;
+        double elapsed_time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() * 1e-9 ;
+
+        printf("%10.4f %14.6e %14.1f %14.1f %14lld %14.6e\n", distance[i], magnification, \
+               (double)(objects_end - objects_begin) / Nrepeat, (double)(malloc_end - malloc_begin) / Nrepeat, \
+               slabs_end - slabs_begin, elapsed_time / Nrepeat) ;
+    }
+
+    long long objects_total, slabs_total ;
+    VBBinaryLensing::ObjectPoolStatistics(&objects_total, &slabs_total) ;
+    printf("total: %lld objects created from %lld slabs, %lld mallocs\n", objects_total, slabs_total, malloc_count) ;
+
+    return 0;
+}
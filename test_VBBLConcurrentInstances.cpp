@@ -0,0 +1,128 @@
+/**************************************************************************************/
+// this code tests that independent instances of the algorithmic version of VBBL can run concurrently: 4 threads, each
+// with its own instance, compute BinaryMag2 on far field sources and along a caustic crossing of a limb darkened source,
+// each thread starting at a different point of the list, then BinaryLightCurve on the crossing. Over several rounds, the
+// magnifications of every thread must be bit for bit those of the same sequence of calls run serially on a fresh instance.
+// So must those of a copy of a used instance, and of a used instance assigned to another one: a copy gets a workspace of
+// its own, in the state of a fresh instance.
+// It prints the differing magnifications and returns 1 if there are any.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+static const int Nthreads = 4 ;
+static const int Np = 200 ;
+// caustic crossing of a stellar binary: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+static double pr[7] = {log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0} ;
+
+static void configure(VBBinaryLensing &VBBL)
+{
+    VBBL.Tol = 1.e-4 ;
+    VBBL.RelTol = 1.e-4 ;
+    VBBL.a1 = 0.5 ;
+}
+
+// the calls of thread k: BinaryMag2 on the sources from the point k * n / Nthreads on, then the light curve;
+// mags gets the magnifications of the sources, in their order, and those of the light curve
+static void calls(VBBinaryLensing &VBBL, int k, const std::vector<double> &ts, const std::vector<double> &y1s, const std::vector<double> &y2s,
+                  std::vector<double> &mags)
+{
+    int n = (int)y1s.size() ;
+    double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]) ;
+    std::vector<double> cts(ts), cy1s(Np), cy2s(Np) ;
+    mags.resize(n + Np) ;
+    for (int j = 0; j < n; j++)
+    {
+        int i = (j + k * n / Nthreads) % n ;
+        mags[i] = VBBL.BinaryMag2(s, q, y1s[i], y2s[i], rho) ;
+    }
+    VBBL.BinaryLightCurve(pr, cts.data(), mags.data() + n, cy1s.data(), cy2s.data(), Np) ;
+}
+
+// the calls of thread k on a fresh instance
+static void sequence(int k, const std::vector<double> &ts, const std::vector<double> &y1s, const std::vector<double> &y2s,
+                     std::vector<double> &mags)
+{
+    VBBinaryLensing VBBL ;
+    configure(VBBL) ;
+    calls(VBBL, k, ts, y1s, y2s, mags) ;
+}
+
+// number of magnifications that are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+
+int main()
+{
+    int rounds = 3 ;
+    int failed = 0 ;
+
+    // sources along the caustic crossing of the light curve, then in the far field
+    std::vector<double> ts(Np), y1s(Np), y2s(Np), mags(Np) ;
+    for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.BinaryLightCurve(pr, ts.data(), mags.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    for (int i = 0; i < 40; i++)
+    {
+        double r = 5. + 15. * i / 39, phi = 2.3 * i ;
+        y1s.push_back(r * cos(phi)) ;
+        y2s.push_back(r * sin(phi)) ;
+    }
+
+    std::vector<double> serial[Nthreads] ;
+    for (int k = 0; k < Nthreads; k++) sequence(k, ts, y1s, y2s, serial[k]) ;
+
+    printf("%8s %8s %20s\n", "round", "thread", "differing") ;
+    for (int r = 0; r < rounds; r++)
+    {
+        std::vector<double> concurrent[Nthreads] ;
+        std::vector<std::thread> threads ;
+        for (int k = 0; k < Nthreads; k++) threads.emplace_back(sequence, k, std::cref(ts), std::cref(y1s), std::cref(y2s), std::ref(concurrent[k])) ;
+        for (auto &t : threads) t.join() ;
+        for (int k = 0; k < Nthreads; k++)
+        {
+            int n = differences(concurrent[k], serial[k]) ;
+            printf("%8d %8d %20d\n", r, k, n) ;
+            if (n > 0)
+            {
+                printf("FAILED: round %d thread %d differs from the serial run on %d of %d magnifications\n", r, k, n, (int)serial[k].size()) ;
+                failed = 1 ;
+            }
+        }
+    }
+
+    // copies of an instance used by the calls of thread 1, running the calls of thread 0
+    {
+        std::vector<double> used_mags, copied_mags, assigned_mags ;
+        VBBinaryLensing used ;
+        configure(used) ;
+        calls(used, 1, ts, y1s, y2s, used_mags) ;
+        VBBinaryLensing copied(used) ;
+        VBBinaryLensing assigned ;
+        assigned = used ;
+        calls(copied, 0, ts, y1s, y2s, copied_mags) ;
+        calls(assigned, 0, ts, y1s, y2s, assigned_mags) ;
+        int ncopied = differences(copied_mags, serial[0]), nassigned = differences(assigned_mags, serial[0]) ;
+        printf("differing from a fresh instance: copy %d, assignment %d (of %d)\n", ncopied, nassigned, (int)serial[0].size()) ;
+        if (ncopied > 0 || nassigned > 0)
+        {
+            printf("FAILED: a copy of a used instance does not start from the state of a fresh instance\n") ;
+            failed = 1 ;
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
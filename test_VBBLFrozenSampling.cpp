@@ -0,0 +1,137 @@
+/**************************************************************************************/
+// this code tests the frozen sampling of the algorithmic version of VBBL (RecordSampling / FreezeSampling /
+// RemoveFrozenSampling) on BinaryLightCurve across the caustic crossing of a limb darkened source:
+// - the curve recorded by RecordSampling, and its replay by FreezeSampling at the same parameters, must be bit for bit
+//   the adaptive curve;
+// - finite differences of the curve in u0, alpha and log_rho, on steps of 1e-8, must not be noisier with frozen sampling
+//   than with adaptive sampling: the second differences of the magnification along the steps measure the noise;
+// - after RemoveFrozenSampling, the curve at perturbed parameters must be bit for bit that of a fresh instance.
+// It prints the deviations and the noise and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+static void set_accuracy(VBBinaryLensing &VBBL)
+{
+    VBBL.Tol = 1.e-4 ;
+    VBBL.RelTol = 1.e-4 ;
+    VBBL.a1 = 0.5 ;
+}
+
+// number of points on which the two curves are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+// noise of the curves of VBBL along steps of parameter j: largest second difference of the magnification on
+// parameters p + k * h for k = 0 .. Nstep - 1, relative to the magnification
+static double noise(VBBinaryLensing &VBBL, double *pr, int j, double h, std::vector<double> &ts)
+{
+    const int Nstep = 6 ;
+    int np = (int)ts.size() ;
+    std::vector<double> mags[Nstep], y1s(np), y2s(np) ;
+    double worst = 0. ;
+    for (int k = 0; k < Nstep; k++)
+    {
+        double p[7] ;
+        for (int l = 0; l < 7; l++) p[l] = pr[l] ;
+        p[j] += k * h ;
+        mags[k].resize(np) ;
+        VBBL.BinaryLightCurve(p, ts.data(), mags[k].data(), y1s.data(), y2s.data(), np) ;
+    }
+    for (int k = 1; k < Nstep - 1; k++)
+    {
+        for (int i = 0; i < np; i++)
+        {
+            double d2 = fabs(mags[k + 1][i] - 2 * mags[k][i] + mags[k - 1][i]) / mags[k][i] ;
+            if (!(d2 <= worst)) worst = d2 ;
+        }
+    }
+    return worst ;
+}
+
+
+int main()
+{
+    int Np = 200 ;
+    int failed = 0 ;
+
+    // caustic crossing of a stellar binary by a limb darkened source: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    double pr[7] = {log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0} ;
+    std::vector<double> ts(Np), y1s(Np), y2s(Np) ;
+    for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+
+    // replay at the recorded parameters
+    std::vector<double> adaptive(Np), recorded(Np), replayed(Np) ;
+    {
+        VBBinaryLensing VBBL ;
+        set_accuracy(VBBL) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), adaptive.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    VBBinaryLensing frozen ;
+    set_accuracy(frozen) ;
+    frozen.RecordSampling() ;
+    frozen.BinaryLightCurve(pr, ts.data(), recorded.data(), y1s.data(), y2s.data(), Np) ;
+    frozen.FreezeSampling() ;
+    frozen.BinaryLightCurve(pr, ts.data(), replayed.data(), y1s.data(), y2s.data(), Np) ;
+    int nrecorded = differences(recorded, adaptive), nreplayed = differences(replayed, adaptive) ;
+    printf("points differing from the adaptive curve: recorded %d, replayed %d (of %d)\n", nrecorded, nreplayed, Np) ;
+    if (nrecorded > 0 || nreplayed > 0)
+    {
+        printf("FAILED: the recorded or replayed curve is not the adaptive one\n") ;
+        failed = 1 ;
+    }
+
+    // smoothness of the finite differences: the frozen instance replays the sampling recorded at pr
+    const char *names[3] = {"u0", "alpha", "log_rho"} ;
+    int params[3] = {2, 3, 4} ;
+    double h = 1.e-8 ;      // the usual step of finite differences, about the square root of the machine precision
+    printf("%10s %20s %20s\n", "parameter", "noise adaptive", "noise frozen") ;
+    for (int c = 0; c < 3; c++)
+    {
+        VBBinaryLensing VBBL ;
+        set_accuracy(VBBL) ;
+        double noise_adaptive = noise(VBBL, pr, params[c], h, ts) ;
+        double noise_frozen = noise(frozen, pr, params[c], h, ts) ;
+        printf("%10s %20.3e %20.3e\n", names[c], noise_adaptive, noise_frozen) ;
+        // the adaptive noise comes from the sampling moving with the source, of the order of the accuracy in u0 and alpha;
+        // what is left with frozen sampling comes from the caustics crossing the fixed sampling points of the contours
+        if (!(noise_frozen <= noise_adaptive))
+        {
+            printf("FAILED: the finite differences in %s are noisier with frozen sampling\n", names[c]) ;
+            failed = 1 ;
+        }
+    }
+
+    // back to adaptive sampling, at perturbed parameters
+    double pp[7] ;
+    for (int l = 0; l < 7; l++) pp[l] = pr[l] ;
+    pp[2] += 1.e-3 ;
+    pp[4] += 1.e-2 ;
+    std::vector<double> removed(Np), fresh(Np) ;
+    frozen.RemoveFrozenSampling() ;
+    frozen.BinaryLightCurve(pp, ts.data(), removed.data(), y1s.data(), y2s.data(), Np) ;
+    {
+        VBBinaryLensing VBBL ;
+        set_accuracy(VBBL) ;
+        VBBL.BinaryLightCurve(pp, ts.data(), fresh.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    int nremoved = differences(removed, fresh) ;
+    printf("points differing from a fresh instance after RemoveFrozenSampling: %d (of %d)\n", nremoved, Np) ;
+    if (nremoved > 0)
+    {
+        printf("FAILED: RemoveFrozenSampling did not restore adaptive sampling\n") ;
+        failed = 1 ;
+    }
+
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
@@ -0,0 +1,64 @@
+/**************************************************************************************/
+// this code tests the derivatives of BinaryMag2Gradient of the algorithmic version of VBBL against central finite differences
+// of BinaryMag2, for sources on caustic crossings and close to the caustics (contours of BinaryMag with their parabolic
+// corrections), and for a limb darkened source (annuli of BinaryMagDark). With Tol = 1e-7 the sampling changes little
+// between the finite difference points, so that the two must agree closely, the derivative in rho included.
+// It prints the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+int main()
+{
+    // s, q, y1, y2, rho, a1
+    int Ncase = 7 ;
+    double cases[7][6] = {{1.0, 0.1, 0.05, 0.02, 0.01, 0.},
+                          {1.0, 0.1, 0.0, 0.0, 0.01, 0.},
+                          {0.9, 0.1, -0.1, 0.03, 0.02, 0.},
+                          {1.2, 1.e-3, 0.37, 0.01, 2.e-3, 0.},
+                          {1.0, 0.1, 0.3, 0.3, 0.01, 0.},
+                          {0.8, 0.5, 0.05, 0.1, 0.05, 0.},
+                          {1.0, 0.1, 0.05, 0.02, 0.01, 0.5}} ;
+    const char *names[5] = {"s", "q", "y1", "y2", "rho"} ;
+    // deviation allowed, in units of |derivative| + Mag / rho: the finite differences (steps of 2e-5 of s and q, of 1e-3 of rho
+    // for y1, y2 and rho) agree with the derivatives to about 1e-7; leaving out the parabolic corrections gave up to 2e-4 in rho
+    double threshold = 1.e-6 ;
+    int failed = 0 ;
+
+    VBBinaryLensing VBBL ;
+    VBBL.Tol = 1.e-7 ;
+    VBBL.RelTol = 1.e-8 ;
+
+    printf("%6s %8s %8s %8s %8s %8s %6s %12s %12s %12s %12s %12s\n", "s", "q", "y1", "y2", "rho", "a1", "NPS",
+           names[0], names[1], names[2], names[3], names[4]) ;
+    for (int c = 0; c < Ncase; c++)
+    {
+        double *p = cases[c], grad[5], dev[5] ;
+        VBBL.a1 = p[5] ;
+        double Mag = VBBL.BinaryMag2Gradient(p[0], p[1], p[2], p[3], p[4], grad) ;
+        int NPS = VBBL.NPS ;
+        double steps[5] = {2.e-5 * p[0], 2.e-5 * p[1], 1.e-3 * p[4], 1.e-3 * p[4], 1.e-3 * p[4]} ;
+        for (int j = 0; j < 5; j++)
+        {
+            double pp[5], pm[5] ;
+            for (int k = 0; k < 5; k++) pp[k] = pm[k] = p[k] ;
+            pp[j] += steps[j] ;
+            pm[j] -= steps[j] ;
+            double fd = (VBBL.BinaryMag2(pp[0], pp[1], pp[2], pp[3], pp[4]) - VBBL.BinaryMag2(pm[0], pm[1], pm[2], pm[3], pm[4])) / (2 * steps[j]) ;
+            dev[j] = fabs(grad[j] - fd) / (fabs(fd) + Mag / p[4]) ;
+            if (!(dev[j] < threshold))
+            {
+                printf("FAILED: case %d, derivative in %s: %.8g against %.8g\n", c, names[j], grad[j], fd) ;
+                failed = 1 ;
+            }
+        }
+        printf("%6.2f %8.0e %8.3f %8.3f %8.0e %8.1f %6d %12.3e %12.3e %12.3e %12.3e %12.3e\n", p[0], p[1], p[2], p[3], p[4], p[5], NPS,
+               dev[0], dev[1], dev[2], dev[3], dev[4]) ;
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
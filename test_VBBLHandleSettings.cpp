@@ -0,0 +1,171 @@
+/**************************************************************************************/
+// this code tests the settings of the C interface handles of the algorithmic version of VBBL (wrapVBBL_SetLDprofile,
+// wrapVBBL_SetThreads, wrapVBBL_SetWarmStart): a handle and an instance make the same calls with the default settings,
+// then with a setting changed, through the C interface on the handle and directly on the instance. The magnifications
+// and chi squares must be bit for bit the same, and those with the setting must differ from those of the default:
+// - BinaryMag2 along a caustic crossing of a limb darkened source with the quadratic profile, also after a call with
+//   a profile out of range, which must leave the profile unchanged;
+// - BinaryMag2 with contourthreads 2, with an accuracy goal that takes the contours to the parallel batches;
+// - the chi square of a binary lens light curve with warm start (wrapVBBL_LightCurveChi2).
+// It prints the differing points and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+extern "C"
+{
+void * wrapVBBL_create(void) ;
+void * wrapVBBL_configure(void *handle, double Gamma, double absolute_tolerance, double relative_tolerance) ;
+void * wrapVBBL_SetLDprofile(void *handle, int profile, double a1, double a2) ;
+void * wrapVBBL_SetThreads(void *handle, int contourthreads) ;
+void * wrapVBBL_SetWarmStart(void *handle, int warmstart) ;
+void * wrapVBBL_BinaryMag2(void *handle, double s, double q, double x, double y, double rho, double *Mag) ;
+void * wrapVBBL_LightCurveChi2(void *handle, int curve_id, double *parameters, double *t_array, double *flux_array, double *err_array,
+                               int *dataset_array, int ndatasets, int np, double *FsFb, double *residual_array, double *chi2) ;
+void * wrapVBBL_destroy(void *handle) ;
+}
+
+
+// number of magnifications that are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+// magnifications of the sources through the handle
+static void handle_mags(void *handle, double s, double q, double rho, std::vector<double> &y1s, std::vector<double> &y2s,
+                        std::vector<double> &mags)
+{
+    mags.resize(y1s.size()) ;
+    for (size_t i = 0; i < y1s.size(); i++) wrapVBBL_BinaryMag2(handle, s, q, y1s[i], y2s[i], rho, &mags[i]) ;
+}
+
+// magnifications of the sources on the instance
+static void instance_mags(VBBinaryLensing &VBBL, double s, double q, double rho, std::vector<double> &y1s, std::vector<double> &y2s,
+                          std::vector<double> &mags)
+{
+    mags.resize(y1s.size()) ;
+    for (size_t i = 0; i < y1s.size(); i++) mags[i] = VBBL.BinaryMag2(s, q, y1s[i], y2s[i], rho) ;
+}
+
+
+int main()
+{
+    int Np = 120 ;
+    int failed = 0 ;
+
+    // caustic crossing of a stellar binary: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    double pr[7] = {log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0} ;
+    double s = exp(pr[0]), q = exp(pr[1]), rho = exp(pr[4]) ;
+    std::vector<double> ts(Np), y1s(Np), y2s(Np), mags(Np) ;
+    for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.BinaryLightCurve(pr, ts.data(), mags.data(), y1s.data(), y2s.data(), Np) ;
+    }
+
+    printf("%30s %20s %20s\n", "setting", "differing direct", "differing default") ;
+
+    // quadratic limb darkening, then a profile out of range with the same coefficients
+    {
+        std::vector<double> handle_ld, handle_kept, handle_default, direct ;
+        void *handle = wrapVBBL_create() ;
+        wrapVBBL_configure(handle, 0., 1.e-4, 1.e-4) ;
+        handle_mags(handle, s, q, rho, y1s, y2s, handle_default) ;
+        wrapVBBL_SetLDprofile(handle, VBBinaryLensing::LDquadratic, 0.4, 0.2) ;
+        handle_mags(handle, s, q, rho, y1s, y2s, handle_ld) ;
+        wrapVBBL_SetLDprofile(handle, VBBinaryLensing::LDuser, 0.4, 0.2) ;
+        handle_mags(handle, s, q, rho, y1s, y2s, handle_kept) ;
+        wrapVBBL_destroy(handle) ;
+
+        std::vector<double> direct_kept ;
+        VBBinaryLensing VBBL ;
+        VBBL.Tol = 1.e-4 ;
+        VBBL.RelTol = 1.e-4 ;
+        instance_mags(VBBL, s, q, rho, y1s, y2s, direct) ;
+        VBBL.SetLDprofile(VBBinaryLensing::LDquadratic) ;
+        VBBL.a1 = 0.4 ;
+        VBBL.a2 = 0.2 ;
+        instance_mags(VBBL, s, q, rho, y1s, y2s, direct) ;
+        instance_mags(VBBL, s, q, rho, y1s, y2s, direct_kept) ;
+        int ndirect = differences(handle_ld, direct), nkept = differences(handle_kept, direct_kept), ndefault = differences(handle_ld, handle_default) ;
+        printf("%30s %20d %20d\n", "LDquadratic", ndirect, ndefault) ;
+        printf("%30s %20d %20s\n", "LDuser (profile unchanged)", nkept, "") ;
+        if (ndirect > 0 || nkept > 0 || ndefault == 0)
+        {
+            printf("FAILED: wrapVBBL_SetLDprofile\n") ;
+            failed = 1 ;
+        }
+    }
+
+    // parallel contour
+    {
+        std::vector<double> handle_threads, handle_default, direct ;
+        void *handle = wrapVBBL_create() ;
+        wrapVBBL_configure(handle, 0., 1.e-6, 1.e-7) ;
+        handle_mags(handle, s, q, rho, y1s, y2s, handle_default) ;
+        wrapVBBL_SetThreads(handle, 2) ;
+        handle_mags(handle, s, q, rho, y1s, y2s, handle_threads) ;
+        wrapVBBL_destroy(handle) ;
+
+        VBBinaryLensing VBBL ;
+        VBBL.Tol = 1.e-6 ;
+        VBBL.RelTol = 1.e-7 ;
+        instance_mags(VBBL, s, q, rho, y1s, y2s, direct) ;
+        VBBL.contourthreads = 2 ;
+        instance_mags(VBBL, s, q, rho, y1s, y2s, direct) ;
+        int ndirect = differences(handle_threads, direct), ndefault = differences(handle_threads, handle_default) ;
+        printf("%30s %20d %20d\n", "contourthreads 2", ndirect, ndefault) ;
+        if (ndirect > 0 || ndefault == 0)
+        {
+            printf("FAILED: wrapVBBL_SetThreads\n") ;
+            failed = 1 ;
+        }
+    }
+
+    // warm start: fluxes of the light curve of a limb darkened source, fitted back on a denser sampling
+    {
+        int Nlc = 3000 ;
+        std::vector<double> tlc(Nlc), flux(Nlc), err(Nlc, 0.01), y1lc(Nlc), y2lc(Nlc) ;
+        std::vector<int> dataset(Nlc, 0) ;
+        for (int i = 0; i < Nlc; i++) tlc[i] = 7470. + 60. * i / (Nlc - 1) ;
+        {
+            VBBinaryLensing VBBL ;
+            VBBL.a1 = 0.5 ;
+            VBBL.BinaryLightCurve(pr, tlc.data(), flux.data(), y1lc.data(), y2lc.data(), Nlc) ;
+            for (int i = 0; i < Nlc; i++) flux[i] = 2. * flux[i] + 0.5 ;
+        }
+        std::vector<double> handle_warm(Nlc), handle_default(Nlc), direct(Nlc) ;
+        double chi2_warm, chi2_default, chi2_direct ;
+        void *handle = wrapVBBL_create() ;
+        wrapVBBL_configure(handle, 0.5, 1.e-4, 1.e-4) ;
+        wrapVBBL_LightCurveChi2(handle, VBBinaryLensing::LCBinary, pr, tlc.data(), flux.data(), err.data(), dataset.data(), 1, Nlc, 0, handle_default.data(), &chi2_default) ;
+        wrapVBBL_SetWarmStart(handle, 1) ;
+        wrapVBBL_LightCurveChi2(handle, VBBinaryLensing::LCBinary, pr, tlc.data(), flux.data(), err.data(), dataset.data(), 1, Nlc, 0, handle_warm.data(), &chi2_warm) ;
+        wrapVBBL_destroy(handle) ;
+
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = 1.e-4 ;
+        VBBL.RelTol = 1.e-4 ;
+        VBBL.LightCurveChi2(&VBBinaryLensing::BinaryLightCurve, pr, tlc.data(), flux.data(), err.data(), dataset.data(), 1, Nlc, 0, direct.data()) ;
+        VBBL.warmstart = true ;
+        chi2_direct = VBBL.LightCurveChi2(&VBBinaryLensing::BinaryLightCurve, pr, tlc.data(), flux.data(), err.data(), dataset.data(), 1, Nlc, 0, direct.data()) ;
+        int ndirect = differences(handle_warm, direct), ndefault = differences(handle_warm, handle_default) ;
+        printf("%30s %20d %20d\n", "warmstart (residuals)", ndirect, ndefault) ;
+        if (ndirect > 0 || !(chi2_warm == chi2_direct) || ndefault == 0)
+        {
+            printf("FAILED: wrapVBBL_SetWarmStart\n") ;
+            failed = 1 ;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
@@ -0,0 +1,135 @@
+/**************************************************************************************/
+// this code tests the C interface of LightCurveChi2 of the algorithmic version of VBBL (wrapVBBL_LightCurveChi2):
+// simulated fluxes of two datasets, with a few points flagged by err <= 0 or without a dataset, are fitted with the
+// PSPL and the binary lens light curves selected by curve_id. The chi square, the fluxes and the residuals must be those
+// of LightCurveChi2 and of a direct weighted least squares fit of the valid points, the flagged points must have residual 0,
+// and an unknown curve_id must give chi square -1.
+// It prints the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+extern "C"
+{
+void * wrapVBBL_create(void) ;
+void * wrapVBBL_configure(void *handle, double Gamma, double absolute_tolerance, double relative_tolerance) ;
+void * wrapVBBL_LightCurveChi2(void *handle, int curve_id, double *parameters, double *t_array, double *flux_array, double *err_array,
+                               int *dataset_array, int ndatasets, int np, double *FsFb, double *residual_array, double *chi2) ;
+void * wrapVBBL_destroy(void *handle) ;
+}
+
+
+// chi square of the weighted least squares fit of flux = Fs * mag + Fb on each dataset, over the points with err > 0
+static double direct_chi2(const std::vector<double> &mags, const std::vector<double> &flux, const std::vector<double> &err,
+                          const std::vector<int> &dataset, int ndatasets, std::vector<double> &FsFb)
+{
+    double chisq = 0. ;
+    FsFb.assign(2 * ndatasets, 0.) ;
+    for (int k = 0; k < ndatasets; k++)
+    {
+        double S = 0., Sm = 0., Smm = 0., Sf = 0., Smf = 0. ;
+        for (size_t i = 0; i < mags.size(); i++)
+        {
+            if (dataset[i] != k || !(err[i] > 0)) continue ;
+            double w = 1. / (err[i] * err[i]) ;
+            S += w ; Sm += w * mags[i] ; Smm += w * mags[i] * mags[i] ; Sf += w * flux[i] ; Smf += w * mags[i] * flux[i] ;
+        }
+        double det = S * Smm - Sm * Sm ;
+        FsFb[2 * k] = (S * Smf - Sm * Sf) / det ;
+        FsFb[2 * k + 1] = (Smm * Sf - Sm * Smf) / det ;
+        for (size_t i = 0; i < mags.size(); i++)
+        {
+            if (dataset[i] != k || !(err[i] > 0)) continue ;
+            double r = (flux[i] - FsFb[2 * k] * mags[i] - FsFb[2 * k + 1]) / err[i] ;
+            chisq += r * r ;
+        }
+    }
+    return chisq ;
+}
+
+
+int main()
+{
+    int Np = 400, ndatasets = 2 ;
+    int failed = 0 ;
+
+    // PSPL: [log_u0, log_tE, t0]; binary lens: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    double prPSPL[] = {log(0.1), log(30.0), 7500.0} ;
+    double prBinary[] = {log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0} ;
+    int Ncurve = 2 ;
+    int ids[] = {VBBinaryLensing::LCPSPL, VBBinaryLensing::LCBinary} ;
+    double *prs[] = {prPSPL, prBinary} ;
+    const char *names[] = {"PSPL", "Binary"} ;
+    VBBinaryLensing::LightCurveFunction curves[] = {&VBBinaryLensing::PSPLLightCurve, &VBBinaryLensing::BinaryLightCurve} ;
+
+    VBBinaryLensing VBBL ;
+    VBBL.Tol = 1.e-4 ;
+    VBBL.RelTol = 1.e-4 ;
+    void *handle = wrapVBBL_create() ;
+    wrapVBBL_configure(handle, 0., 1.e-4, 1.e-4) ;
+
+    printf("%8s %16s %16s %16s %16s\n", "curve", "chi2", "vs member", "vs direct fit", "flagged resid.") ;
+    for (int c = 0; c < Ncurve; c++)
+    {
+        // simulated fluxes of the binary lens model, with a deterministic scatter, on two datasets
+        std::vector<double> ts(Np), mags(Np), y1s(Np), y2s(Np), flux(Np), err(Np) ;
+        std::vector<int> dataset(Np) ;
+        for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+        VBBL.BinaryLightCurve(prBinary, ts.data(), mags.data(), y1s.data(), y2s.data(), Np) ;
+        for (int i = 0; i < Np; i++)
+        {
+            dataset[i] = i % ndatasets ;
+            err[i] = 0.01 * (1. + 0.5 * (i % 3)) ;
+            flux[i] = (dataset[i] ? 2. : 1.) * mags[i] + (dataset[i] ? 0.3 : 0.5) + err[i] * sin(1.7 * i) ;
+        }
+        // flagged points: zero and negative errors, and one without a dataset
+        err[10] = 0. ; err[57] = -1. ; err[200] = 0. ; dataset[131] = -1 ;
+        flux[10] = flux[57] = flux[200] = 1.e6 ;
+
+        std::vector<double> FsFb(2 * ndatasets), residuals(Np), FsFbm(2 * ndatasets), residualsm(Np), FsFbd ;
+        double chi2 ;
+        wrapVBBL_LightCurveChi2(handle, ids[c], prs[c], ts.data(), flux.data(), err.data(), dataset.data(), ndatasets, Np,
+                                FsFb.data(), residuals.data(), &chi2) ;
+        VBBinaryLensing fresh ;
+        fresh.Tol = 1.e-4 ;
+        fresh.RelTol = 1.e-4 ;
+        double chi2m = fresh.LightCurveChi2(curves[c], prs[c], ts.data(), flux.data(), err.data(), dataset.data(), ndatasets, Np,
+                                            FsFbm.data(), residualsm.data()) ;
+
+        // direct fit on the magnifications of the same curve
+        (fresh.*curves[c])(prs[c], ts.data(), mags.data(), y1s.data(), y2s.data(), Np) ;
+        double chi2d = direct_chi2(mags, flux, err, dataset, ndatasets, FsFbd) ;
+
+        double devm = fabs(chi2 - chi2m) / chi2m, devd = fabs(chi2 - chi2d) / chi2d ;
+        for (int k = 0; k < 2 * ndatasets; k++)
+        {
+            double dm = fabs(FsFb[k] - FsFbm[k]) / (fabs(FsFbm[k]) + 1.), dd = fabs(FsFb[k] - FsFbd[k]) / (fabs(FsFbd[k]) + 1.) ;
+            if (!(dm <= devm)) devm = dm ;
+            if (!(dd <= devd)) devd = dd ;
+        }
+        double flagged = fabs(residuals[10]) + fabs(residuals[57]) + fabs(residuals[200]) + fabs(residuals[131]) ;
+        printf("%8s %16.6e %16.3e %16.3e %16.3e\n", names[c], chi2, devm, devd, flagged) ;
+        // the same calculation through the handle and on a fresh instance (the roots seeds differ: 1e-8), and a direct fit
+        // whose sums are taken in another order (1e-10)
+        if (!(devm < 1.e-8) || !(devd < 1.e-8) || flagged != 0.)
+        {
+            printf("FAILED: %s\n", names[c]) ;
+            failed = 1 ;
+        }
+    }
+
+    double chi2 = 0. ;
+    std::vector<double> ts(Np, 7500.), flux(Np, 1.), err(Np, 1.) ;
+    std::vector<int> dataset(Np, 0) ;
+    wrapVBBL_LightCurveChi2(handle, 99, prPSPL, ts.data(), flux.data(), err.data(), dataset.data(), 1, Np, 0, 0, &chi2) ;
+    printf("unknown curve_id: chi2 = %g\n", chi2) ;
+    if (chi2 != -1.) failed = 1 ;
+
+    wrapVBBL_destroy(handle) ;
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
@@ -0,0 +1,72 @@
+/**************************************************************************************/
+// this code tests the hexadecapole tier of the algorithmic version of VBBL (MultipoleMag, used by BinaryMag2):
+// on the low/medium/high magnification grids of the README (s=1, q=1e-3, rho=1e-3, here 61x61), for a uniform
+// and a limb darkened source, every magnification accepted by MultipoleMag must agree with BinaryMagDark at Tol 1e-6
+// within the accuracy goal Tol+RelTol*Mag, and the tier must be taken on most of the medium magnification grid.
+// It prints the accepted points and the worst deviations and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+int main()
+{
+    int N = 61 ;
+    int failed = 0 ;
+    double s = 1.0, q = 1.e-3, rho = 1.e-3 ;
+    double ranges[] = {1.0, 0.1, 0.01} ;
+    double tols[] = {1.e-3, 1.e-4} ;
+    double a1s[] = {0., 0.6} ;
+    double shift_x = -s * q / (1. + q) ;    // centered on the primary lens, as in the test drivers
+
+    printf("%8s %8s %8s %10s %20s\n", "range", "Tol", "a1", "accepted", "worst deviation") ;
+    for (int r = 0; r < 3; r++)
+    {
+        for (int t = 0; t < 2; t++)
+        {
+            for (int l = 0; l < 2; l++)
+            {
+                VBBinaryLensing VBBL, ref ;
+                VBBL.Tol = tols[t] ;
+                VBBL.RelTol = 1.e-4 ;
+                VBBL.a1 = ref.a1 = a1s[l] ;
+                ref.Tol = ref.RelTol = 1.e-6 ;
+
+                int accepted = 0 ;
+                double worst = 0. ;
+                for (int iy = 0; iy < N; iy++)
+                {
+                    for (int ix = 0; ix < N; ix++)
+                    {
+                        double y1 = shift_x - ranges[r] + 2 * ranges[r] * ix / N ;
+                        double y2 = -ranges[r] + 2 * ranges[r] * iy / N ;
+                        double mag = VBBL.MultipoleMag(s, q, y1, y2, rho, VBBL.Tol) ;
+                        if (mag < 0) continue ;
+                        accepted++ ;
+                        double exact = ref.BinaryMagDark(s, q, y1, y2, rho, ref.Tol) ;
+                        // in units of the accuracy goal Tol+RelTol*Mag
+                        double dev = fabs(mag - exact) / (VBBL.Tol + VBBL.RelTol * exact) ;
+                        if (!(dev <= worst)) worst = dev ;
+                    }
+                }
+                printf("%8.2f %8.0e %8.1f %10d %20.3e\n", ranges[r], tols[t], a1s[l], accepted, worst) ;
+                if (!(worst < 1.))
+                {
+                    printf("FAILED: range %g Tol %g a1 %g, deviation above the accuracy\n", ranges[r], tols[t], a1s[l]) ;
+                    failed = 1 ;
+                }
+                // medium magnification: the source is off the caustics on most of the grid
+                if (r == 1 && accepted < N * N / 2)
+                {
+                    printf("FAILED: range %g Tol %g a1 %g, tier taken on %d points only\n", ranges[r], tols[t], a1s[l], accepted) ;
+                    failed = 1 ;
+                }
+            }
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
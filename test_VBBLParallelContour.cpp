@@ -0,0 +1,89 @@
+/**************************************************************************************/
+// this code tests the parallel contour of the algorithmic version of VBBL (contourthreads > 1):
+// BinaryMag2 along a caustic crossing, with an accuracy goal that takes the contours beyond _Contour_parallel_NPS points,
+// computed with 1, 2 and 4 threads. With 2 and 4 threads the magnifications must be identical, since the batches do not
+// depend on the threads; with 1 thread (serial) they must agree within the accuracy goal Tol+RelTol*Mag.
+// The same instance is then switched from 4 to 2 and back to 4 threads, to check the helper threads kept in its workspace.
+// It prints the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+// magnifications of the sources on a fresh instance with the given number of contour threads; counts the contours
+// that went parallel, i.e. whose serial NPS reached 256 (_Contour_parallel_NPS)
+static void magnifications(int threads, double s, double q, double rho, const std::vector<double> &y1s, const std::vector<double> &y2s,
+                           std::vector<double> &mags, int *nparallel)
+{
+    VBBinaryLensing VBBL ;
+    VBBL.Tol = 1.e-6 ;
+    VBBL.RelTol = 1.e-7 ;
+    VBBL.contourthreads = threads ;
+    mags.resize(y1s.size()) ;
+    if (nparallel) *nparallel = 0 ;
+    for (size_t i = 0; i < y1s.size(); i++)
+    {
+        mags[i] = VBBL.BinaryMag2(s, q, y1s[i], y2s[i], rho) ;
+        if (nparallel && VBBL.NPS >= 256) (*nparallel)++ ;
+    }
+}
+
+
+int main()
+{
+    double s = 1.0, q = 0.1, rho = 1.e-2 ;
+    int Np = 120 ;
+    int nparallel, failed = 0 ;
+
+    // straight trajectory through the central caustic
+    std::vector<double> y1s, y2s ;
+    for (int i = 0; i < Np; i++)
+    {
+        y1s.push_back(-0.3 + 0.6 * i / (Np - 1)) ;
+        y2s.push_back(0.02 + 0.1 * i / (Np - 1)) ;
+    }
+
+    std::vector<double> mags1, mags2, mags4, magsswitch ;
+    magnifications(1, s, q, rho, y1s, y2s, mags1, &nparallel) ;
+    magnifications(2, s, q, rho, y1s, y2s, mags2, 0) ;
+    magnifications(4, s, q, rho, y1s, y2s, mags4, 0) ;
+
+    // one instance going from 4 to 2 and back to 4 threads, against fresh instances
+    VBBinaryLensing VBBL ;
+    VBBL.Tol = 1.e-6 ;
+    VBBL.RelTol = 1.e-7 ;
+    magsswitch.resize(Np) ;
+    for (int i = 0; i < Np; i++)
+    {
+        VBBL.contourthreads = (i / 10) % 2 ? 2 : 4 ;
+        magsswitch[i] = VBBL.BinaryMag2(s, q, y1s[i], y2s[i], rho) ;
+    }
+
+    double worst1 = 0., worst24 = 0., worstswitch = 0. ;
+    for (int i = 0; i < Np; i++)
+    {
+        double dev = fabs(mags1[i] - mags2[i]) / (VBBL.Tol + VBBL.RelTol * mags1[i]) ;
+        if (!(dev <= worst1)) worst1 = dev ;
+        dev = fabs(mags2[i] - mags4[i]) ;
+        if (!(dev <= worst24)) worst24 = dev ;
+        dev = fabs(magsswitch[i] - mags4[i]) / (VBBL.Tol + VBBL.RelTol * mags4[i]) ;
+        if (!(dev <= worstswitch)) worstswitch = dev ;
+    }
+
+    printf("%8s %10s %20s %20s %20s\n", "points", "parallel", "1 vs 2 threads", "2 vs 4 threads", "switching threads") ;
+    printf("%8d %10d %20.3e %20.3e %20.3e\n", Np, nparallel, worst1, worst24, worstswitch) ;
+    // 1 vs 2 threads and switching threads in units of Tol+RelTol*Mag (the roots left by the previous call seed the next one,
+    // so the switching instance agrees within the accuracy), 2 vs 4 threads in absolute terms: they must be equal
+    if (nparallel == 0)
+    {
+        printf("FAILED: no contour reached the parallel batches\n") ;
+        failed = 1 ;
+    }
+    if (!(worst1 < 1.) || !(worst24 == 0.) || !(worstswitch < 1.)) failed = 1 ;
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
@@ -0,0 +1,109 @@
+/**************************************************************************************/
+// this code tests the multithreaded point lists and maps of the algorithmic version of VBBL (BinaryMag2_Npoint with
+// nthreads, BinaryMagMap): on the medium and high magnification grids of the README (s=1, q=1e-3, rho=1e-3, here 70x45,
+// so that the tiles at the edges are partial), both are computed 3 times with 1, 2 and 4 threads. All the runs must
+// give the same magnifications bit for bit, since every chunk and tile starts from the same root seeds whichever thread
+// takes it, and they must agree with BinaryMag2 called serially on the grid within the accuracy goal Tol+RelTol*Mag.
+// It prints the worst deviations and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+static void set_accuracy(VBBinaryLensing &VBBL)
+{
+    VBBL.Tol = 1.e-3 ;
+    VBBL.RelTol = 1.e-4 ;
+}
+
+// number of magnifications that are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+// worst deviation from the serial magnifications, in units of the accuracy goal Tol+RelTol*Mag
+static double deviation(std::vector<double> &mags, std::vector<double> &serial)
+{
+    double worst = 0. ;
+    for (size_t i = 0; i < mags.size(); i++)
+    {
+        double dev = fabs(mags[i] - serial[i]) / (1.e-3 + 1.e-4 * serial[i]) ;
+        if (!(dev <= worst)) worst = dev ;
+    }
+    return worst ;
+}
+
+
+int main()
+{
+    int nx = 70, ny = 45, np = nx * ny ;
+    int failed = 0 ;
+    double s = 1.0, q = 1.e-3, rho = 1.e-3 ;
+    double shift_x = -s * q / (1. + q) ;    // centered on the primary lens, as in the test drivers
+    double ranges[] = {0.1, 0.01} ;
+    int threads[3] = {1, 2, 4} ;
+
+    printf("%8s %20s %8s %8s %12s %20s\n", "range", "function", "threads", "run", "differing", "worst deviation") ;
+    for (int r = 0; r < 2; r++)
+    {
+        double x_min = shift_x - ranges[r], x_max = shift_x + ranges[r], y_min = -ranges[r], y_max = ranges[r] ;
+        double dx = (x_max - x_min) / nx, dy = (y_max - y_min) / ny ;     // the pixels of BinaryMagMap
+
+        // the grid of BinaryMagMap, and BinaryMag2 called serially on it
+        std::vector<double> y1s(np), y2s(np), ss(np, s), serial(np) ;
+        {
+            VBBinaryLensing VBBL ;
+            set_accuracy(VBBL) ;
+            for (int iy = 0; iy < ny; iy++)
+            {
+                for (int ix = 0; ix < nx; ix++)
+                {
+                    y1s[iy * nx + ix] = x_min + ix * dx ;
+                    y2s[iy * nx + ix] = y_min + iy * dy ;
+                    serial[iy * nx + ix] = VBBL.BinaryMag2(s, q, y1s[iy * nx + ix], y2s[iy * nx + ix], rho) ;
+                }
+            }
+        }
+
+        std::vector<double> npoint_first, map_first ;
+        for (int t = 0; t < 3; t++)
+        {
+            for (int run = 0; run < 3; run++)
+            {
+                VBBinaryLensing VBBL ;
+                set_accuracy(VBBL) ;
+                std::vector<double> npoint(np), map(np) ;
+                VBBL.BinaryMag2_Npoint(ss.data(), q, rho, y1s.data(), y2s.data(), np, npoint.data(), threads[t]) ;
+                VBBL.BinaryMagMap(s, q, rho, x_min, x_max, y_min, y_max, nx, ny, map.data(), NULL, threads[t]) ;
+                if (npoint_first.empty())
+                {
+                    npoint_first = npoint ;
+                    map_first = map ;
+                }
+                int nnpoint = differences(npoint, npoint_first), nmap = differences(map, map_first) ;
+                double devnpoint = deviation(npoint, serial), devmap = deviation(map, serial) ;
+                printf("%8.2f %20s %8d %8d %12d %20.3e\n", ranges[r], "BinaryMag2_Npoint", threads[t], run, nnpoint, devnpoint) ;
+                printf("%8.2f %20s %8d %8d %12d %20.3e\n", ranges[r], "BinaryMagMap", threads[t], run, nmap, devmap) ;
+                if (nnpoint > 0 || nmap > 0)
+                {
+                    printf("FAILED: range %g, %d threads, run %d, not the magnifications of the first run\n", ranges[r], threads[t], run) ;
+                    failed = 1 ;
+                }
+                if (!(devnpoint < 1.) || !(devmap < 1.))
+                {
+                    printf("FAILED: range %g, %d threads, run %d, deviation from the serial BinaryMag2 above the accuracy\n", ranges[r], threads[t], run) ;
+                    failed = 1 ;
+                }
+            }
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
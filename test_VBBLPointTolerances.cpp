@@ -0,0 +1,152 @@
+/**************************************************************************************/
+// this code tests the per-point tolerances of the algorithmic version of VBBL (SetPointTolerances) on BinaryLightCurve
+// across the caustic crossing of a limb darkened source:
+// - a tolerance array equal to Tol everywhere must give bit for bit the curve of the instance Tol;
+// - the form on flux errors must give bit for bit the curve of the array safety * err / |Fs| of the datasets of the
+//   points, with the instance Tol on points of an unknown dataset;
+// - the tolerances serve one curve only: the next curve must be bit for bit that of the instance Tol;
+// - the points given a tighter tolerance must be at least 10 times closer to the magnification at Tol 1e-6 than with
+//   the instance Tol.
+// It prints the deviations and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+// number of points on which the two curves are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+
+int main()
+{
+    int Np = 200 ;
+    int failed = 0 ;
+    double Tol = 1.e-2, tight = 1.e-5 ;
+
+    // caustic crossing of a stellar binary by a limb darkened source: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    double pr[7] = {log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0} ;
+    std::vector<double> ts(Np), y1s(Np), y2s(Np) ;
+    for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+
+    // curves with the instance Tol: the first curve of an instance, and the second one with a 10 times larger Tol
+    std::vector<double> plain(Np), plain_next(Np) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = Tol ;
+        VBBL.BinaryLightCurve(pr, ts.data(), plain.data(), y1s.data(), y2s.data(), Np) ;
+        VBBL.Tol = 10 * Tol ;
+        VBBL.BinaryLightCurve(pr, ts.data(), plain_next.data(), y1s.data(), y2s.data(), Np) ;
+    }
+
+    // uniform array, then no tolerances: the instance Tol is 10 times larger, so that a tolerance not taken in the first
+    // curve, or left to the second one, shows up
+    std::vector<double> uniform(Np), uniform_next(Np), tols(Np, Tol) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = 10 * Tol ;
+        VBBL.SetPointTolerances(tols.data(), Np) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), uniform.data(), y1s.data(), y2s.data(), Np) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), uniform_next.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    int nuniform = differences(uniform, plain), nnext = differences(uniform_next, plain_next) ;
+    printf("points differing from the curve of the instance Tol: uniform tolerances %d, next curve %d (of %d)\n", nuniform, nnext, Np) ;
+    if (nuniform > 0)
+    {
+        printf("FAILED: a uniform tolerance array does not give the curve of the instance Tol\n") ;
+        failed = 1 ;
+    }
+    if (nnext > 0)
+    {
+        printf("FAILED: the tolerances were not taken out by the first curve\n") ;
+        failed = 1 ;
+    }
+
+    // flux errors of three datasets, one with negative flux, and points of an unknown dataset
+    double FsFb[6] = {2.0, 0.5, -0.7, 1.2, 15.0, 0.} ;
+    double safety = 0.3 ;
+    std::vector<double> errs(Np), flux_tols(Np) ;
+    std::vector<int> datasets(Np) ;
+    for (int i = 0; i < Np; i++)
+    {
+        datasets[i] = (i % 7 == 6) ? 3 : i % 3 ;
+        errs[i] = 1.e-3 * (1 + i % 5) ;
+        flux_tols[i] = (datasets[i] < 3) ? safety * errs[i] / fabs(FsFb[2 * datasets[i]]) : 0. ;
+    }
+    std::vector<double> from_errors(Np), from_array(Np) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = Tol ;
+        VBBL.SetPointTolerances(errs.data(), datasets.data(), 3, FsFb, Np, safety) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), from_errors.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = Tol ;
+        VBBL.SetPointTolerances(flux_tols.data(), Np) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), from_array.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    int nerrors = differences(from_errors, from_array) ;
+    printf("points differing between the tolerances from flux errors and safety * err / |Fs|: %d (of %d)\n", nerrors, Np) ;
+    if (nerrors > 0)
+    {
+        printf("FAILED: the tolerances from flux errors are not safety * err / |Fs|\n") ;
+        failed = 1 ;
+    }
+
+    // tighter tolerance on the 10 points farthest from the accurate curve
+    std::vector<double> exact(Np), tightened(Np) ;
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = 1.e-6 ;
+        VBBL.BinaryLightCurve(pr, ts.data(), exact.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    std::vector<double> point_tols(Np, 0.) ;
+    std::vector<int> worst ;
+    for (int k = 0; k < 10; k++)
+    {
+        int iw = -1 ;
+        for (int i = 0; i < Np; i++)
+        {
+            if (point_tols[i] > 0) continue ;
+            if (iw < 0 || fabs(plain[i] - exact[i]) > fabs(plain[iw] - exact[iw])) iw = i ;
+        }
+        point_tols[iw] = tight ;
+        worst.push_back(iw) ;
+    }
+    {
+        VBBinaryLensing VBBL ;
+        VBBL.a1 = 0.5 ;
+        VBBL.Tol = Tol ;
+        VBBL.SetPointTolerances(point_tols.data(), Np) ;
+        VBBL.BinaryLightCurve(pr, ts.data(), tightened.data(), y1s.data(), y2s.data(), Np) ;
+    }
+    printf("%8s %12s %20s %20s\n", "point", "t", "deviation at Tol", "deviation tightened") ;
+    for (int k = 0; k < 10; k++)
+    {
+        int i = worst[k] ;
+        double dev = fabs(plain[i] - exact[i]), dev_tight = fabs(tightened[i] - exact[i]) ;
+        printf("%8d %12.4f %20.3e %20.3e\n", i, ts[i], dev, dev_tight) ;
+        if (!(dev_tight < 0.1 * dev))
+        {
+            printf("FAILED: the tighter tolerance did not reduce the error of point %d\n", i) ;
+            failed = 1 ;
+        }
+    }
+
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
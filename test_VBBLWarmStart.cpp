@@ -0,0 +1,70 @@
+/**************************************************************************************/
+// this code tests the warm start of the light curves of the algorithmic version of VBBL (warmstart = true):
+// BinaryLightCurve on densely sampled caustic crossings, for a uniform and a limb darkened source (whose points go
+// through MultipoleMag, BinaryMagDark and BinaryMagSafe), computed with and without warm start on fresh instances.
+// Point by point, the two light curves must agree within the accuracy goal Tol+RelTol*Mag.
+// It prints the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBBL_lib_algorithmic_compiling_optimization/VBBinaryLensingLibrary_v3p6.h"
+
+
+// light curve of the parameters on a fresh instance, with or without warm start
+static void light_curve(bool warmstart, double a1, double *pr, std::vector<double> &ts, std::vector<double> &mags)
+{
+    VBBinaryLensing VBBL ;
+    VBBL.Tol = 1.e-4 ;
+    VBBL.RelTol = 1.e-4 ;
+    VBBL.a1 = a1 ;
+    VBBL.warmstart = warmstart ;
+    std::vector<double> y1s(ts.size()), y2s(ts.size()) ;
+    mags.resize(ts.size()) ;
+    VBBL.BinaryLightCurve(pr, ts.data(), mags.data(), y1s.data(), y2s.data(), (int)ts.size()) ;
+}
+
+
+int main()
+{
+    int Np = 3000 ;
+    int failed = 0 ;
+    double Tol = 1.e-4, RelTol = 1.e-4 ;
+
+    // caustic crossings of a stellar binary and of a planetary caustic: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    int Ncurve = 2 ;
+    double pr[2][7] = {{log(0.9), log(0.1), 0.05, 0.6, log(0.01), log(30.0), 7500.0},
+                       {log(1.2), log(1.e-3), 0.1, 1.2, log(2.e-3), log(30.0), 7500.0}} ;
+    double a1s[] = {0., 0.5} ;
+
+    std::vector<double> ts(Np) ;
+    for (int i = 0; i < Np; i++) ts[i] = 7470. + 60. * i / (Np - 1) ;
+
+    printf("%8s %8s %8s %20s\n", "curve", "a1", "points", "warm vs cold") ;
+    for (int c = 0; c < Ncurve; c++)
+    {
+        for (int l = 0; l < 2; l++)
+        {
+            std::vector<double> cold, warm ;
+            light_curve(false, a1s[l], pr[c], ts, cold) ;
+            light_curve(true, a1s[l], pr[c], ts, warm) ;
+            double worst = 0. ;
+            for (int i = 0; i < Np; i++)
+            {
+                double dev = fabs(warm[i] - cold[i]) / (Tol + RelTol * cold[i]) ;
+                if (!(dev <= worst)) worst = dev ;
+            }
+            printf("%8d %8.1f %8d %20.3e\n", c, a1s[l], Np, worst) ;
+            // in units of the accuracy goal Tol+RelTol*Mag
+            if (!(worst < 1.))
+            {
+                printf("FAILED: curve %d a1=%g\n", c, a1s[l]) ;
+                failed = 1 ;
+            }
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
@@ -0,0 +1,127 @@
+/**************************************************************************************/
+// this code tests the batched point-source solver of the algorithmic version of VBMicrolensing:
+// BinaryMag0_Npoint against BinaryMag0, for sources close to the folds and to the cusps of the caustics,
+// where the SIMD roots are most delicate (see test_VBBLBatchedPointSource.cpp, which also tests the caustic index).
+// It prints the worst deviation and returns 1 if it is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h"
+
+
+// caustic points of PlotCrit (the critical curves come first, then the caustics)
+static void caustic_points(VBMicrolensing &VBM, double s, double q, std::vector<std::vector<double> > &x1, std::vector<std::vector<double> > &x2)
+{
+    _sols *CriticalCurves = VBM.PlotCrit(s, q) ;
+    _curve *scancurve = CriticalCurves->first ;
+    int ncc = CriticalCurves->length / 2 ;
+
+    for (int i = 0; i < ncc; i++) scancurve = scancurve->next ;
+    for (; scancurve; scancurve = scancurve->next)
+    {
+        x1.push_back(std::vector<double>()) ;
+        x2.push_back(std::vector<double>()) ;
+        for (_point *p = scancurve->first; p; p = p->next)
+        {
+            x1.back().push_back(p->x1) ;
+            x2.back().push_back(p->x2) ;
+        }
+    }
+    delete CriticalCurves ;
+}
+
+
+// sources at distances d from the caustics: along the normal of every 8th caustic point on both sides (folds),
+// and along the axes from the extreme points of each caustic, which are cusps or lie next to them
+static void sources_near_caustics(const std::vector<std::vector<double> > &x1, const std::vector<std::vector<double> > &x2,
+                                  const double *d, int nd, std::vector<double> &y1s, std::vector<double> &y2s)
+{
+    for (size_t c = 0; c < x1.size(); c++)
+    {
+        int n = (int)x1[c].size() ;
+        int imin = 0, imax = 0, jmin = 0, jmax = 0 ;
+        for (int k = 0; k < n; k++)
+        {
+            if (x1[c][k] < x1[c][imin]) imin = k ;
+            if (x1[c][k] > x1[c][imax]) imax = k ;
+            if (x2[c][k] < x2[c][jmin]) jmin = k ;
+            if (x2[c][k] > x2[c][jmax]) jmax = k ;
+        }
+        for (int id = 0; id < nd; id++)
+        {
+            for (int k = 0; k < n; k += 8)
+            {
+                double t1 = x1[c][(k + 1) % n] - x1[c][(k + n - 1) % n], t2 = x2[c][(k + 1) % n] - x2[c][(k + n - 1) % n] ;
+                double t = sqrt(t1 * t1 + t2 * t2) ;
+                if (t == 0) continue ;
+                for (int side = -1; side <= 1; side += 2)
+                {
+                    y1s.push_back(x1[c][k] - side * d[id] * t2 / t) ;
+                    y2s.push_back(x2[c][k] + side * d[id] * t1 / t) ;
+                }
+            }
+            for (int side = -1; side <= 1; side += 2)
+            {
+                y1s.push_back(x1[c][imin] + side * d[id]) ; y2s.push_back(x2[c][imin]) ;
+                y1s.push_back(x1[c][imax] + side * d[id]) ; y2s.push_back(x2[c][imax]) ;
+                y1s.push_back(x1[c][jmin]) ; y2s.push_back(x2[c][jmin] + side * d[id]) ;
+                y1s.push_back(x1[c][jmax]) ; y2s.push_back(x2[c][jmax] + side * d[id]) ;
+            }
+        }
+    }
+}
+
+
+int main()
+{
+    // close, intermediate and wide binaries, planetary and stellar mass ratios
+    int Ngeometry = 6 ;
+    double geometry_s[] = {0.7, 1.0, 1.6, 0.7, 1.0, 1.6} ;
+    double geometry_q[] = {1.e-3, 1.e-3, 1.e-3, 0.3, 0.3, 0.3} ;
+
+    // distances from the caustics
+    int Nd = 5 ;
+    double d[] = {1.e-2, 1.e-3, 1.e-4, 1.e-5, 1.e-6} ;
+    // relative deviation of BinaryMag0_Npoint from BinaryMag0, per unit of magnification: the roots of the two solvers
+    // agree to about 1.e-10, and the magnification of an image close to a critical curve changes by A*dz relative,
+    // whereas a lost or spurious image would change the magnification by far more
+    double threshold = 1.e-8 ;
+    int failed = 0 ;
+
+    VBMicrolensing VBM ;
+
+    printf("%6s %8s %8s %16s\n", "s", "q", "points", "BinaryMag0") ;
+
+    for (int g = 0; g < Ngeometry; g++)
+    {
+        double s = geometry_s[g], q = geometry_q[g] ;
+        std::vector<std::vector<double> > x1, x2 ;
+        caustic_points(VBM, s, q, x1, x2) ;
+
+        std::vector<double> y1s, y2s ;
+        sources_near_caustics(x1, x2, d, Nd, y1s, y2s) ;
+        int np = (int)y1s.size() ;
+        std::vector<double> ss(np, s), mags(np) ;
+        VBM.BinaryMag0_Npoint(ss.data(), q, y1s.data(), y2s.data(), np, mags.data()) ;
+        double worst = 0. ;
+        for (int i = 0; i < np; i++)
+        {
+            double mag = VBM.BinaryMag0(s, q, y1s[i], y2s[i]) ;
+            double dev = fabs(mags[i] - mag) / mag / (threshold * mag) ;
+            if (!(dev <= worst)) worst = dev ;
+        }
+
+        printf("%6.2f %8.0e %8d %16.3e\n", s, q, np, worst) ;
+        // the deviation is in units of its threshold
+        if (!(worst < 1.))
+        {
+            printf("FAILED: s=%g q=%g\n", s, q) ;
+            failed = 1 ;
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
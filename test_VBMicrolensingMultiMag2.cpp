@@ -0,0 +1,89 @@
+/**************************************************************************************/
+// this code tests MultiMag2 of the algorithmic version of VBMicrolensing (point source / hexadecapole / contour tiers
+// for multiple lenses): on the low/medium/high magnification grids of the README triple lens (here 41x41), for the
+// Singlepoly, Multipoly and Nopoly methods, every magnification of MultiMag2 must agree with MultiMag at Tol 1e-6
+// within the accuracy goal Tol+RelTol*Mag, and so must every magnification accepted by the hexadecapole tier
+// (MultiMultipoleMag) alone. The reference is computed with Nopoly: at Tol 1e-6 the contours of the polynomial methods
+// do not converge on a few points of the low magnification grid (NPS reaches NPSmax).
+// It prints the accepted points and the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include"VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h"
+
+
+int main()
+{
+    int N = 41 ;
+    int failed = 0 ;
+    double q_array[3] = { 1., 0.001, 0.0001} ;
+    complex s_array[3] = { complex(0.,0.), complex(1.,0.), complex(0.,0.9)} ;
+    double rho = 0.001 ;
+    double ranges[] = {1.0, 0.1, 0.01} ;
+    double tols[] = {1.e-3, 1.e-4} ;
+    VBMicrolensing::Method methods[] = {VBMicrolensing::Method::Singlepoly, VBMicrolensing::Method::Multipoly, VBMicrolensing::Method::Nopoly} ;
+    const char *method_names[] = {"Singlepoly", "Multipoly", "Nopoly"} ;
+
+    VBMicrolensing ref ;
+    ref.SetMethod(VBMicrolensing::Method::Nopoly) ;
+    ref.SetLensGeometry(3, q_array, s_array) ;
+    ref.Tol = ref.RelTol = 1.e-6 ;
+
+    printf("%12s %8s %8s %20s %12s %12s %10s %20s\n", "method", "range", "Tol", "worst deviation", "y1", "y2", "accepted", "worst hexadecapole") ;
+    for (int r = 0; r < 3; r++)
+    {
+        // reference magnifications of the grid, shared by the methods and the tolerances
+        double *exact = (double *)malloc(N * N * sizeof(double)) ;
+        for (int iy = 0; iy < N; iy++)
+            for (int ix = 0; ix < N; ix++)
+                exact[iy * N + ix] = ref.MultiMag(-ranges[r] + 2 * ranges[r] * ix / N, -ranges[r] + 2 * ranges[r] * iy / N, rho) ;
+
+        for (int m = 0; m < 3; m++)
+        {
+            for (int t = 0; t < 2; t++)
+            {
+                VBMicrolensing VBML ;
+                VBML.SetMethod(methods[m]) ;
+                VBML.SetLensGeometry(3, q_array, s_array) ;
+                VBML.Tol = tols[t] ;
+                VBML.RelTol = 1.e-4 ;
+
+                double worst = 0., worst_y1 = 0., worst_y2 = 0., worst_multipole = 0. ;
+                int accepted = 0 ;
+                for (int iy = 0; iy < N; iy++)
+                {
+                    for (int ix = 0; ix < N; ix++)
+                    {
+                        double y1 = -ranges[r] + 2 * ranges[r] * ix / N ;
+                        double y2 = -ranges[r] + 2 * ranges[r] * iy / N ;
+                        double mag = VBML.MultiMag2(y1, y2, rho) ;
+                        // in units of the accuracy goal Tol+RelTol*Mag
+                        double dev = fabs(mag - exact[iy * N + ix]) / (VBML.Tol + VBML.RelTol * exact[iy * N + ix]) ;
+                        if (!(dev <= worst))
+                        {
+                            worst = dev ;
+                            worst_y1 = y1 ;
+                            worst_y2 = y2 ;
+                        }
+                        mag = VBML.MultiMultipoleMag(complex(y1, y2), rho, VBML.Tol) ;
+                        if (mag < 0) continue ;
+                        accepted++ ;
+                        dev = fabs(mag - exact[iy * N + ix]) / (VBML.Tol + VBML.RelTol * exact[iy * N + ix]) ;
+                        if (!(dev <= worst_multipole)) worst_multipole = dev ;
+                    }
+                }
+                printf("%12s %8.2f %8.0e %20.3e %12.5f %12.5f %10d %20.3e\n", method_names[m], ranges[r], tols[t], worst, worst_y1, worst_y2, accepted, worst_multipole) ;
+                if (!(worst < 1.) || !(worst_multipole < 1.))
+                {
+                    printf("FAILED: %s range %g Tol %g\n", method_names[m], ranges[r], tols[t]) ;
+                    failed = 1 ;
+                }
+            }
+        }
+        free(exact) ;
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
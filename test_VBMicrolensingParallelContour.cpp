@@ -0,0 +1,109 @@
+/**************************************************************************************/
+// this code tests the parallel contour of MultiMag in the algorithmic version of VBMicrolensing (contourthreads > 1):
+// MultiMag on the README triple lens along a crossing of its central caustic, with an accuracy goal that takes the
+// contours beyond _Contour_parallel_NPS points, computed with 1, 2 and 4 threads for the Singlepoly, Multipoly and
+// Nopoly methods. With 2 and 4 threads the magnifications must be identical, since the batches do not depend on the
+// threads; with 1 thread (serial) they must agree within the accuracy goal Tol+RelTol*Mag. The same instance is then
+// switched from 4 to 2 and back to 4 threads: the images of a point do not depend on the previous calls, so it must give
+// the magnifications of 4 threads exactly.
+// It prints the worst deviations and returns 1 if one of them is above its threshold.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h"
+
+
+static double q_array[3] = { 1., 0.001, 0.0001} ;
+static complex s_array[3] = { complex(0.,0.), complex(1.,0.), complex(0.,0.9)} ;
+
+static void set_lens(VBMicrolensing &VBML, VBMicrolensing::Method method)
+{
+    VBML.SetMethod(method) ;
+    VBML.SetLensGeometry(3, q_array, s_array) ;
+    VBML.Tol = 1.e-5 ;
+    VBML.RelTol = 1.e-6 ;
+}
+
+// magnifications of the sources on a fresh instance with the given number of contour threads; counts the contours
+// that went parallel, i.e. whose serial NPS reached 256 (_Contour_parallel_NPS)
+static void magnifications(int threads, VBMicrolensing::Method method, double rho, const std::vector<double> &y1s,
+                           const std::vector<double> &y2s, std::vector<double> &mags, int *nparallel)
+{
+    VBMicrolensing VBML ;
+    set_lens(VBML, method) ;
+    VBML.contourthreads = threads ;
+    mags.resize(y1s.size()) ;
+    if (nparallel) *nparallel = 0 ;
+    for (size_t i = 0; i < y1s.size(); i++)
+    {
+        mags[i] = VBML.MultiMag(y1s[i], y2s[i], rho) ;
+        if (nparallel && VBML.NPS >= 256) (*nparallel)++ ;
+    }
+}
+
+
+int main()
+{
+    double rho = 1.e-2 ;
+    int Np = 40 ;
+    int failed = 0 ;
+    VBMicrolensing::Method methods[] = {VBMicrolensing::Method::Singlepoly, VBMicrolensing::Method::Multipoly, VBMicrolensing::Method::Nopoly} ;
+    const char *method_names[] = {"Singlepoly", "Multipoly", "Nopoly"} ;
+
+    // straight trajectory through the central caustic
+    std::vector<double> y1s, y2s ;
+    for (int i = 0; i < Np; i++)
+    {
+        y1s.push_back(-0.05 + 0.1 * i / (Np - 1)) ;
+        y2s.push_back(0.005 + 0.01 * i / (Np - 1)) ;
+    }
+
+    printf("%12s %8s %10s %20s %20s %20s\n", "method", "points", "parallel", "1 vs 2 threads", "2 vs 4 threads", "switching threads") ;
+    for (int m = 0; m < 3; m++)
+    {
+        int nparallel ;
+        std::vector<double> mags1, mags2, mags4, magsswitch ;
+        magnifications(1, methods[m], rho, y1s, y2s, mags1, &nparallel) ;
+        magnifications(2, methods[m], rho, y1s, y2s, mags2, 0) ;
+        magnifications(4, methods[m], rho, y1s, y2s, mags4, 0) ;
+
+        // one instance going from 4 to 2 and back to 4 threads, against fresh instances
+        VBMicrolensing VBML ;
+        set_lens(VBML, methods[m]) ;
+        magsswitch.resize(Np) ;
+        for (int i = 0; i < Np; i++)
+        {
+            VBML.contourthreads = (i / 10) % 2 ? 2 : 4 ;
+            magsswitch[i] = VBML.MultiMag(y1s[i], y2s[i], rho) ;
+        }
+
+        double worst1 = 0., worst24 = 0., worstswitch = 0. ;
+        for (int i = 0; i < Np; i++)
+        {
+            double dev = fabs(mags1[i] - mags2[i]) / (VBML.Tol + VBML.RelTol * mags1[i]) ;
+            if (!(dev <= worst1)) worst1 = dev ;
+            dev = fabs(mags2[i] - mags4[i]) ;
+            if (!(dev <= worst24)) worst24 = dev ;
+            dev = fabs(magsswitch[i] - mags4[i]) ;
+            if (!(dev <= worstswitch)) worstswitch = dev ;
+        }
+
+        printf("%12s %8d %10d %20.3e %20.3e %20.3e\n", method_names[m], Np, nparallel, worst1, worst24, worstswitch) ;
+        // 1 vs 2 threads in units of Tol+RelTol*Mag, 2 vs 4 threads and switching threads in absolute terms: they must be equal
+        if (nparallel == 0)
+        {
+            printf("FAILED: %s, no contour reached the parallel batches\n", method_names[m]) ;
+            failed = 1 ;
+        }
+        if (!(worst1 < 1.) || !(worst24 == 0.) || !(worstswitch == 0.))
+        {
+            printf("FAILED: %s\n", method_names[m]) ;
+            failed = 1 ;
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
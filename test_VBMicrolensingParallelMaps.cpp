@@ -0,0 +1,100 @@
+/**************************************************************************************/
+// this code tests the multithreaded maps of the algorithmic version of VBMicrolensing (MultiMagMap): on the medium and
+// high magnification grids of the README triple lens (here 24x20, so that the tiles at the edges are partial), the map
+// is computed 3 times with 1, 2 and 4 threads. All the runs must give the same magnifications bit for bit, since every
+// tile starts from a freshly set geometry whichever thread takes it, and they must agree with MultiMag called serially
+// on the grid within the accuracy goal Tol+RelTol*Mag.
+// It prints the worst deviations and returns 1 if a check fails.
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include"VBMicrolensing_lib_algorithmic_compiling_optimization/VBMicrolensingLibrary.h"
+
+
+static double q_array[3] = { 1., 0.001, 0.0001} ;
+static complex s_array[3] = { complex(0.,0.), complex(1.,0.), complex(0.,0.9)} ;
+
+static void set_lens(VBMicrolensing &VBML)
+{
+    VBML.SetLensGeometry(3, q_array, s_array) ;
+    VBML.Tol = 1.e-3 ;
+    VBML.RelTol = 1.e-4 ;
+}
+
+// number of magnifications that are not bit for bit the same
+static int differences(std::vector<double> &a, std::vector<double> &b)
+{
+    int n = 0 ;
+    for (size_t i = 0; i < a.size(); i++) if (!(a[i] == b[i])) n++ ;
+    return n ;
+}
+
+// worst deviation from the serial magnifications, in units of the accuracy goal Tol+RelTol*Mag
+static double deviation(std::vector<double> &mags, std::vector<double> &serial)
+{
+    double worst = 0. ;
+    for (size_t i = 0; i < mags.size(); i++)
+    {
+        double dev = fabs(mags[i] - serial[i]) / (1.e-3 + 1.e-4 * serial[i]) ;
+        if (!(dev <= worst)) worst = dev ;
+    }
+    return worst ;
+}
+
+
+int main()
+{
+    int nx = 24, ny = 20, np = nx * ny ;
+    int failed = 0 ;
+    double rho = 1.e-3 ;
+    double ranges[] = {0.1, 0.01} ;
+    int threads[3] = {1, 2, 4} ;
+
+    printf("%8s %8s %8s %12s %20s\n", "range", "threads", "run", "differing", "worst deviation") ;
+    for (int r = 0; r < 2; r++)
+    {
+        double x_min = -ranges[r], x_max = ranges[r], y_min = -ranges[r], y_max = ranges[r] ;
+        double dx = (x_max - x_min) / nx, dy = (y_max - y_min) / ny ;     // the pixels of MultiMagMap
+
+        // MultiMag called serially on the grid of MultiMagMap
+        std::vector<double> serial(np) ;
+        {
+            VBMicrolensing VBML ;
+            set_lens(VBML) ;
+            for (int iy = 0; iy < ny; iy++)
+                for (int ix = 0; ix < nx; ix++)
+                    serial[iy * nx + ix] = VBML.MultiMag(x_min + ix * dx, y_min + iy * dy, rho) ;
+        }
+
+        std::vector<double> first ;
+        for (int t = 0; t < 3; t++)
+        {
+            for (int run = 0; run < 3; run++)
+            {
+                VBMicrolensing VBML ;
+                set_lens(VBML) ;
+                std::vector<double> map(np) ;
+                VBML.MultiMagMap(rho, x_min, x_max, y_min, y_max, nx, ny, map.data(), NULL, threads[t]) ;
+                if (first.empty()) first = map ;
+                int n = differences(map, first) ;
+                double dev = deviation(map, serial) ;
+                printf("%8.2f %8d %8d %12d %20.3e\n", ranges[r], threads[t], run, n, dev) ;
+                if (n > 0)
+                {
+                    printf("FAILED: range %g, %d threads, run %d, not the magnifications of the first run\n", ranges[r], threads[t], run) ;
+                    failed = 1 ;
+                }
+                if (!(dev < 1.))
+                {
+                    printf("FAILED: range %g, %d threads, run %d, deviation from the serial MultiMag above the accuracy\n", ranges[r], threads[t], run) ;
+                    failed = 1 ;
+                }
+            }
+        }
+    }
+    printf(failed ? "FAILED\n" : "PASSED\n") ;
+    return failed ;
+}
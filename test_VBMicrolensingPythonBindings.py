@@ -0,0 +1,181 @@
+######################################################################################
+# smoke test of the Python module built by compile_all_VBMicrolensing.sh (needs NumPy):
+# the zero-copy ...Into light curves must give the same magnifications as the list-returning ones,
+# also when two instances compute at the same time from two threads and when the inputs are not contiguous,
+# and must reject output arrays of the wrong length, type, shape or strides;
+# LightCurveChi2 must give the chi square, fluxes and residuals of a weighted least squares fit computed here
+# from the same magnifications, also from two threads, and must reject unknown curves and arrays of the wrong length;
+# the statistics of the last call (stats) must be read-only, and count the work of the call if the module is compiled
+# with -D_HOTPATH_STATS (hotpath_stats), all 0 otherwise.
+# Usage: python3 test_VBMicrolensingPythonBindings.py [directory of the module, default bin]
+######################################################################################
+
+import sys
+import threading
+import numpy as np
+
+sys.path.insert(0, sys.argv[1] if len(sys.argv) > 1 else "bin")
+import VBMicrolensing
+
+# caustic crossing binary lens light curve: [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+params = np.array([np.log(0.9), np.log(0.1), 0.05, 0.6, np.log(0.01), np.log(30.0), 7500.0])
+times = np.linspace(7470.0, 7530.0, 2000)
+failed = 0
+
+
+def check(name, ok):
+    global failed
+    print(("PASS " if ok else "FAIL ") + name)
+    if not ok:
+        failed += 1
+
+
+def into_arrays(vbm, params, times):
+    mags, y1s, y2s = np.empty(len(times)), np.empty(len(times)), np.empty(len(times))
+    vbm.BinaryLightCurveInto(params, times, mags, y1s, y2s)
+    return mags, y1s, y2s
+
+
+def into(vbm):
+    return into_arrays(vbm, params, times)
+
+
+# every comparison is done on fresh instances, since the roots of the previous call seed the next one
+reference = [np.array(c) for c in VBMicrolensing.VBMicrolensing().BinaryLightCurve(list(params), list(times))]
+check("BinaryLightCurveInto equals BinaryLightCurve",
+      all(np.array_equal(a, b) for a, b in zip(into(VBMicrolensing.VBMicrolensing()), reference)))
+
+# two instances computing concurrently from two threads
+results = [None, None]
+instances = [VBMicrolensing.VBMicrolensing(), VBMicrolensing.VBMicrolensing()]
+threads = [threading.Thread(target=lambda i=i: results.__setitem__(i, into(instances[i]))) for i in range(2)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+check("two threads on two instances", all(np.array_equal(r[0], reference[0]) for r in results))
+
+# two threads sharing one instance are serialized by the lock of the instance
+# (the second light curve starts from the roots left by the first one, so it agrees within Tol)
+vbm = VBMicrolensing.VBMicrolensing()
+threads = [threading.Thread(target=lambda i=i: results.__setitem__(i, into(vbm))) for i in range(2)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+check("two threads on one instance", all(np.allclose(r[0], reference[0], rtol=vbm.Tol, atol=0) for r in results))
+
+# non-contiguous inputs are copied and give the same light curve
+strided_params, strided_times = np.repeat(params, 2)[::2], np.repeat(times, 2)[::2]
+check("non-contiguous inputs accepted", not strided_times.flags.c_contiguous
+      and all(np.array_equal(a, b) for a, b in zip(into_arrays(VBMicrolensing.VBMicrolensing(), strided_params, strided_times), reference)))
+
+# output arrays of the wrong length, type, shape or strides are rejected
+try:
+    vbm.BinaryLightCurveInto(params, times, np.empty(10), np.empty_like(times), np.empty_like(times))
+    check("wrong length rejected", False)
+except ValueError:
+    check("wrong length rejected", True)
+try:
+    vbm.BinaryLightCurveInto(params, times, np.empty(len(times), dtype=np.float32), np.empty_like(times), np.empty_like(times))
+    check("float32 output rejected", False)
+except ValueError:
+    check("float32 output rejected", True)
+try:
+    vbm.BinaryLightCurveInto(params, times, np.empty(2 * len(times))[::2], np.empty_like(times), np.empty_like(times))
+    check("non-contiguous output rejected", False)
+except ValueError:
+    check("non-contiguous output rejected", True)
+try:
+    vbm.BinaryLightCurveInto(params, times, np.empty((2, len(times) // 2)), np.empty_like(times), np.empty_like(times))
+    check("two-dimensional output rejected", False)
+except ValueError:
+    check("two-dimensional output rejected", True)
+try:
+    vbm.BinaryLightCurveOrbitalInto(np.append(params, [0.0, 0.0, 0.0, 0.0, 0.0]), times, np.empty_like(times),
+                                    np.empty_like(times), np.empty_like(times), np.empty(len(times) + 1))
+    check("wrong length of seps rejected", False)
+except ValueError:
+    check("wrong length of seps rejected", True)
+try:
+    readonly = np.empty_like(times)
+    readonly.flags.writeable = False
+    vbm.BinaryLightCurveInto(params, times, readonly, np.empty_like(times), np.empty_like(times))
+    check("read-only output rejected", False)
+except ValueError:
+    check("read-only output rejected", True)
+
+# LightCurveChi2 on two datasets, against the weighted least squares fit of flux = Fs * mag + Fb done here
+# (the point with err = 0 is left out of both)
+mags = into(VBMicrolensing.VBMicrolensing())[0]
+dataset = np.arange(len(times)) % 2
+err = np.where(dataset == 0, 0.01, 0.02)
+err[7] = 0.0
+flux = np.where(dataset == 0, 2.0 * mags + 0.5, 1.2 * mags + 3.0) + err * np.cos(37.0 * times)
+expected_chi2, expected_FsFb, expected_residuals = 0.0, [], np.zeros_like(times)
+for k in range(2):
+    sel = (dataset == k) & (err > 0)
+    w = 1.0 / err[sel] ** 2
+    A = np.array([[np.sum(w * mags[sel] ** 2), np.sum(w * mags[sel])], [np.sum(w * mags[sel]), np.sum(w)]])
+    Fs, Fb = np.linalg.solve(A, [np.sum(w * mags[sel] * flux[sel]), np.sum(w * flux[sel])])
+    expected_FsFb += [Fs, Fb]
+    expected_residuals[sel] = (flux[sel] - Fs * mags[sel] - Fb) / err[sel]
+    expected_chi2 += np.sum(expected_residuals[sel] ** 2)
+
+
+def chi2(vbm):
+    return vbm.LightCurveChi2("BinaryLightCurve", params, times, flux, err, dataset, 2)
+
+
+chi2_value, FsFb, residuals = chi2(VBMicrolensing.VBMicrolensing())
+sel = err > 0
+check("LightCurveChi2 equals the fit on BinaryLightCurveInto",
+      np.isclose(chi2_value, expected_chi2, rtol=1e-8, atol=0)
+      and np.allclose(FsFb, expected_FsFb, rtol=1e-8, atol=0)
+      and np.allclose(residuals[sel], expected_residuals[sel], rtol=1e-6, atol=1e-9))
+
+# two instances computing concurrently from two threads
+instances = [VBMicrolensing.VBMicrolensing(), VBMicrolensing.VBMicrolensing()]
+threads = [threading.Thread(target=lambda i=i: results.__setitem__(i, chi2(instances[i]))) for i in range(2)]
+for t in threads:
+    t.start()
+for t in threads:
+    t.join()
+check("LightCurveChi2 from two threads on two instances", all(r[0] == chi2_value for r in results))
+
+try:
+    vbm.LightCurveChi2("NoLightCurve", params, times, flux, err, dataset, 2)
+    check("LightCurveChi2 unknown curve rejected", False)
+except ValueError:
+    check("LightCurveChi2 unknown curve rejected", True)
+try:
+    vbm.LightCurveChi2("BinaryLightCurve", params, times, flux[:-1], err, dataset, 2)
+    check("LightCurveChi2 wrong length rejected", False)
+except ValueError:
+    check("LightCurveChi2 wrong length rejected", True)
+
+# the statistics of the last call: a point source BinaryMag2 solves the lens equation once,
+# a BinaryMagDark samples the contours of its annuli; all 0 without -D_HOTPATH_STATS
+vbm = VBMicrolensing.VBMicrolensing()
+vbm.BinaryMag2(0.9, 0.1, 0.5, 0.5, 0.01)
+stats = vbm.stats
+if VBMicrolensing.hotpath_stats:
+    check("stats of a point source BinaryMag2", stats.BinaryMag2_branch == 1 and stats.NewImages_calls == 1
+          and stats.laguerre_iterations > 0 and stats.NPS == 0)
+else:
+    check("stats of a point source BinaryMag2 all 0", stats.BinaryMag2_branch == 0 and stats.NewImages_calls == 0
+          and stats.laguerre_iterations == 0)
+vbm.BinaryMagDark(0.9, 0.1, 0.05, 0.05, 0.01, 1.e-3)
+stats = vbm.stats
+if VBMicrolensing.hotpath_stats:
+    check("stats of BinaryMagDark", stats.BinaryMag2_branch == 0 and stats.NPS > 0 and stats.annuli >= 1
+          and stats.NewImages_calls > 0)
+else:
+    check("stats of BinaryMagDark all 0", stats.NPS == 0 and stats.annuli == 0 and stats.NewImages_calls == 0)
+try:
+    vbm.stats = stats
+    check("stats read-only", False)
+except AttributeError:
+    check("stats read-only", True)
+
+sys.exit(1 if failed else 0)
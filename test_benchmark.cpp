@@ -0,0 +1,300 @@
+/**************************************************************************************/
+// this code is the common benchmark of all the six versions (VBBL and VBMicrolensing,
+// No Optimization / Compiling Optimization / Algorithmic Compiling Optimization).
+// It is compiled once per version by benchmark_all.sh, with
+//     -D_BENCH_HEADER='"<folder>/<header>.h"'  the header of the version
+//     -D_BENCH_VARIANT='"<name>"'              the name written in the report
+//     -D_BENCH_VBM                             for the VBMicrolensing versions
+// and linked with the corresponding library. Each point is computed by one call and timed alone.
+//
+// workloads:
+//     map_low, map_medium, map_high : grid_side x grid_side grid over [-1,1], [-0.1,0.1], [-0.01,0.01] around the
+//                                     primary lens (BinaryMag2 for VBBL, triple lens MultiMag for VBMicrolensing)
+//     light_curve                    : caustic crossing light curve computed time by time
+//                                     (BinaryLightCurve for VBBL, TripleLightCurve for VBMicrolensing)
+//     limb_darkening                 : BinaryMagDark with linear limb darkening across the central caustic
+//     espl, espl_limb_darkening      : ESPLMag2 without / with limb darkening (only if an ESPL table is given)
+//
+// usage: ./test_benchmark_<version>.out json_file mags_file reference_mags_file|none [grid_side] [ESPL_table]
+//     json_file           : report with p50/p90/p99/max latency per point, throughput and accuracy
+//     mags_file           : magnification of every point, to be used as reference_mags_file by other versions
+//     reference_mags_file : mags_file of the reference version (accuracy is left null with none)
+/**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include _BENCH_HEADER
+
+
+struct workload_result
+{
+    std::string name ;
+    std::vector<double> mags ;
+    std::vector<double> times ;    // computation time of each point in second
+};
+
+
+// time each call of compute(i), i = 0 ... npoint-1
+template <class F> workload_result run_workload(const char *name, int npoint, F compute)
+{
+    workload_result result ;
+    result.name = name ;
+    result.mags.resize(npoint) ;
+    result.times.resize(npoint) ;
+
+    printf("%-20s %8d points ... ", name, npoint) ;
+    fflush(stdout) ;
+    for(int i=0; i < npoint; i++)
+    {
+        auto begin = std::chrono::steady_clock::now() ;
+        result.mags[i] = compute(i) ;
+        auto end   = std::chrono::steady_clock::now() ;
+        result.times[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() * 1e-9 ;
+    }
+    double total = 0. ;
+    for(int i=0; i < npoint; i++) total += result.times[i] ;
+    printf("%e (second)\n", total) ;
+
+    return result ;
+}
+
+
+// nearest-rank percentile of a sorted array
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) return 0. ;
+    int rank = (int)ceil(p * sorted.size()) - 1 ;
+    if (rank < 0) rank = 0 ;
+    return sorted[rank] ;
+}
+
+
+// reference magnifications written by another version: lines "workload npoint" followed by npoint values
+bool read_reference(const char *file_name, const std::string &name, std::vector<double> &mags)
+{
+    FILE *file_pointer = fopen(file_name, "r") ;
+    if (file_pointer == NULL) return false ;
+
+    char block_name[256] ;
+    int npoint ;
+    bool found = false ;
+    while (!found && fscanf(file_pointer, "%255s %d", block_name, &npoint) == 2)
+    {
+        std::vector<double> values(npoint) ;
+        for(int i=0; i < npoint; i++)
+        {
+            if (fscanf(file_pointer, "%lf", &values[i]) != 1) { fclose(file_pointer) ; return false ; }
+        }
+        if (name == block_name)
+        {
+            mags.swap(values) ;
+            found = true ;
+        }
+    }
+    fclose(file_pointer) ;
+    return found ;
+}
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 6)
+    {
+        printf("usage: %s json_file mags_file reference_mags_file|none [grid_side] [ESPL_table]\n", argv[0]) ;
+        exit(0) ;
+    }
+
+    const char *json_file_name      = argv[1] ;
+    const char *mags_file_name      = argv[2] ;
+    const char *reference_file_name = (strcmp(argv[3], "none") == 0) ? NULL : argv[3] ;
+    int grid_side = (argc > 4) ? atoi(argv[4]) : 51 ;
+    char *ESPL_table = (argc > 5) ? argv[5] : NULL ;
+
+    printf("version   = %s\n", _BENCH_VARIANT) ;
+    printf("grid side = %d\n", grid_side) ;
+
+    double Tol    = 0.001 ;
+    double RelTol = 0.0001 ;
+    double rho    = 0.001 ;
+
+    std::vector<workload_result> results ;
+
+#ifndef _BENCH_VBM
+    /////////////////////////////// VBBL: binary lens s=1, q=0.001 ///////////////////////////////
+    double s = 1.0 ;
+    double q = 0.001 ;
+    double shift_x = -s*q/(1.+q) ; // change the origin to primary lens to compare with VBMicrolensing
+
+    VBBinaryLensing VBBL ;
+    VBBL.a1     = 0. ;
+    VBBL.Tol    = Tol ;
+    VBBL.RelTol = RelTol ;
+
+    auto magnification = [&](double x, double y) { return VBBL.BinaryMag2(s, q, x + shift_x, y, rho) ; } ;
+#else
+    /////////////////////////////// VBMicrolensing: triple lens as in test_VBMicrolensing*.cpp ///////////////////////////////
+    double  q_array[3] = { 1., 0.001, 0.0001} ;
+    complex s_array[3] = { complex(0.,0.), complex(1.,0.), complex(0.,0.9)} ;
+
+    VBMicrolensing VBML ;
+    VBML.SetMethod(VBMicrolensing::Method::Multipoly) ;
+    VBML.SetLensGeometry(3, q_array, s_array) ;
+    VBML.a1     = 0. ;
+    VBML.Tol    = Tol ;
+    VBML.RelTol = RelTol ;
+
+    auto magnification = [&](double x, double y) { return VBML.MultiMag(complex(x, y), rho) ; } ;
+#endif
+
+    // magnification maps, in the three regions of the other tests
+    const char *map_names[3] = {"map_low", "map_medium", "map_high"} ;
+    double half_width[3] = {1.0, 0.1, 0.01} ;
+    for(int region=0; region < 3; region++)
+    {
+        double w = half_width[region] ;
+        results.push_back(run_workload(map_names[region], grid_side * grid_side, [&](int i) {
+            double x = -w + 2. * w * (i % grid_side) / grid_side ;
+            double y = -w + 2. * w * (i / grid_side) / grid_side ;
+            return magnification(x, y) ;
+        })) ;
+    }
+
+    // caustic crossing light curve, tE = 30 days, from t0-tE to t0+tE
+    int Nlight_curve = grid_side * grid_side ;
+#ifndef _BENCH_VBM
+    // [log_s, log_q, u0, alpha, log_rho, log_tE, t0]
+    double light_curve_parameters[7] = {log(s), log(q), 0.005, 0.8, log(rho), log(30.), 0.} ;
+    results.push_back(run_workload("light_curve", Nlight_curve, [&](int i) {
+        return VBBL.BinaryLightCurve(light_curve_parameters, -30. + 60. * i / Nlight_curve) ;
+    })) ;
+#else
+    // [log(s12), log(q2), u0, alpha, log(rho), log(tE), t0, log(s13), log(q3), psi]
+    double light_curve_parameters[10] = {log(1.0), log(0.001), 0.005, 0.8, log(rho), log(30.), 0., log(0.9), log(0.0001), 1.5707963} ;
+    results.push_back(run_workload("light_curve", Nlight_curve, [&](int i) {
+        return VBML.TripleLightCurve(light_curve_parameters, -30. + 60. * i / Nlight_curve) ;
+    })) ;
+#endif
+
+    // limb darkening (a1 = 0.5) on a line across the central caustic of the binary lens s=1, q=0.001
+    int Nlimb_darkening = grid_side * grid_side / 4 ;
+#ifndef _BENCH_VBM
+    VBBinaryLensing &VBLD = VBBL ;
+#else
+    VBMicrolensing &VBLD = VBML ;
+#endif
+    results.push_back(run_workload("limb_darkening", Nlimb_darkening, [&](int i) {
+        VBLD.a1 = 0.5 ;
+        double mag = VBLD.BinaryMagDark(1.0, 0.001, -0.01 + 0.02 * i / Nlimb_darkening - 0.001/1.001, 0.0003, rho, Tol) ;
+        VBLD.a1 = 0. ;
+        return mag ;
+    })) ;
+
+    // extended source point lens, u in [0, 0.1), rho in [0.001, 0.1)
+    if (ESPL_table != NULL)
+    {
+        VBLD.LoadESPLTable(ESPL_table) ;
+        const char *ESPL_names[2] = {"espl", "espl_limb_darkening"} ;
+        double ESPL_a1[2] = {0., 0.5} ;
+        for(int k=0; k < 2; k++)
+        {
+            results.push_back(run_workload(ESPL_names[k], grid_side * grid_side, [&](int i) {
+                VBLD.a1 = ESPL_a1[k] ;
+                double u      = 0.1 * (i % grid_side) / grid_side ;
+                double rho_i  = 0.001 + 0.099 * (i / grid_side) / grid_side ;
+                double mag = VBLD.ESPLMag2(u, rho_i) ;
+                VBLD.a1 = 0. ;
+                return mag ;
+            })) ;
+        }
+    }
+
+
+    // magnifications of every point, to be used as reference by the other versions
+    FILE *file_pointer = fopen(mags_file_name, "w") ;
+    if (file_pointer == NULL)
+    {
+        printf("The file %s is not opened. The program will exit now", mags_file_name) ;
+        exit(0) ;
+    }
+    for(const workload_result &result : results)
+    {
+        fprintf(file_pointer, "%s %d\n", result.name.c_str(), (int)result.mags.size()) ;
+        for(double mag : result.mags) fprintf(file_pointer, "%.17g\n", mag) ;
+    }
+    fclose(file_pointer) ;
+
+
+    // json report
+    file_pointer = fopen(json_file_name, "w") ;
+    if (file_pointer == NULL)
+    {
+        printf("The file %s is not opened. The program will exit now", json_file_name) ;
+        exit(0) ;
+    }
+    fprintf(file_pointer, "{\n") ;
+    fprintf(file_pointer, "  \"variant\": \"%s\",\n", _BENCH_VARIANT) ;
+    fprintf(file_pointer, "  \"grid_side\": %d,\n", grid_side) ;
+    fprintf(file_pointer, "  \"Tol\": %g,\n", Tol) ;
+    fprintf(file_pointer, "  \"RelTol\": %g,\n", RelTol) ;
+    if (reference_file_name != NULL) fprintf(file_pointer, "  \"reference\": \"%s\",\n", reference_file_name) ;
+    else                             fprintf(file_pointer, "  \"reference\": null,\n") ;
+    fprintf(file_pointer, "  \"workloads\": [\n") ;
+
+    for(size_t k=0; k < results.size(); k++)
+    {
+        const workload_result &result = results[k] ;
+        int npoint = (int)result.mags.size() ;
+
+        std::vector<double> sorted_times = result.times ;
+        std::sort(sorted_times.begin(), sorted_times.end()) ;
+        double total = 0. ;
+        for(double t : result.times) total += t ;
+
+        fprintf(file_pointer, "    {\n") ;
+        fprintf(file_pointer, "      \"name\": \"%s\",\n", result.name.c_str()) ;
+        fprintf(file_pointer, "      \"points\": %d,\n", npoint) ;
+        fprintf(file_pointer, "      \"total_seconds\": %.6e,\n", total) ;
+        fprintf(file_pointer, "      \"throughput_points_per_second\": %.6e,\n", total > 0. ? npoint / total : 0.) ;
+        fprintf(file_pointer, "      \"latency_seconds\": {\"p50\": %.6e, \"p90\": %.6e, \"p99\": %.6e, \"max\": %.6e},\n", \
+                percentile(sorted_times, 0.50), percentile(sorted_times, 0.90), \
+                percentile(sorted_times, 0.99), sorted_times.empty() ? 0. : sorted_times.back()) ;
+
+        // relative error |mag - mag_reference| / mag_reference of each point
+        std::vector<double> reference ;
+        if (reference_file_name != NULL && read_reference(reference_file_name, result.name, reference) \
+            && (int)reference.size() == npoint)
+        {
+            std::vector<double> errors(npoint) ;
+            double mean_error = 0. ;
+            int Nover_RelTol = 0 ;
+            for(int i=0; i < npoint; i++)
+            {
+                errors[i] = fabs(result.mags[i] - reference[i]) / fabs(reference[i]) ;
+                mean_error += errors[i] / npoint ;
+                if (errors[i] > RelTol) Nover_RelTol++ ;
+            }
+            std::sort(errors.begin(), errors.end()) ;
+            fprintf(file_pointer, "      \"accuracy\": {\"mean_rel_error\": %.6e, \"p99_rel_error\": %.6e, \"max_rel_error\": %.6e, \"points_over_RelTol\": %d}\n", \
+                    mean_error, percentile(errors, 0.99), errors.empty() ? 0. : errors.back(), Nover_RelTol) ;
+        }
+        else
+        {
+            fprintf(file_pointer, "      \"accuracy\": null\n") ;
+        }
+        fprintf(file_pointer, "    }%s\n", (k + 1 < results.size()) ? "," : "") ;
+    }
+
+    fprintf(file_pointer, "  ]\n") ;
+    fprintf(file_pointer, "}\n") ;
+    fclose(file_pointer) ;
+
+    printf("report written in %s\n", json_file_name) ;
+
+    return 0;
+}